@@ -0,0 +1,616 @@
+// throughput benchmark over a generated corpus, run with `make bench`
+// results are printed and written as json (bench_results.json by default,
+// or the first argument) so runs of two builds can be diffed
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define JSON_IMPLEMENTATION 1
+#include "../json.h"
+
+// every allocation the library makes goes through these counters,
+// installed with Json_setAllocator before anything is parsed
+static size_t bench_allocs;
+static size_t bench_alloc_bytes;
+static size_t bench_frees;
+
+static void *benchAlloc(void *user, size_t sz)
+{
+  (void)user;
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&bench_alloc_bytes, sz, __ATOMIC_RELAXED);
+  return malloc(sz);
+}
+
+static void *benchResize(void *user, void *ptr, size_t sz)
+{
+  (void)user;
+  __atomic_fetch_add(&bench_allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&bench_alloc_bytes, sz, __ATOMIC_RELAXED);
+  return realloc(ptr, sz);
+}
+
+static void benchRelease(void *user, void *ptr)
+{
+  (void)user;
+  __atomic_fetch_add(&bench_frees, 1, __ATOMIC_RELAXED);
+  free(ptr);
+}
+
+static const Json_Allocator bench_allocator = {benchAlloc, benchResize, benchRelease, NULL};
+
+// each measurement is repeated until it has run this long, keeping the best
+#define BENCH_MIN_SECONDS 0.25
+#define BENCH_MIN_RUNS    3
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ull;
+
+static unsigned long long rng(void)
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t cap;
+} Buf;
+
+static void bufPut(Buf *buf, const char *fmt, ...)
+{
+  for (;;) {
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(&buf->data[buf->len], buf->cap - buf->len, fmt, args);
+    va_end(args);
+
+    if (n < 0) exit(1);
+    if ((size_t)n < buf->cap - buf->len) {
+      buf->len += (size_t)n;
+      return;
+    }
+
+    buf->cap = (buf->cap)? buf->cap * 2 : 4096;
+    buf->data = (char *)realloc(buf->data, buf->cap);
+    if (!buf->data) exit(1);
+  }
+}
+
+static void genString(Buf *buf)
+{
+  static const char *const pieces[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "\\\"quoted\\\"", "tab\\there",
+    "line\\nbreak", "caf\xc3\xa9", "\xe4\xb8\xad\xe6\x96\x87", "\xf0\x9f\x8c\xb3",
+    "\\u00e9t\\u00e9", "back\\\\slash", "path/to/file", "\\ud83c\\udf3f"
+  };
+
+  bufPut(buf, "\"");
+  const int words = 1 + (int)(rng() % 12);
+  for (int i = 0; i < words; ++i) {
+    bufPut(buf, (i)? " %s" : "%s", pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))]);
+  }
+  bufPut(buf, "\"");
+}
+
+static void genScalar(Buf *buf)
+{
+  switch (rng() % 6) {
+    case 0: bufPut(buf, "%lld", (long long)(rng() % 2000000) - 1000000); break;
+    case 1: bufPut(buf, "%.17g", (double)(rng() % 1000000) / 997.0); break;
+    case 2: bufPut(buf, (rng() & 1)? "true" : "false"); break;
+    case 3: bufPut(buf, "null"); break;
+    default: genString(buf); break;
+  }
+}
+
+// a few hundred objects with hundreds of fields each
+static void genWide(Buf *buf)
+{
+  bufPut(buf, "[");
+  for (int i = 0; i < 300; ++i) {
+    bufPut(buf, (i)? ",{" : "{");
+    for (int j = 0; j < 256; ++j) {
+      bufPut(buf, (j)? ",\"field_%d\":" : "\"field_%d\":", j);
+      genScalar(buf);
+    }
+    bufPut(buf, "}");
+  }
+  bufPut(buf, "]");
+}
+
+// chains of alternating objects and arrays, 400 levels deep
+static void genDeep(Buf *buf)
+{
+  bufPut(buf, "[");
+  for (int i = 0; i < 400; ++i) {
+    if (i) bufPut(buf, ",");
+    for (int d = 0; d < 200; ++d) bufPut(buf, "{\"id\":%d,\"next\":[", d);
+    genScalar(buf);
+    for (int d = 0; d < 200; ++d) bufPut(buf, "]}");
+  }
+  bufPut(buf, "]");
+}
+
+static void genNumbers(Buf *buf)
+{
+  bufPut(buf, "[");
+  for (int i = 0; i < 400000; ++i) {
+    if (i) bufPut(buf, ",");
+
+    const unsigned long long r = rng();
+    switch (r % 4) {
+      case 0: bufPut(buf, "%lld", (long long)(r >> 20) % 100000000 - 50000000); break;
+      case 1: bufPut(buf, "%.2f", (double)(r >> 20 & 0xfffff) / 100.0); break;
+      case 2: bufPut(buf, "%.17g", (double)(r >> 11) * 0x1p-53); break;
+      default: bufPut(buf, "%.6e", (double)(r >> 11) * 0x1p-53 * 1e30); break;
+    }
+  }
+  bufPut(buf, "]");
+}
+
+static void genStrings(Buf *buf)
+{
+  bufPut(buf, "[");
+  for (int i = 0; i < 100000; ++i) {
+    if (i) bufPut(buf, ",");
+    genString(buf);
+  }
+  bufPut(buf, "]");
+}
+
+static void genLines(Buf *buf)
+{
+  for (int i = 0; i < 50000; ++i) {
+    bufPut(buf, "{\"id\":%d,\"user\":", i);
+    genString(buf);
+    bufPut(buf, ",\"score\":");
+    genScalar(buf);
+    bufPut(buf, ",\"tags\":[");
+    genString(buf);
+    bufPut(buf, ",");
+    genString(buf);
+    bufPut(buf, "]}\n");
+  }
+}
+
+typedef struct {
+  double seconds;
+  size_t allocs;
+  size_t alloc_bytes;
+  size_t frees;
+} Measure;
+
+static void measureStart(Measure *m)
+{
+  bench_allocs = bench_alloc_bytes = bench_frees = 0;
+  m->seconds = now();
+}
+
+static void measureEnd(Measure *m)
+{
+  m->seconds = now() - m->seconds;
+  m->allocs = bench_allocs;
+  m->alloc_bytes = bench_alloc_bytes;
+  m->frees = bench_frees;
+}
+
+static void keepBest(Measure *best, const Measure *m, int run)
+{
+  if (!run || m->seconds < best->seconds) *best = *m;
+}
+
+static Json_Boolean writeCount(void *user, const char *data, size_t len)
+{
+  (void)data;
+  *(size_t *)user += len;
+  return JSON_TRUE;
+}
+
+static void emptyObject(Json_Value *out)
+{
+  memset(out, 0, sizeof(*out));
+  out->type = JSON_TYPE_OBJECT;
+}
+
+static void report(Json_Value *results, const char *corpus, const char *op, const Measure *m, size_t bytes, size_t items)
+{
+  const double mb_s = (double)bytes / m->seconds / 1e6;
+  if (items) {
+    printf("%-8s %-10s %10.1f M/s  %12zu allocs %14zu bytes %12zu frees\n",
+           corpus, op, (double)items / m->seconds / 1e6, m->allocs, m->alloc_bytes, m->frees);
+  } else {
+    printf("%-8s %-10s %10.1f MB/s %12zu allocs %14zu bytes %12zu frees\n",
+           corpus, op, mb_s, m->allocs, m->alloc_bytes, m->frees);
+  }
+
+  Json_Value entry;
+  emptyObject(&entry);
+  Json_objectSetNum(&entry, JSON_STRLIT("seconds"), m->seconds);
+  Json_objectSetNum(&entry, JSON_STRLIT("mb_per_s"), mb_s);
+  Json_objectSetInt(&entry, JSON_STRLIT("bytes"), (Json_Integer)bytes);
+  Json_objectSetInt(&entry, JSON_STRLIT("allocs"), (Json_Integer)m->allocs);
+  Json_objectSetInt(&entry, JSON_STRLIT("alloc_bytes"), (Json_Integer)m->alloc_bytes);
+  Json_objectSetInt(&entry, JSON_STRLIT("frees"), (Json_Integer)m->frees);
+  if (items) Json_objectSetNum(&entry, JSON_STRLIT("items_per_s"), (double)items / m->seconds);
+
+  Json_String corpus_name = {JSON_FALSE, strlen(corpus), (char *)(void *)corpus};
+  Json_String op_name = {JSON_FALSE, strlen(op), (char *)(void *)op};
+
+  Json_Value *group = Json_objectGet(results, corpus_name);
+  if (!group) {
+    Json_Value tmp;
+    emptyObject(&tmp);
+    Json_objectSet(results, corpus_name, &tmp);
+    group = Json_objectGet(results, corpus_name);
+  }
+
+  Json_objectSet(group, op_name, &entry);
+}
+
+static Json_Boolean sameText(const Json_Value *a, const Json_Value *b)
+{
+  Json_Sink sa, sb;
+  Json_sinkInitBuffer(&sa);
+  Json_sinkInitBuffer(&sb);
+
+  const Json_Boolean same = Json_serialize(a, NULL, &sa) && Json_serialize(b, NULL, &sb)
+    && sa.len == sb.len && !memcmp(sa.data, sb.data, sa.len);
+
+  Json_sinkDestroy(&sa);
+  Json_sinkDestroy(&sb);
+  return same;
+}
+
+// the timings only mean something if every path reads the corpus the same way
+static void checkDocument(const char *corpus, const Buf *buf)
+{
+  Json_Value tree, other;
+  if (Json_parseStr(buf->len, buf->data, &tree) != buf->len) {
+    fprintf(stderr, "%s: parse failed\n", corpus);
+    exit(1);
+  }
+
+  const size_t parallel = Json_parseStrParallel(buf->len, buf->data, &other, NULL);
+  const Json_Boolean parallel_same = parallel == buf->len && sameText(&tree, &other);
+  Json_destroyValue(&other);
+
+  Json_Sink text;
+  Json_sinkInitBuffer(&text);
+  Json_serialize(&tree, NULL, &text);
+  const size_t reread = Json_parseStr(text.len, text.data, &other);
+  const Json_Boolean reread_same = reread == text.len && sameText(&tree, &other);
+  Json_destroyValue(&other);
+  Json_sinkDestroy(&text);
+
+  Json_Tape tape, built;
+  const size_t taped = Json_parseTape(buf->len, buf->data, &tape);
+  const Json_Boolean tape_same = taped == buf->len && Json_tapeFromValue(&tree, &built)
+    && tape.len == built.len && !memcmp(tape.words, built.words, tape.len * sizeof(tape.words[0]))
+    && tape.strings_len == built.strings_len && !memcmp(tape.strings, built.strings, tape.strings_len);
+  Json_destroyTape(&tape);
+  Json_destroyTape(&built);
+  Json_destroyValue(&tree);
+
+  if (!parallel_same || !reread_same || !tape_same) {
+    fprintf(stderr, "%s: parallel %d, reread %d, tape %d disagree with the parse\n",
+      corpus, !parallel_same, !reread_same, !tape_same);
+    exit(1);
+  }
+}
+
+// parse, serialize, print and destroy one document
+static void benchDocument(Json_Value *results, const char *corpus, const Buf *buf)
+{
+  Measure best = {0, 0, 0, 0}, m;
+  Json_Value val;
+
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    measureStart(&m);
+    const size_t len = Json_parseStr(buf->len, buf->data, &val);
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+
+    if (!len) {
+      fprintf(stderr, "%s: parse failed\n", corpus);
+      exit(1);
+    }
+    Json_destroyValue(&val);
+  }
+  report(results, corpus, "parse", &best, buf->len, 0);
+
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    measureStart(&m);
+    const size_t len = Json_parseStrParallel(buf->len, buf->data, &val, NULL);
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+
+    if (!len) {
+      fprintf(stderr, "%s: parallel parse failed\n", corpus);
+      exit(1);
+    }
+    Json_destroyValue(&val);
+  }
+  report(results, corpus, "parallel", &best, buf->len, 0);
+
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    Json_Tape tape;
+    measureStart(&m);
+    const size_t len = Json_parseTape(buf->len, buf->data, &tape);
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+
+    if (!len) {
+      fprintf(stderr, "%s: tape parse failed\n", corpus);
+      exit(1);
+    }
+    Json_destroyTape(&tape);
+  }
+  report(results, corpus, "tape", &best, buf->len, 0);
+
+  // the writers all work on one more copy
+  Json_parseStr(buf->len, buf->data, &val);
+
+  size_t out_len = 0;
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    Json_Sink sink;
+    Json_sinkInitBuffer(&sink);
+
+    measureStart(&m);
+    Json_serialize(&val, NULL, &sink);
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+
+    out_len = sink.len;
+    Json_sinkDestroy(&sink);
+  }
+  report(results, corpus, "serialize", &best, out_len, 0);
+
+  size_t pretty_len = 0;
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    Json_WriteOptions opts = {JSON_WRITE_PRETTY, NULL, NULL};
+    Json_Sink sink;
+    pretty_len = 0;
+    Json_sinkInit(&sink, writeCount, &pretty_len);
+
+    measureStart(&m);
+    Json_serialize(&val, &opts, &sink);
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+
+    Json_sinkDestroy(&sink);
+  }
+  report(results, corpus, "pretty", &best, pretty_len, 0);
+
+  // Json_printValue is the same pretty writer going through stdio
+  FILE *null = fopen("/dev/null", "w");
+  if (null) {
+    for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+      measureStart(&m);
+      Json_printValue(null, &val);
+      measureEnd(&m);
+      keepBest(&best, &m, run);
+    }
+
+    fclose(null);
+    report(results, corpus, "print", &best, pretty_len + 1, 0);
+  }
+
+  // loading a saved binary against the json it replaces; the root's length
+  // is read so the mapping is at least touched
+  static const char *bin_path = "bench_binary.tmp";
+  FILE *bin = fopen(bin_path, "wb");
+  if (bin && Json_saveBinary(bin, &val)) {
+    fclose(bin);
+    bin = NULL;
+
+    size_t touched = 0;
+    for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+      Json_Binary loaded;
+      measureStart(&m);
+      if (!Json_loadBinary(bin_path, &loaded)) {
+        fprintf(stderr, "%s: binary load failed\n", corpus);
+        exit(1);
+      }
+      touched += Json_tapeLen(Json_tapeRoot(&loaded.tape));
+      Json_unloadBinary(&loaded);
+      measureEnd(&m);
+      keepBest(&best, &m, run);
+    }
+
+    report(results, corpus, "reload", &best, buf->len, 0);
+    (void)touched;
+  }
+  if (bin) fclose(bin);
+  remove(bin_path);
+
+  measureStart(&m);
+  Json_destroyValue(&val);
+  measureEnd(&m);
+  report(results, corpus, "destroy", &m, buf->len, 0);
+}
+
+// Json_objectGet over every field of every object in the wide corpus
+static void benchLookups(Json_Value *results, const Buf *buf)
+{
+  Json_Value val;
+  if (!Json_parseStr(buf->len, buf->data, &val)) exit(1);
+
+  char keys[256][16];
+  Json_String names[256];
+  for (int j = 0; j < 256; ++j) {
+    names[j].is_heap = JSON_FALSE;
+    names[j].len = (size_t)sprintf(keys[j], "field_%d", j);
+    names[j].data = keys[j];
+  }
+
+  Measure best = {0, 0, 0, 0}, m;
+  size_t found = 0, lookups = 0;
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    lookups = 0;
+    measureStart(&m);
+    for (int rep = 0; rep < 10; ++rep) {
+      for (size_t i = 0; i < val.v.as_array.len; ++i) {
+        for (int j = 0; j < 256; ++j) {
+          // a stride through the keys so the access order isn't the insertion order
+          found += Json_objectGet(&val.v.as_array.elems[i], names[(j * 97) & 255]) != NULL;
+          ++lookups;
+        }
+      }
+    }
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+  }
+
+  if (found == 0) exit(1);
+  report(results, "wide", "lookup", &best, 0, lookups);
+  Json_destroyValue(&val);
+}
+
+// three fields out of every record of the wide corpus, without parsing it
+static void benchCursor(Json_Value *results, const Buf *buf)
+{
+  Measure best = {0, 0, 0, 0}, m;
+  double sum = 0;
+
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    measureStart(&m);
+
+    Json_Cursor root, record;
+    Json_CursorIter iter;
+    Json_cursorInit(&root, buf->len, buf->data);
+    Json_cursorIter(&root, &iter);
+    while (Json_cursorNext(&iter, NULL, &record)) {
+      sum += Json_cursorGetNum(&record, JSON_STRLIT("field_0"), 0);
+      sum += Json_cursorGetNum(&record, JSON_STRLIT("field_5"), 0);
+      sum += Json_cursorGetNum(&record, JSON_STRLIT("field_17"), 0);
+    }
+
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+  }
+
+  if (sum != sum) exit(1);
+  report(results, "wide", "cursor", &best, buf->len, 0);
+}
+
+static int sumMatch(void *user, const Json_Cursor *value)
+{
+  *(double *)user += Json_cursorNum(value, 0);
+  return JSON_EVENT_CONTINUE;
+}
+
+static void benchQuery(Json_Value *results, const Buf *buf)
+{
+  Measure best = {0, 0, 0, 0}, m;
+  double sum = 0;
+
+  Json_Query query;
+  if (!Json_queryCompile(&query, JSON_STRLIT("/*/field_17"))) exit(1);
+
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    measureStart(&m);
+    const size_t count = Json_queryRun(&query, buf->len, buf->data, sumMatch, &sum);
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+
+    if (!count) exit(1);
+  }
+
+  Json_queryDestroy(&query);
+  if (sum != sum) exit(1);
+  report(results, "wide", "query", &best, buf->len, 0);
+}
+
+static void benchLines(Json_Value *results, const Buf *buf, Json_KeyPool *keys)
+{
+  Measure best = {0, 0, 0, 0}, m;
+  Json_LinesOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.parse.keys = keys;
+
+  for (int run = 0; run < BENCH_MIN_RUNS || best.seconds * run < BENCH_MIN_SECONDS; ++run) {
+    Json_Value val;
+    measureStart(&m);
+    const size_t count = Json_parseLines(buf->len, buf->data, &val, &opts);
+    measureEnd(&m);
+    keepBest(&best, &m, run);
+
+    if (!count) exit(1);
+    Json_destroyValue(&val);
+  }
+
+  report(results, "ndjson", (keys)? "keypool" : "parse", &best, buf->len, 0);
+}
+
+int main(int argc, char **argv)
+{
+  const char *out_path = (argc > 1)? argv[1] : "bench_results.json";
+  Json_setAllocator(&bench_allocator);
+
+  static const struct {
+    const char *name;
+    void (*gen)(Buf *buf);
+  } corpora[] = {
+    {"wide", genWide},
+    {"deep", genDeep},
+    {"numbers", genNumbers},
+    {"strings", genStrings},
+  };
+
+  Json_Value results;
+  emptyObject(&results);
+
+  Buf wide = {NULL, 0, 0};
+  for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i) {
+    Buf buf = {NULL, 0, 0};
+    corpora[i].gen(&buf);
+    printf("%-8s %zu bytes\n", corpora[i].name, buf.len);
+
+    checkDocument(corpora[i].name, &buf);
+    benchDocument(&results, corpora[i].name, &buf);
+    if (corpora[i].gen == genWide) wide = buf;
+    else free(buf.data);
+  }
+
+  benchLookups(&results, &wide);
+  benchCursor(&results, &wide);
+  benchQuery(&results, &wide);
+  free(wide.data);
+
+  Buf lines = {NULL, 0, 0};
+  genLines(&lines);
+  printf("%-8s %zu bytes\n", "ndjson", lines.len);
+  benchLines(&results, &lines, NULL);
+
+  Json_KeyPool keys;
+  Json_keyPoolInit(&keys);
+  benchLines(&results, &lines, &keys);
+  Json_keyPoolDestroy(&keys);
+  free(lines.data);
+
+  FILE *file = fopen(out_path, "w");
+  if (!file) {
+    fprintf(stderr, "can't write %s\n", out_path);
+    return 1;
+  }
+
+  Json_printValue(file, &results);
+  fclose(file);
+  Json_destroyValue(&results);
+  return 0;
+}
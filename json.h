@@ -23,11 +23,18 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
 OTHER DEALINGS IN THE SOFTWARE.
 */
 
+// madvise and friends are hidden by strict -std modes unless asked for,
+// which only works when nothing includes a system header before this
+#if defined(JSON_IMPLEMENTATION) && !defined(_DEFAULT_SOURCE)
+# define _DEFAULT_SOURCE 1
+#endif
+
 #include <ctype.h>
 #include <malloc.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h> 
 
 #include <math.h> // needed for signbit, isnan, isinf, INFINITY, NAN
@@ -45,12 +52,17 @@ enum Json_Type_Enum {
   JSON_TYPE_NUMBER,
   JSON_TYPE_STRING,
   JSON_TYPE_ARRAY,
-  JSON_TYPE_OBJECT
+  JSON_TYPE_OBJECT,
+
+  // numbers written without a fraction or exponent that fit in 64 bits
+  // are kept exactly instead of being rounded to a double
+  JSON_TYPE_INTEGER
 };
 
 typedef struct Json_Value Json_Value;
 typedef int    Json_Boolean;
 typedef double Json_Number;
+typedef long long Json_Integer;
 
 typedef struct {
   Json_Boolean is_heap;
@@ -77,6 +89,8 @@ Json_String Json__impl_strLit(size_t len, const char *s)
 # define JSON_STRLIT(s) (Json_String){JSON_FALSE, sizeof(s) - 1, "" s ""}
 #endif
 
+// container storage has a header in front, so elems and field_values only
+// come from json.h; hand-built containers start out zeroed
 typedef struct {
   size_t len;
   size_t cap;
@@ -90,50 +104,633 @@ typedef struct {
   Json_Value  *field_values;
 } Json_Object;
 
+// objects with at least this many fields get a hash index of their names
+#ifndef JSON_OBJECT_INDEX_MIN
+# define JSON_OBJECT_INDEX_MIN 16
+#endif
+
 struct Json_Value {
   Json_Type type;
   union {
     Json_Boolean as_boolean;
     Json_Number  as_number;
+    Json_Integer as_integer;
     Json_String  as_string;
     Json_Array   as_array;
     Json_Object  as_object;
   } v;
 };
 
+// bump allocator for whole documents, released at once with
+// Json_arenaReset/Json_arenaDestroy instead of Json_destroyValue
+#ifndef JSON_ARENA_BLOCK_SIZE
+# define JSON_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+typedef struct Json_ArenaBlock Json_ArenaBlock;
+
+typedef struct {
+  size_t block_sz;
+  Json_ArenaBlock *first;
+  Json_ArenaBlock *cur;
+} Json_Arena;
+
+// where json.h's memory comes from, malloc by default; resize and release
+// never get NULL
+typedef struct {
+  void *(*alloc)(void *user, size_t sz);
+  void *(*resize)(void *user, void *ptr, size_t sz);
+  void  (*release)(void *user, void *ptr);
+  void *user;
+} Json_Allocator;
+
+// NULL restores malloc; only switch while nothing from the previous one is
+// alive, and heap strings handed to json.h must come from the current one
+void Json_setAllocator(const Json_Allocator *allocator);
+
 int Json_stringCmp(Json_String a, Json_String b);
 
+// a NUL terminated heap copy from the global allocator, data NULL on failure
+Json_String Json_stringDup(Json_String str);
+
 Json_Value *Json_asValue(Json_Value *out, Json_Type type, ...);
 void Json_destroyValue(Json_Value *value);
 
+// values parsed with their own allocator are read only until destroyed
+// with this
+void Json_destroyValueWith(Json_Value *value, const Json_Allocator *allocator);
+
 void Json_arrayAppend(Json_Value *array, const Json_Value *src);
 void Json_arrayDelete(Json_Value *array, size_t idx);
 void Json_destroyArray(Json_Value *array);
 
+// reserve makes room for at least cap members, shrink frees what isn't used
+Json_Boolean Json_arrayReserve(Json_Value *array, size_t cap);
+void Json_arrayShrink(Json_Value *array);
+
 void Json_objectSet(Json_Value *object, Json_String field, const Json_Value *src);
 void Json_objectSetNull(Json_Value *object, Json_String field);
 void Json_objectSetBool(Json_Value *object, Json_String field, Json_Boolean val);
 void Json_objectSetNum(Json_Value *object, Json_String field, Json_Number val);
+void Json_objectSetInt(Json_Value *object, Json_String field, Json_Integer val);
 void Json_objectSetStr(Json_Value *object, Json_String field, Json_String val);
 
 Json_Value   *Json_objectGet(Json_Value *object, Json_String field);
 Json_Boolean  Json_objectGetBool(Json_Value *object, Json_String field, Json_Boolean fallback);
 Json_Number   Json_objectGetNum(Json_Value *object, Json_String field, Json_Number fallback);
+Json_Integer  Json_objectGetInt(Json_Value *object, Json_String field, Json_Integer fallback);
 Json_String   Json_objectGetStr(Json_Value *object, Json_String field, Json_String fallback);
 
 void Json_objectDelete(Json_Value *object, Json_String field);
 void Json_destroyObject(Json_Value *object);
 
+Json_Boolean Json_objectReserve(Json_Value *object, size_t cap);
+void Json_objectShrink(Json_Value *object);
+
+// a deep copy that shares nothing with value, on the heap whatever value's
+// storage was; on failure out is left null
+Json_Boolean Json_clone(const Json_Value *value, Json_Value *out);
+
+// copy-on-write: a snapshot shares storage until a side changes it, one level
+// at a time, so edit below the root with Json_objectEdit/Json_arrayEdit; not
+// for values parsed with their own allocator
+Json_Boolean Json_snapshot(const Json_Value *value, Json_Value *out);
+
+// gives value storage of its own if it shares any, JSON_FALSE means an
+// allocation failed and it still shares
+Json_Boolean Json_unshare(Json_Value *value);
+
+// Json_objectGet and elems[idx], after unsharing the container
+Json_Value *Json_objectEdit(Json_Value *object, Json_String field);
+Json_Value *Json_arrayEdit(Json_Value *array, size_t idx);
+
+// shrinks every container and indexes big objects, so readers on any number
+// of threads never write; JSON_FALSE leaves value as it was
+Json_Boolean Json_freeze(Json_Value *value);
+
+// a frozen value shared by reference count, destroyed with the last reference
+typedef struct {
+  Json_Value root;
+  long refs;
+} Json_Frozen;
+
+// freezes value and moves it into a new Json_Frozen holding one reference,
+// leaving value null; on failure value is left as it was
+Json_Frozen *Json_frozenCreate(Json_Value *value);
+Json_Frozen *Json_frozenRetain(Json_Frozen *doc);
+void Json_frozenRelease(Json_Frozen *doc);
+
+// the current version of a document: acquire never waits, swap takes over
+// doc and only waits out acquires in flight
+typedef struct {
+  Json_Frozen *current;
+  long readers[2]; // acquires in flight, by epoch
+  long epoch;
+  long writing;
+} Json_Published;
+
+void Json_publishInit(Json_Published *slot, Json_Frozen *doc);
+Json_Frozen *Json_publishAcquire(Json_Published *slot);
+void Json_publishSwap(Json_Published *slot, Json_Frozen *doc);
+void Json_publishDestroy(Json_Published *slot);
+
+// writes val so that it reads back exactly into buf (JSON_NUMBER_BUFSZ bytes),
+// NUL terminated, and returns the length; Grisu2 is shortest for all but a few
+// doubles, and non-finite values give Infinity, -Infinity and NaN
+#define JSON_NUMBER_BUFSZ 32
+size_t Json_formatNumber(char *buf, Json_Number val);
+size_t Json_formatInteger(char *buf, Json_Integer val);
+
 void Json_printValue(FILE *file, const Json_Value *value);
+
+// every parse returns the bytes it read (trailing whitespace included), or 0
+// with out left null when the input is malformed or memory ran out
 size_t Json_parseFile(FILE *file, Json_Value *out);
 size_t Json_parseStr(size_t buf_sz, const char *buffer, Json_Value *out);
 
+void  Json_arenaInit(Json_Arena *arena, size_t block_sz);
+void *Json_arenaAlloc(Json_Arena *arena, size_t sz);
+void  Json_arenaReset(Json_Arena *arena);
+void  Json_arenaDestroy(Json_Arena *arena);
+
+// values parsed into an arena stay valid until the arena is reset or destroyed
+// and must not be passed to Json_destroyValue
+size_t Json_parseFileArena(Json_Arena *arena, FILE *file, Json_Value *out);
+size_t Json_parseStrArena(Json_Arena *arena, size_t buf_sz, const char *buffer, Json_Value *out);
+
+// interned keys shared by every document parsed with the pool, which has to
+// outlive them; pooled names compare by pointer first
+#ifndef JSON_KEY_POOL_MAX_LEN
+# define JSON_KEY_POOL_MAX_LEN 64    // longer keys are never interned
+#endif
+
+#ifndef JSON_KEY_POOL_MAX_KEYS
+# define JSON_KEY_POOL_MAX_KEYS 4096 // once full, only known keys are shared
+#endif
+
+typedef struct {
+  size_t len;
+  size_t cap;
+  Json_String *names; // open addressing, an empty slot has no data
+  Json_Arena arena;   // the interned bytes
+} Json_KeyPool;
+
+void Json_keyPoolInit(Json_KeyPool *pool);
+void Json_keyPoolDestroy(Json_KeyPool *pool);
+
+// returns the pool's copy of name, adding it if needed; name itself comes
+// back when it can't be interned
+Json_String Json_keyPoolIntern(Json_KeyPool *pool, Json_String name);
+
+// strings without escapes slice the source buffer instead of being copied,
+// so the buffer must outlive the value
+#define JSON_PARSE_BORROW 0x1u
+
+// what parses and writes cost, added to so one Json_Stats can sum calls; only
+// json.h's own allocations count, and threads add up their peaks
+typedef struct {
+  size_t allocs;     // allocations and reallocations
+  size_t bytes;      // bytes they asked for
+  size_t live_bytes; // bytes still held afterwards, i.e. by the values
+  size_t peak_bytes; // most bytes held at once
+  size_t nodes;      // values created (or written)
+  double seconds;    // wall clock time
+} Json_Stats;
+
+typedef struct {
+  Json_Arena *arena;               // optional, see Json_parseStrArena
+  unsigned flags;                  // JSON_PARSE_* bits
+  Json_KeyPool *keys;              // optional, see Json_KeyPool
+  const Json_Allocator *allocator; // optional, see Json_destroyValueWith
+  Json_Stats *stats;               // optional
+} Json_ParseOptions;
+
+// when parsing a file, borrowed strings need somewhere to live after the call
+// returns, so JSON_PARSE_BORROW is only honoured together with an arena
+size_t Json_parseFileEx(FILE *file, Json_Value *out, const Json_ParseOptions *opts);
+size_t Json_parseStrEx(size_t buf_sz, const char *buffer, Json_Value *out, const Json_ParseOptions *opts);
+
+// a read-only view of a whole file, memory mapped where the platform allows it
+// and read into the heap otherwise; there is no size limit beyond the address space
+typedef struct {
+  const char *data;
+  size_t len;
+  Json_Boolean is_mapped;
+} Json_MappedFile;
+
+Json_Boolean Json_mapFile(const char *path, Json_MappedFile *out);
+void Json_unmapFile(Json_MappedFile *file);
+
+// parses straight from a mapping that is gone on return, so JSON_PARSE_BORROW
+// is ignored; to borrow, Json_mapFile and use Json_parseStrEx
+size_t Json_parseFileMapped(const char *path, Json_Value *out, const Json_ParseOptions *opts);
+
+// incremental parser for input that arrives in pieces; tokens may be split
+// anywhere across chunks
+typedef struct {
+  Json_Value value;
+  Json_String key; // pending field name when value is an object
+} Json_ParserFrame;
+
+typedef struct {
+  Json_ParseOptions opts;
+  int state;
+  Json_Boolean failed;
+
+  size_t depth;
+  size_t stack_cap;
+  Json_ParserFrame *stack;
+
+  // the token being read when a chunk ends in the middle of it
+  Json_Boolean tok_escaped;
+  Json_Boolean tok_has_escapes;
+  size_t tok_len;
+  size_t tok_cap;
+  char *tok;
+
+  Json_Value root;
+} Json_Parser;
+
+// chunks are copied as needed, so JSON_PARSE_BORROW is ignored
+void Json_parserInit(Json_Parser *parser, const Json_ParseOptions *opts);
+
+// returns JSON_FALSE once the input seen so far can't be valid json
+Json_Boolean Json_parserFeed(Json_Parser *parser, const char *chunk, size_t len);
+
+// ends the input, on success the document is moved into out
+Json_Boolean Json_parserFinish(Json_Parser *parser, Json_Value *out);
+void Json_parserDestroy(Json_Parser *parser);
+
+// callback results; JSON_EVENT_SKIP skips a container (its end isn't called)
+// or, from key, that field's value
+#define JSON_EVENT_CONTINUE 0
+#define JSON_EVENT_SKIP     1
+#define JSON_EVENT_STOP     2
+
+// event driven parsing that builds no Json_Value at all; strings handed to the
+// callbacks are only valid during the call, any callback may be left NULL
+typedef struct {
+  void *user;
+  int (*start_object)(void *user);
+  int (*end_object)(void *user);
+  int (*start_array)(void *user);
+  int (*end_array)(void *user);
+  int (*key)(void *user, Json_String key);
+  int (*string)(void *user, Json_String val);
+  int (*number)(void *user, Json_Number val);
+  int (*boolean)(void *user, Json_Boolean val);
+  int (*null)(void *user);
+
+  // called for JSON_TYPE_INTEGER numbers, which go to number when it is NULL
+  int (*integer)(void *user, Json_Integer val);
+} Json_EventHandler;
+
+// returns the number of bytes consumed (up to the value that stopped it when
+// a callback returns JSON_EVENT_STOP), or 0 on malformed input
+size_t Json_parseEvents(size_t buf_sz, const char *buffer, const Json_EventHandler *handler);
+
+// newline delimited json (one document per line) parsed on a pool of worker
+// threads; define JSON_NO_THREADS to always parse on the calling thread
+typedef struct {
+  size_t nthreads; // 0 picks one per online cpu
+
+  // parse.arena is ignored, parse.keys is only filled from the first record
+  // and parse.allocator has to be thread safe
+  Json_ParseOptions parse;
+
+  // gets each record instead of out, on the workers in no particular order,
+  // and owns it (null if ok is JSON_FALSE)
+  void (*on_record)(void *user, size_t idx, Json_Value *record, Json_Boolean ok);
+  void *user;
+} Json_LinesOptions;
+
+// returns the number of records, blank lines skipped; out is an array of them
+// in input order, with null for lines that fail to parse
+size_t Json_parseLines(size_t buf_sz, const char *buffer, Json_Value *out, const Json_LinesOptions *opts);
+
+// parses the elements of big arrays on worker threads, once a quick scan has
+// found where each one starts and ends
+typedef struct {
+  size_t nthreads; // 0 picks one per online cpu
+
+  // parse.arena is ignored, parse.keys is only filled on the calling thread
+  // and parse.allocator has to be thread safe
+  Json_ParseOptions parse;
+
+  // depth of the arrays split up: 0 is a top-level array, 1 the ones directly
+  // inside the top-level value, and so on
+  size_t depth;
+} Json_ParallelOptions;
+
+// returns the number of bytes consumed like Json_parseStr
+size_t Json_parseStrParallel(size_t buf_sz, const char *buffer, Json_Value *out, const Json_ParallelOptions *opts);
+
+// on-demand access: a cursor is a position in the buffer, and lookups skip
+// values without decoding them; the buffer must outlive its cursors
+typedef struct {
+  const char *buffer;
+  size_t buf_sz;
+  size_t pos; // first byte of the value
+} Json_Cursor;
+
+// returns JSON_FALSE if the buffer holds nothing but whitespace
+Json_Boolean Json_cursorInit(Json_Cursor *out, size_t buf_sz, const char *buffer);
+
+// JSON_TYPE_NULL is also what malformed values report
+Json_Type Json_cursorType(const Json_Cursor *cur);
+
+// like Json_objectGet, a duplicated field finds its last value
+Json_Boolean Json_cursorGet(const Json_Cursor *object, Json_String field, Json_Cursor *out);
+Json_Boolean Json_cursorAt(const Json_Cursor *array, size_t idx, Json_Cursor *out);
+
+// convert like Json_objectGet*; decoded strings are on the heap (is_heap) for
+// the caller to free, the rest point into the buffer
+Json_Boolean Json_cursorBool(const Json_Cursor *cur, Json_Boolean fallback);
+Json_Number  Json_cursorNum(const Json_Cursor *cur, Json_Number fallback);
+Json_Integer Json_cursorInt(const Json_Cursor *cur, Json_Integer fallback);
+Json_String  Json_cursorStr(const Json_Cursor *cur, Json_String fallback);
+
+Json_Boolean Json_cursorGetBool(const Json_Cursor *object, Json_String field, Json_Boolean fallback);
+Json_Number  Json_cursorGetNum(const Json_Cursor *object, Json_String field, Json_Number fallback);
+Json_Integer Json_cursorGetInt(const Json_Cursor *object, Json_String field, Json_Integer fallback);
+Json_String  Json_cursorGetStr(const Json_Cursor *object, Json_String field, Json_String fallback);
+
+// fully parses the value under the cursor, returning the bytes consumed
+size_t Json_cursorValue(const Json_Cursor *cur, Json_Value *out, const Json_ParseOptions *opts);
+
+// walks the members of an object (key is the field name) or the elements
+// of an array (key is left alone), one at a time
+typedef struct {
+  Json_Cursor at; // where the next member starts
+  char close;     // ']' or '}'
+  Json_Boolean started;
+} Json_CursorIter;
+
+Json_Boolean Json_cursorIter(const Json_Cursor *container, Json_CursorIter *out);
+Json_Boolean Json_cursorNext(Json_CursorIter *iter, Json_Cursor *key, Json_Cursor *value);
+
+// read-only document as 64 bit words tagged in the top byte, plus a string
+// buffer; a container is its end index and count, then its children (names
+// before values), and a number is a tag word and its bits
+typedef struct {
+  unsigned long long *words;
+  size_t len;
+  size_t cap;
+
+  char *strings; // each one is an 8 byte length, the bytes and a NUL
+  size_t strings_len;
+  size_t strings_cap;
+} Json_Tape;
+
+// a node of a tape, valid as long as the tape is
+typedef struct {
+  const Json_Tape *tape;
+  size_t idx;
+} Json_TapeRef;
+
+// returns the number of bytes consumed like Json_parseStr, or 0 if the input
+// is malformed (in which case out is left empty)
+size_t Json_parseTape(size_t buf_sz, const char *buffer, Json_Tape *out);
+void Json_destroyTape(Json_Tape *tape);
+
+Json_TapeRef Json_tapeRoot(const Json_Tape *tape);
+Json_Type Json_tapeType(Json_TapeRef ref);
+
+// elements of an array or fields of an object, 0 for anything else
+size_t Json_tapeLen(Json_TapeRef ref);
+
+// fields are found by a linear walk that jumps over the values in between,
+// and a duplicated field finds its first occurrence
+Json_Boolean Json_tapeGet(Json_TapeRef object, Json_String field, Json_TapeRef *out);
+Json_Boolean Json_tapeAt(Json_TapeRef array, size_t idx, Json_TapeRef *out);
+
+// these convert like the Json_objectGet* functions; strings point into the
+// tape, except numbers formatted as strings which are on the heap
+Json_Boolean Json_tapeBool(Json_TapeRef ref, Json_Boolean fallback);
+Json_Number  Json_tapeNum(Json_TapeRef ref, Json_Number fallback);
+Json_Integer Json_tapeInt(Json_TapeRef ref, Json_Integer fallback);
+Json_String  Json_tapeStr(Json_TapeRef ref, Json_String fallback);
+
+Json_Boolean Json_tapeGetBool(Json_TapeRef object, Json_String field, Json_Boolean fallback);
+Json_Number  Json_tapeGetNum(Json_TapeRef object, Json_String field, Json_Number fallback);
+Json_Integer Json_tapeGetInt(Json_TapeRef object, Json_String field, Json_Integer fallback);
+Json_String  Json_tapeGetStr(Json_TapeRef object, Json_String field, Json_String fallback);
+
+// like Json_CursorIter, over a tape
+typedef struct {
+  Json_TapeRef at; // the next member
+  size_t end;
+  Json_Boolean is_object;
+} Json_TapeIter;
+
+Json_Boolean Json_tapeIter(Json_TapeRef container, Json_TapeIter *out);
+Json_Boolean Json_tapeNext(Json_TapeIter *iter, Json_String *key, Json_TapeRef *value);
+
+// the tape of a parsed (or built) value, with the same layout Json_parseTape gives
+Json_Boolean Json_tapeFromValue(const Json_Value *value, Json_Tape *out);
+
+// tape files: a 32 byte header, the words and the strings in native byte
+// order; loading maps the file and checks every word once, so a corrupt
+// file fails to load rather than reading out of bounds
+Json_Boolean Json_saveBinary(FILE *file, const Json_Value *value);
+Json_Boolean Json_saveTape(FILE *file, const Json_Tape *tape);
+
+typedef struct {
+  Json_MappedFile file;
+  Json_Tape tape; // points into file, never Json_destroyTape it
+} Json_Binary;
+
+Json_Boolean Json_loadBinary(const char *path, Json_Binary *out);
+void Json_unloadBinary(Json_Binary *binary);
+
+// RFC 6901 pointers compiled once, run over buffers or parsed values; as an
+// extension a "*" segment matches every field or element
+typedef struct {
+  Json_String name;       // with ~0 and ~1 decoded
+  size_t index;           // name as an array index, or (size_t)-1
+  Json_Boolean wildcard;
+} Json_QuerySegment;
+
+typedef struct {
+  size_t len;
+  Json_QuerySegment *segments;
+  char *names;
+} Json_Query;
+
+// returns JSON_FALSE for anything that isn't a valid pointer
+Json_Boolean Json_queryCompile(Json_Query *out, Json_String pointer);
+void Json_queryDestroy(Json_Query *query);
+
+// on_match gets matches in document order and may JSON_EVENT_STOP; both
+// return the match count. A duplicated field matches its last value, as with
+// Json_objectGet
+size_t Json_queryRun(
+  const Json_Query *query,
+  size_t buf_sz,
+  const char *buffer,
+  int (*on_match)(void *user, const Json_Cursor *value),
+  void *user
+);
+
+size_t Json_queryValue(
+  const Json_Query *query,
+  Json_Value *root,
+  int (*on_match)(void *user, Json_Value *value),
+  void *user
+);
+
+// serializer output; with a write callback it goes out in JSON_SINK_CHUNK
+// pieces, otherwise data grows to hold the document (NUL terminated)
+#ifndef JSON_SINK_CHUNK
+#define JSON_SINK_CHUNK (16 * 1024)
+#endif
+
+typedef struct {
+  // returns JSON_FALSE on failure, which stops the serializer
+  Json_Boolean (*write)(void *user, const char *data, size_t len);
+  void *user;
+
+  char *data;
+  size_t len;
+  size_t cap;
+  Json_Boolean failed;
+} Json_Sink;
+
+void Json_sinkInitBuffer(Json_Sink *sink);
+void Json_sinkInit(Json_Sink *sink, Json_Boolean (*write)(void *user, const char *data, size_t len), void *user);
+Json_Boolean Json_sinkWrite(Json_Sink *sink, const char *data, size_t len);
+Json_Boolean Json_sinkFlush(Json_Sink *sink);
+void Json_sinkDestroy(Json_Sink *sink);
+
+// newlines and indentation, as Json_printValue does
+#define JSON_WRITE_PRETTY 0x1u
+
+// non-ASCII goes out as UTF-8 and only quotes, backslashes and control
+// characters are escaped; invalid UTF-8 still becomes \ufffd
+#define JSON_WRITE_RAW_UTF8 0x2u
+
+typedef struct {
+  unsigned flags;     // JSON_WRITE_* bits
+  const char *indent; // one level of pretty printing, a tab when NULL
+  Json_Stats *stats;  // optional, only nodes and seconds apply
+} Json_WriteOptions;
+
+// compact unless opts says otherwise; callback sinks are flushed before
+// returning, and JSON_FALSE means a write or allocation failed
+Json_Boolean Json_serialize(const Json_Value *value, const Json_WriteOptions *opts, Json_Sink *sink);
+
+// writes str quoted and escaped like Json_serialize (only JSON_WRITE_RAW_UTF8
+// matters in flags); the sink isn't flushed
+Json_Boolean Json_serializeString(Json_String str, unsigned flags, Json_Sink *sink);
+
 #endif // !JSON_H_
 
 #ifdef JSON_IMPLEMENTATION
 
+#if defined(__unix__) || defined(__APPLE__)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/time.h>
+# include <unistd.h>
+# define JSON__HAVE_MMAP 1
+#else
+# include <time.h>
+#endif
+
+// vectorized scanning, SSE2 is part of every x86-64 cpu and AVX2 is picked
+// at runtime; define JSON_NO_SIMD to use the scalar loops only
+#if !defined(JSON_NO_SIMD) && defined(__GNUC__) \
+    && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+# include <immintrin.h>
+# define JSON__HAVE_SSE2 1
+#endif
+
+#if !defined(JSON_NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+# include <pthread.h>
+# define JSON__HAVE_THREADS 1
+#endif
+
+static
+void *Json__libcAlloc(void *user, size_t sz)
+{
+  (void)user;
+  return malloc(sz);
+}
+
+static
+void *Json__libcResize(void *user, void *ptr, size_t sz)
+{
+  (void)user;
+  return realloc(ptr, sz);
+}
+
+static
+void Json__libcRelease(void *user, void *ptr)
+{
+  (void)user;
+  free(ptr);
+}
+
+static Json_Allocator Json__allocator = {Json__libcAlloc, Json__libcResize, Json__libcRelease, NULL};
+
+void Json_setAllocator(const Json_Allocator *allocator)
+{
+  static const Json_Allocator libc = {Json__libcAlloc, Json__libcResize, Json__libcRelease, NULL};
+  Json__allocator = (allocator)? *allocator : libc;
+}
+
+// every allocation goes through these, a NULL allocator is the global one
+static
+void *Json__alloc(const Json_Allocator *allocator, size_t sz)
+{
+  if (!allocator) allocator = &Json__allocator;
+  return allocator->alloc(allocator->user, sz);
+}
+
+static
+void *Json__resize(const Json_Allocator *allocator, void *ptr, size_t sz)
+{
+  if (!allocator) allocator = &Json__allocator;
+  if (!ptr) return allocator->alloc(allocator->user, sz);
+  return allocator->resize(allocator->user, ptr, sz);
+}
+
+static
+void *Json__calloc(const Json_Allocator *allocator, size_t n, size_t sz)
+{
+  if (sz && n > (size_t)-1 / sz) return NULL;
+
+  void *ptr = Json__alloc(allocator, n * sz);
+  if (ptr) memset(ptr, 0, n * sz);
+  return ptr;
+}
+
+static
+void Json__release(const Json_Allocator *allocator, void *ptr)
+{
+  if (!ptr) return;
+  if (!allocator) allocator = &Json__allocator;
+  allocator->release(allocator->user, ptr);
+}
+
+// seconds since some fixed point, for Json_Stats
+static
+double Json__now(void)
+{
+#ifdef JSON__HAVE_MMAP // i.e. some unix
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
 int Json_stringCmp(Json_String a, Json_String b)
 {
+  // interned names are the same pointer
+  if (a.data == b.data && a.len == b.len) return 0;
   if (!a.data && !b.data) return 0;
   if (!a.data) return -1;
   if (!b.data) return  1;
@@ -147,6 +744,24 @@ int Json_stringCmp(Json_String a, Json_String b)
   return cmp;
 }
 
+Json_String Json_stringDup(Json_String str)
+{
+  Json_String ret;
+  ret.is_heap = JSON_TRUE;
+  ret.len = str.len;
+  ret.data = (char *)Json__alloc(NULL, str.len + 1);
+
+  if (!ret.data) {
+    ret.is_heap = JSON_FALSE;
+    ret.len = 0;
+    return ret;
+  }
+
+  if (str.len) memcpy(ret.data, str.data, str.len);
+  ret.data[str.len] = '\0';
+  return ret;
+}
+
 Json_Value *Json_asValue(Json_Value *out, Json_Type type, ...)
 {
   if (!out) return NULL;
@@ -167,6 +782,10 @@ Json_Value *Json_asValue(Json_Value *out, Json_Type type, ...)
       out->v.as_number = va_arg(args, Json_Number);
       break;
 
+    case JSON_TYPE_INTEGER:
+      out->v.as_integer = va_arg(args, Json_Integer);
+      break;
+
     case JSON_TYPE_STRING:
       out->v.as_string = va_arg(args, Json_String);
       break;
@@ -186,142 +805,659 @@ Json_Value *Json_asValue(Json_Value *out, Json_Type type, ...)
 
 void Json_destroyValue(Json_Value *value)
 {
-  if (!value) return;
-
-  switch (value->type) {
-    case JSON_TYPE_STRING:
-      if (value->v.as_string.is_heap) {
-        free(value->v.as_string.data);
-      }
-      break;
+  Json_destroyValueWith(value, NULL);
+}
 
-    case JSON_TYPE_ARRAY:  Json_destroyArray(value);  break;
-    case JSON_TYPE_OBJECT: Json_destroyObject(value); break;
-    default: break;
-  }
+// sequentially consistent atomics for publishing and shared storage
+static
+long Json__atomicAdd(long *p, long n)
+{
+#ifdef JSON__HAVE_THREADS
+  return __atomic_add_fetch(p, n, __ATOMIC_SEQ_CST);
+#else
+  return *p += n;
+#endif
+}
 
-  memset(value, 0, sizeof(*value));
+static
+long Json__atomicLoad(long *p)
+{
+#ifdef JSON__HAVE_THREADS
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#else
+  return *p;
+#endif
 }
 
-void Json_arrayAppend(Json_Value *_array, const Json_Value *src)
+static
+long Json__atomicSwap(long *p, long val)
 {
-  if (!_array || !src) return;
-  if (_array->type != JSON_TYPE_ARRAY) return;
+#ifdef JSON__HAVE_THREADS
+  return __atomic_exchange_n(p, val, __ATOMIC_SEQ_CST);
+#else
+  const long old = *p;
+  *p = val;
+  return old;
+#endif
+}
 
-  Json_Array *array = &_array->v.as_array;
-  if (array->len + 1 > array->cap) {
-    array->cap = (array->cap < 128)? 128 : 2 * array->cap;
-    array->elems = (Json_Value *)realloc(array->elems, sizeof(Json_Value) * array->cap);
-    if (!array->elems) return; // TODO: actually do some error handling here
-  }
+static
+Json_Frozen *Json__atomicLoadFrozen(Json_Frozen **p)
+{
+#ifdef JSON__HAVE_THREADS
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#else
+  return *p;
+#endif
+}
 
-  array->elems[array->len] = *src;
-  ++array->len;
+static
+Json_Frozen *Json__atomicSwapFrozen(Json_Frozen **p, Json_Frozen *val)
+{
+#ifdef JSON__HAVE_THREADS
+  return __atomic_exchange_n(p, val, __ATOMIC_SEQ_CST);
+#else
+  Json_Frozen *old = *p;
+  *p = val;
+  return old;
+#endif
 }
 
-void Json_arrayDelete(Json_Value *_array, size_t idx)
+// the capacity a container that is out of room grows to
+static
+size_t Json__growCap(size_t cap)
 {
-  if (!_array) return;
-  if (_array->type != JSON_TYPE_ARRAY) return;
+  return (cap < 8)? 8 : 2 * cap;
+}
 
-  Json_Array *array = &_array->v.as_array;
-  if (idx > array->len) return;
+// how many bytes of input the structural index covers at a time
+#define JSON__INDEX_WINDOW 4096
 
-  memmove(
-    &array->elems[idx],
-    &array->elems[idx + 1],
-    sizeof(*array->elems) * (array->len - idx - 1)
-  );
+// structural index: offsets of the structural characters and token starts
+// outside strings, found a window at a time ahead of the parser
+typedef struct {
+  const char *buffer;
+  size_t buf_sz;
+  size_t window; // where the offsets in tokens count from
+  size_t end;    // where the next window starts
+  size_t len;
+  size_t next;
+  unsigned long long next_escaped;
+  unsigned long long in_string;
+  unsigned long long prev_scalar;
+  unsigned tokens[JSON__INDEX_WINDOW];
+} Json__Index;
+
+// state shared by every level of a parse; children wait on the stack until
+// their container closes and gets exact-size storage
+typedef struct {
+  Json_Arena *arena;
+  unsigned flags;
+  Json_KeyPool *keys;
+  const Json_Allocator *allocator;
+  Json_Stats *stats;
+  Json__Index *index;
+
+  Json_Value *stack;
+  size_t stack_len;
+  size_t stack_cap;
+} Json__ParseCtx;
 
-  --array->len;
+static
+void Json__parseInit(Json__ParseCtx *ctx, const Json_ParseOptions *opts)
+{
+  memset(ctx, 0, sizeof(*ctx));
+  if (!opts) return;
+
+  ctx->arena = opts->arena;
+  ctx->flags = opts->flags;
+  ctx->keys = opts->keys;
+  ctx->allocator = opts->allocator;
+  ctx->stats = opts->stats;
 }
 
-void Json_destroyArray(Json_Value *array)
+// records that a block of old_sz bytes now has new_sz (either may be 0)
+static
+void Json__parseTrack(Json__ParseCtx *ctx, size_t old_sz, size_t new_sz)
 {
-  if (!array) return;
-  if (array->type != JSON_TYPE_ARRAY) return;
+  if (!ctx || !ctx->stats) return;
 
-  for (size_t i = 0; i < array->v.as_array.len; ++i) {
-    Json_destroyValue(&array->v.as_array.elems[i]);
+  Json_Stats *stats = ctx->stats;
+  if (new_sz) {
+    ++stats->allocs;
+    stats->bytes += new_sz;
   }
 
-  free(array->v.as_array.elems);
-  array->type = JSON_TYPE_NULL;
-  array->v.as_array.cap = array->v.as_array.len = 0;
+  stats->live_bytes = (stats->live_bytes > old_sz)? stats->live_bytes - old_sz : 0;
+  stats->live_bytes += new_sz;
+  if (stats->live_bytes > stats->peak_bytes) stats->peak_bytes = stats->live_bytes;
 }
 
-void Json_objectSet(Json_Value *_object, Json_String field, const Json_Value *src)
+// storage for parsed values comes from the arena if there is one, from the
+// parse's allocator otherwise; a NULL ctx is the global allocator
+static
+void *Json__parseAlloc(Json__ParseCtx *ctx, size_t sz)
 {
-  if (!_object || !field.data || !src) return;
-  if (_object->type != JSON_TYPE_OBJECT) return;
-
-  Json_Object *object = &_object->v.as_object;
-  if (object->len + 1 > object->cap) {
-    object->cap = (object->cap < 128)? 128 : 2 * object->cap;
-    object->field_names = (Json_String *)realloc(
-      object->field_names, sizeof(*object->field_names) * object->cap
-    );
+  void *ptr = (ctx && ctx->arena)? Json_arenaAlloc(ctx->arena, sz) :
+                                   Json__alloc((ctx)? ctx->allocator : NULL, sz);
+  if (ptr) Json__parseTrack(ctx, 0, sz);
+  return ptr;
+}
 
-    object->field_values = (Json_Value *)realloc(
-      object->field_values, sizeof(*object->field_values) * object->cap
-    );
+static
+void Json__parseFree(Json__ParseCtx *ctx, void *ptr, size_t sz)
+{
+  if (!ptr) return;
 
-    if (!object->field_names || !object->field_values) return; // TODO: error handling
-  }
+  Json__parseTrack(ctx, sz, 0);
+  if (!ctx || !ctx->arena) Json__release((ctx)? ctx->allocator : NULL, ptr);
+}
 
-  for (size_t i = 0; i < object->len; ++i) {
-    if (Json_stringCmp(object->field_names[i], field)) continue;
-    Json_destroyObject(&object->field_values[i]);
-    object->field_values[i] = *src;
-    return;
-  }
+static
+void *Json__arenaRealloc(Json_Arena *arena, void *ptr, size_t old_sz, size_t new_sz);
 
-  object->field_names[object->len]  = field;
-  object->field_values[object->len] = *src;
-  ++object->len;
+static
+void *Json__parseRealloc(Json__ParseCtx *ctx, void *ptr, size_t old_sz, size_t new_sz)
+{
+  void *grown = (ctx && ctx->arena)? Json__arenaRealloc(ctx->arena, ptr, old_sz, new_sz) :
+                                      Json__resize((ctx)? ctx->allocator : NULL, ptr, new_sz);
+  if (grown) Json__parseTrack(ctx, old_sz, new_sz);
+  return grown;
 }
 
-void Json_objectSetNull(Json_Value *object, Json_String field)
+// header before container storage: refs (0 when borrowed from an arena) and
+// the object index
+typedef struct {
+  long refs;
+  size_t index_cap;
+  size_t *index; // field positions + 1, 0 is an empty slot
+} Json__Storage;
+
+static
+Json__Storage *Json__storageOf(const void *data)
 {
-  static const Json_Value null = {JSON_TYPE_NULL, {0}};
-  Json_objectSet(object, field, &null);
+  return (data)? (Json__Storage *)data - 1 : NULL;
 }
 
-void Json_objectSetBool(Json_Value *object, Json_String field, Json_Boolean val)
+// 1 for storage that can be changed in place (including none at all)
+static
+long Json__storageRefs(const void *data)
 {
-  Json_Value tmp;
-  Json_objectSet(object, field, Json_asValue(&tmp, JSON_TYPE_BOOLEAN, val));
+  return (data)? Json__atomicLoad(&Json__storageOf(data)->refs) : 1;
 }
 
-void Json_objectSetNum(Json_Value *object, Json_String field, Json_Number val)
+static
+void *Json__storageAlloc(Json__ParseCtx *ctx, size_t sz)
+{
+  Json__Storage *hdr = (Json__Storage *)Json__parseAlloc(ctx, sizeof(Json__Storage) + sz);
+  if (!hdr) return NULL;
+
+  hdr->refs = (ctx && ctx->arena)? 0 : 1;
+  hdr->index_cap = 0;
+  hdr->index = NULL;
+  return hdr + 1;
+}
+
+static
+void *Json__storageRealloc(Json__ParseCtx *ctx, void *data, size_t old_sz, size_t new_sz)
+{
+  if (!data) return Json__storageAlloc(ctx, new_sz);
+
+  Json__Storage *hdr = (Json__Storage *)Json__parseRealloc(
+    ctx, Json__storageOf(data), sizeof(Json__Storage) + old_sz, sizeof(Json__Storage) + new_sz
+  );
+  return (hdr)? hdr + 1 : NULL;
+}
+
+static
+void Json__storageFree(Json__ParseCtx *ctx, void *data, size_t sz)
+{
+  if (data) Json__parseFree(ctx, Json__storageOf(data), sizeof(Json__Storage) + sz);
+}
+
+// gives array storage of its own with room for exactly cap (>= len) elements
+// stack storage for the one element arrays cursors and tapes decode
+typedef struct {
+  Json__Storage hdr;
+  Json_Value value;
+} Json__Single;
+
+static
+Json_Boolean Json__arrayRealloc(Json_Array *array, size_t cap)
+{
+  const long refs = Json__storageRefs(array->elems);
+  if (refs == 1) {
+    Json_Value *elems = NULL;
+    if (cap) {
+      elems = (Json_Value *)Json__storageRealloc(
+        NULL, array->elems, sizeof(Json_Value) * array->cap, sizeof(Json_Value) * cap
+      );
+      if (!elems) return JSON_FALSE;
+    } else {
+      Json__storageFree(NULL, array->elems, 0);
+    }
+
+    array->elems = elems;
+    array->cap = cap;
+    return JSON_TRUE;
+  }
+
+  // borrowed or shared storage is copied instead, the elements of shared
+  // storage as snapshots since it keeps them too
+  Json_Value *elems = NULL;
+  if (cap) {
+    elems = (Json_Value *)Json__storageAlloc(NULL, sizeof(Json_Value) * cap);
+    if (!elems) return JSON_FALSE;
+  }
+
+  if (!refs) {
+    if (array->len) memcpy(elems, array->elems, sizeof(Json_Value) * array->len);
+  } else {
+    for (size_t i = 0; i < array->len; ++i) {
+      if (!Json_snapshot(&array->elems[i], &elems[i])) {
+        while (i--) Json_destroyValue(&elems[i]);
+        Json__storageFree(NULL, elems, 0);
+        return JSON_FALSE;
+      }
+    }
+
+    Json_Value old;
+    old.type = JSON_TYPE_ARRAY;
+    old.v.as_array = *array;
+    Json_destroyValue(&old);
+  }
+
+  array->elems = elems;
+  array->cap = cap;
+  return JSON_TRUE;
+}
+
+void Json_arrayAppend(Json_Value *_array, const Json_Value *src)
+{
+  if (!_array || !src) return;
+  if (_array->type != JSON_TYPE_ARRAY) return;
+
+  Json_Array *array = &_array->v.as_array;
+  if (array->len + 1 > array->cap || Json__storageRefs(array->elems) != 1) {
+    size_t cap = array->cap;
+    if (array->len + 1 > cap) cap = Json__growCap(cap);
+    if (!Json__arrayRealloc(array, cap)) return; // TODO: actually do some error handling here
+  }
+
+  array->elems[array->len] = *src;
+  ++array->len;
+}
+
+Json_Boolean Json_arrayReserve(Json_Value *_array, size_t cap)
+{
+  if (!_array || _array->type != JSON_TYPE_ARRAY) return JSON_FALSE;
+
+  Json_Array *array = &_array->v.as_array;
+  if (cap <= array->cap && Json__storageRefs(array->elems) == 1) return JSON_TRUE;
+  return Json__arrayRealloc(array, (cap > array->cap)? cap : array->cap);
+}
+
+void Json_arrayShrink(Json_Value *_array)
+{
+  if (!_array || _array->type != JSON_TYPE_ARRAY) return;
+
+  Json_Array *array = &_array->v.as_array;
+  if (array->cap > array->len && Json__storageRefs(array->elems) == 1) Json__arrayRealloc(array, array->len);
+}
+
+void Json_arrayDelete(Json_Value *_array, size_t idx)
+{
+  if (!_array) return;
+  if (_array->type != JSON_TYPE_ARRAY) return;
+
+  Json_Array *array = &_array->v.as_array;
+  if (idx >= array->len) return;
+  if (Json__storageRefs(array->elems) > 1) {
+    if (!Json__arrayRealloc(array, array->cap)) return;
+    // the copy of the deleted element made while unsharing is ours to drop
+    Json_destroyValue(&array->elems[idx]);
+  }
+
+  memmove(
+    &array->elems[idx],
+    &array->elems[idx + 1],
+    sizeof(*array->elems) * (array->len - idx - 1)
+  );
+
+  --array->len;
+}
+
+static
+void Json__destroyArray(Json_Value *array, const Json_Allocator *allocator)
+{
+  if (!array) return;
+  if (array->type != JSON_TYPE_ARRAY) return;
+
+  // storage somebody else still shares stays as it is
+  Json__Storage *hdr = Json__storageOf(array->v.as_array.elems);
+  const long refs = Json__storageRefs(array->v.as_array.elems);
+  if (refs > 1 && Json__atomicAdd(&hdr->refs, -1)) {
+    array->type = JSON_TYPE_NULL;
+    array->v.as_array.cap = array->v.as_array.len = 0;
+    return;
+  }
+
+  for (size_t i = 0; i < array->v.as_array.len; ++i) {
+    Json_destroyValueWith(&array->v.as_array.elems[i], allocator);
+  }
+
+  if (refs) Json__release(allocator, hdr);
+  array->type = JSON_TYPE_NULL;
+  array->v.as_array.cap = array->v.as_array.len = 0;
+}
+
+void Json_destroyArray(Json_Value *array)
+{
+  Json__destroyArray(array, NULL);
+}
+
+static
+size_t Json__hashString(Json_String str)
+{
+  // FNV-1a
+  unsigned long long hash = 14695981039346656037ull;
+  for (size_t i = 0; i < str.len; ++i) {
+    hash ^= (unsigned char)str.data[i];
+    hash *= 1099511628211ull;
+  }
+
+  return (size_t)(hash ^ (hash >> 32));
+}
+
+static
+void Json__objectIndexPut(Json_Object *object, size_t pos)
+{
+  Json__Storage *hdr = Json__storageOf(object->field_values);
+  const size_t mask = hdr->index_cap - 1;
+  size_t slot = Json__hashString(object->field_names[pos]) & mask;
+  while (hdr->index[slot]) slot = (slot + 1) & mask;
+  hdr->index[slot] = pos + 1;
+}
+
+// makes index (cap slots) the object's index, whatever it replaces is freed
+// by the caller
+static
+void Json__objectIndexFill(Json_Object *object, size_t *index, size_t cap)
+{
+  Json__Storage *hdr = Json__storageOf(object->field_values);
+  memset(index, 0, sizeof(size_t) * cap);
+  hdr->index = index;
+  hdr->index_cap = cap;
+
+  for (size_t i = 0; i < object->len; ++i) Json__objectIndexPut(object, i);
+}
+
+// (re)builds the index of an object, the table comes from the same place as
+// the rest of the object's storage
+static
+Json_Boolean Json__objectIndexBuild(Json_Object *object, Json__ParseCtx *ctx)
+{
+  Json__Storage *hdr = Json__storageOf(object->field_values);
+  size_t cap = (hdr->index_cap)? hdr->index_cap : 32;
+  while (cap < 2 * object->len) cap *= 2;
+
+  size_t *index = (size_t *)Json__parseAlloc(ctx, sizeof(size_t) * cap);
+  if (!index) return JSON_FALSE;
+
+  if (hdr->refs) Json__parseFree(ctx, hdr->index, sizeof(size_t) * hdr->index_cap);
+  Json__objectIndexFill(object, index, cap);
+  return JSON_TRUE;
+}
+
+// keeps the index in sync after a field was appended at object->len - 1
+static
+void Json__objectIndexAppended(Json_Object *object, Json__ParseCtx *ctx)
+{
+  Json__Storage *hdr = Json__storageOf(object->field_values);
+  if (!hdr->index && object->len < JSON_OBJECT_INDEX_MIN) return;
+
+  // Json__objectIndexBuild doubles the table as needed; if it can't, lookups
+  // go back to the linear scan until a later append builds one
+  if (!hdr->index || 2 * object->len > hdr->index_cap) {
+    if (!Json__objectIndexBuild(object, ctx) && hdr->index) {
+      if (hdr->refs) Json__parseFree(ctx, hdr->index, sizeof(size_t) * hdr->index_cap);
+      hdr->index = NULL;
+      hdr->index_cap = 0;
+    }
+    return;
+  }
+
+  Json__objectIndexPut(object, object->len - 1);
+}
+
+// returns the position of field, or object->len if it is missing
+static
+size_t Json__objectFind(const Json_Object *object, Json_String field)
+{
+  const Json__Storage *hdr = Json__storageOf(object->field_values);
+  if (hdr && hdr->index) {
+    const size_t mask = hdr->index_cap - 1;
+    for (size_t slot = Json__hashString(field) & mask; hdr->index[slot]; slot = (slot + 1) & mask) {
+      const size_t pos = hdr->index[slot] - 1;
+      if (!Json_stringCmp(object->field_names[pos], field)) return pos;
+    }
+
+    return object->len;
+  }
+
+  // an interned name is usually found by its pointer alone
+  for (size_t i = 0; i < object->len; ++i) {
+    const Json_String name = object->field_names[i];
+    if (name.len == field.len && (name.data == field.data || !memcmp(name.data, field.data, field.len))) return i;
+  }
+
+  return object->len;
+}
+
+// removes pos from the index and renumbers the fields that come after it,
+// must run before the field arrays are shifted down
+static
+void Json__objectIndexRemove(Json_Object *object, size_t pos)
+{
+  Json__Storage *hdr = Json__storageOf(object->field_values);
+  const size_t mask = hdr->index_cap - 1;
+  size_t hole = Json__hashString(object->field_names[pos]) & mask;
+  while (hdr->index[hole] != pos + 1) hole = (hole + 1) & mask;
+
+  // backward shift deletion, so linear probing never needs tombstones
+  for (size_t slot = (hole + 1) & mask; hdr->index[slot]; slot = (slot + 1) & mask) {
+    const size_t home = Json__hashString(object->field_names[hdr->index[slot] - 1]) & mask;
+    const Json_Boolean stays = (slot > hole)? (home > hole && home <= slot) :
+                                              (home > hole || home <= slot);
+    if (stays) continue;
+
+    hdr->index[hole] = hdr->index[slot];
+    hole = slot;
+  }
+
+  hdr->index[hole] = 0;
+
+  for (size_t slot = 0; slot < hdr->index_cap; ++slot) {
+    if (hdr->index[slot] > pos + 1) --hdr->index[slot];
+  }
+}
+
+// like Json__arrayRealloc, the heap names of shared storage get copies
+static
+Json_Boolean Json__objectRealloc(Json_Object *object, size_t cap)
+{
+  const long refs = Json__storageRefs(object->field_values);
+  if (refs == 1) {
+    if (!cap) {
+      Json__Storage *hdr = Json__storageOf(object->field_values);
+      if (hdr) Json__release(NULL, hdr->index);
+      Json__release(NULL, object->field_names);
+      Json__storageFree(NULL, object->field_values, 0);
+
+      object->field_names = NULL;
+      object->field_values = NULL;
+      object->cap = 0;
+      return JSON_TRUE;
+    }
+
+    Json_String *names = (Json_String *)Json__resize(NULL, object->field_names, sizeof(Json_String) * cap);
+    if (names) object->field_names = names;
+
+    Json_Value *values = (Json_Value *)Json__storageRealloc(
+      NULL, object->field_values, sizeof(Json_Value) * object->cap, sizeof(Json_Value) * cap
+    );
+    if (values) object->field_values = values;
+
+    // until both are resized only the smaller size is safe to use
+    if (!names || !values) {
+      if (cap < object->cap) object->cap = cap;
+      return JSON_FALSE;
+    }
+
+    object->cap = cap;
+    return JSON_TRUE;
+  }
+
+  Json_String *names = NULL;
+  Json_Value *values = NULL;
+  if (cap) {
+    names = (Json_String *)Json__alloc(NULL, sizeof(Json_String) * cap);
+    values = (Json_Value *)Json__storageAlloc(NULL, sizeof(Json_Value) * cap);
+    if (!names || !values) {
+      Json__release(NULL, names);
+      Json__storageFree(NULL, values, 0);
+      return JSON_FALSE;
+    }
+  }
+
+  if (!refs) {
+    if (object->len) {
+      memcpy(names, object->field_names, sizeof(Json_String) * object->len);
+      memcpy(values, object->field_values, sizeof(Json_Value) * object->len);
+    }
+  } else {
+    for (size_t i = 0; i < object->len; ++i) {
+      const Json_String name = object->field_names[i];
+      names[i] = (name.is_heap)? Json_stringDup(name) : name;
+
+      if (!names[i].data || !Json_snapshot(&object->field_values[i], &values[i])) {
+        if (names[i].is_heap) Json__release(NULL, names[i].data);
+        while (i--) {
+          if (names[i].is_heap) Json__release(NULL, names[i].data);
+          Json_destroyValue(&values[i]);
+        }
+
+        Json__release(NULL, names);
+        Json__storageFree(NULL, values, 0);
+        return JSON_FALSE;
+      }
+    }
+
+    Json_Value old;
+    old.type = JSON_TYPE_OBJECT;
+    old.v.as_object = *object;
+    Json_destroyValue(&old);
+  }
+
+  object->field_names = names;
+  object->field_values = values;
+  object->cap = cap;
+
+  // the old index stays with the old storage
+  if (object->len >= JSON_OBJECT_INDEX_MIN) Json__objectIndexBuild(object, NULL);
+  return JSON_TRUE;
+}
+
+void Json_objectSet(Json_Value *_object, Json_String field, const Json_Value *src)
+{
+  if (!_object || !field.data || !src) return;
+  if (_object->type != JSON_TYPE_OBJECT) return;
+
+  Json_Object *object = &_object->v.as_object;
+  if (object->len + 1 > object->cap || Json__storageRefs(object->field_values) != 1) {
+    size_t cap = object->cap;
+    if (object->len + 1 > cap) cap = Json__growCap(cap);
+    if (!Json__objectRealloc(object, cap)) return; // TODO: error handling
+  }
+
+  const size_t i = Json__objectFind(object, field);
+  if (i < object->len) {
+    Json_destroyValue(&object->field_values[i]);
+    object->field_values[i] = *src;
+
+    // the existing name is kept, so a heap copy of it is no longer needed
+    if (field.is_heap && field.data != object->field_names[i].data) Json__release(NULL, field.data);
+    return;
+  }
+
+  object->field_names[object->len]  = field;
+  object->field_values[object->len] = *src;
+  ++object->len;
+  Json__objectIndexAppended(object, NULL);
+}
+
+void Json_objectSetNull(Json_Value *object, Json_String field)
+{
+  static const Json_Value null = {JSON_TYPE_NULL, {0}};
+  Json_objectSet(object, field, &null);
+}
+
+void Json_objectSetBool(Json_Value *object, Json_String field, Json_Boolean val)
+{
+  Json_Value tmp;
+  Json_objectSet(object, field, Json_asValue(&tmp, JSON_TYPE_BOOLEAN, val));
+}
+
+void Json_objectSetNum(Json_Value *object, Json_String field, Json_Number val)
 {
   Json_Value tmp;
   Json_objectSet(object, field, Json_asValue(&tmp, JSON_TYPE_NUMBER, val));
 }
 
+void Json_objectSetInt(Json_Value *object, Json_String field, Json_Integer val)
+{
+  Json_Value tmp;
+  Json_objectSet(object, field, Json_asValue(&tmp, JSON_TYPE_INTEGER, val));
+}
+
 void Json_objectSetStr(Json_Value *object, Json_String field, Json_String val)
 {
   Json_Value tmp;
   Json_objectSet(object, field, Json_asValue(&tmp, JSON_TYPE_STRING, val));
 }
 
+Json_Boolean Json_objectReserve(Json_Value *_object, size_t cap)
+{
+  if (!_object || _object->type != JSON_TYPE_OBJECT) return JSON_FALSE;
+
+  Json_Object *object = &_object->v.as_object;
+  if (cap <= object->cap && Json__storageRefs(object->field_values) == 1) return JSON_TRUE;
+  return Json__objectRealloc(object, (cap > object->cap)? cap : object->cap);
+}
+
+void Json_objectShrink(Json_Value *_object)
+{
+  if (!_object || _object->type != JSON_TYPE_OBJECT) return;
+
+  Json_Object *object = &_object->v.as_object;
+  if (object->cap > object->len && Json__storageRefs(object->field_values) == 1) {
+    Json__objectRealloc(object, object->len);
+  }
+}
+
 Json_Value *Json_objectGet(Json_Value *_object, Json_String field)
 {
   if (!_object || !field.data) return NULL;
   if (_object->type != JSON_TYPE_OBJECT) return NULL;
 
-  const Json_Object *object = &_object->v.as_object;
-  for (size_t i = 0; i < object->len; ++i) {
-    if (Json_stringCmp(object->field_names[i], field)) continue;
-    return &object->field_values[i];
-  }
-
-  return NULL;
+  Json_Object *object = &_object->v.as_object;
+  const size_t i = Json__objectFind(object, field);
+  return (i < object->len)? &object->field_values[i] : NULL;
 }
 
-Json_Boolean Json_objectGetBool(Json_Value *object, Json_String field, Json_Boolean fallback)
+static
+Json_Boolean Json__valueBool(const Json_Value *out, Json_Boolean fallback)
 {
-  Json_Value *out = Json_objectGet(object, field);
   if (!out) return fallback;
 
   switch (out->type) {
@@ -330,6 +1466,10 @@ Json_Boolean Json_objectGetBool(Json_Value *object, Json_String field, Json_Bool
       if ((int)out->v.as_number > 2) return fallback;
       return !!(int)out->v.as_number;
 
+    case JSON_TYPE_INTEGER:
+      if (out->v.as_integer > 2) return fallback;
+      return !!out->v.as_integer;
+
     case JSON_TYPE_STRING:
       if (!Json_stringCmp(JSON_STRLIT("true"), out->v.as_string)) return JSON_TRUE;
       if (!Json_stringCmp(JSON_STRLIT("false"), out->v.as_string)) return JSON_FALSE;
@@ -347,14 +1487,20 @@ Json_Boolean Json_objectGetBool(Json_Value *object, Json_String field, Json_Bool
   return out->v.as_boolean;
 }
 
-Json_Number Json_objectGetNum(Json_Value *object, Json_String field, Json_Number fallback)
+Json_Boolean Json_objectGetBool(Json_Value *object, Json_String field, Json_Boolean fallback)
+{
+  return Json__valueBool(Json_objectGet(object, field), fallback);
+}
+
+static
+Json_Number Json__valueNum(const Json_Value *out, Json_Number fallback)
 {
-  Json_Value *out = Json_objectGet(object, field);
   if (!out) return fallback;
 
   switch (out->type) {
     case JSON_TYPE_NULL: return 0;
     case JSON_TYPE_BOOLEAN: return (Json_Number)out->v.as_boolean;
+    case JSON_TYPE_INTEGER: return (Json_Number)out->v.as_integer;
 
     case JSON_TYPE_STRING:
       if (!Json_stringCmp(JSON_STRLIT("Infinity"), out->v.as_string)) return INFINITY;
@@ -365,6 +1511,7 @@ Json_Number Json_objectGetNum(Json_Value *object, Json_String field, Json_Number
 
     case JSON_TYPE_ARRAY:
       if (out->v.as_array.len != 1) return fallback;
+      if (out->v.as_array.elems[0].type == JSON_TYPE_INTEGER) return (Json_Number)out->v.as_array.elems[0].v.as_integer;
       if (out->v.as_array.elems[0].type != JSON_TYPE_NUMBER) return fallback;
       return out->v.as_array.elems[0].v.as_number;
     
@@ -375,21 +1522,62 @@ Json_Number Json_objectGetNum(Json_Value *object, Json_String field, Json_Number
   return out->v.as_number;
 }
 
-Json_String Json_objectGetStr(Json_Value *object, Json_String field, Json_String fallback)
+Json_Number Json_objectGetNum(Json_Value *object, Json_String field, Json_Number fallback)
+{
+  return Json__valueNum(Json_objectGet(object, field), fallback);
+}
+
+static
+Json_Integer Json__valueInt(const Json_Value *out, Json_Integer fallback)
+{
+  if (!out) return fallback;
+
+  // doubles only convert when nothing is lost
+  switch (out->type) {
+    case JSON_TYPE_NULL: return 0;
+    case JSON_TYPE_BOOLEAN: return (Json_Integer)out->v.as_boolean;
+    case JSON_TYPE_NUMBER:
+      if (!(out->v.as_number >= -9223372036854775808.0 && out->v.as_number < 9223372036854775808.0)) return fallback;
+      if ((Json_Number)(Json_Integer)out->v.as_number != out->v.as_number) return fallback;
+      return (Json_Integer)out->v.as_number;
+
+    case JSON_TYPE_ARRAY:
+      if (out->v.as_array.len != 1) return fallback;
+      if (out->v.as_array.elems[0].type != JSON_TYPE_INTEGER) return fallback;
+      return out->v.as_array.elems[0].v.as_integer;
+
+    case JSON_TYPE_STRING:
+    case JSON_TYPE_OBJECT: return fallback;
+    default: break;
+  }
+
+  return out->v.as_integer;
+}
+
+Json_Integer Json_objectGetInt(Json_Value *object, Json_String field, Json_Integer fallback)
+{
+  return Json__valueInt(Json_objectGet(object, field), fallback);
+}
+
+static
+Json_String Json__valueStr(const Json_Value *out, Json_String fallback)
 {
-  Json_Value *out = Json_objectGet(object, field);
   if (!out) return fallback;
 
   // return value that will be used if the heap is needed
   Json_String ret = {JSON_TRUE, 0, NULL};
+  char num[JSON_NUMBER_BUFSZ];
 
   switch (out->type) {
     case JSON_TYPE_NULL: return JSON_STRLIT("");
     case JSON_TYPE_BOOLEAN: return (out->v.as_boolean)? JSON_STRLIT("true") : JSON_STRLIT("false");
     case JSON_TYPE_NUMBER:
-      ret.len = snprintf(NULL, 0, "%.16g", out->v.as_number);
-      ret.data = calloc(1, ret.len);
-      snprintf(ret.data, ret.len, "%.16g", out->v.as_number);
+    case JSON_TYPE_INTEGER:
+      ret.len = (out->type == JSON_TYPE_NUMBER)? Json_formatNumber(num, out->v.as_number) :
+                                                 Json_formatInteger(num, out->v.as_integer);
+      ret.data = (char *)Json__alloc(NULL, ret.len);
+      if (!ret.data) return fallback;
+      memcpy(ret.data, num, ret.len);
       return ret;
 
     case JSON_TYPE_ARRAY:
@@ -404,21 +1592,23 @@ Json_String Json_objectGetStr(Json_Value *object, Json_String field, Json_String
   return out->v.as_string;
 }
 
+Json_String Json_objectGetStr(Json_Value *object, Json_String field, Json_String fallback)
+{
+  return Json__valueStr(Json_objectGet(object, field), fallback);
+}
+
 void Json_objectDelete(Json_Value *_object, Json_String field)
 {
   if (!_object || !field.data) return;
   if (_object->type != JSON_TYPE_OBJECT) return;
 
   Json_Object *object = &_object->v.as_object;
-  size_t i;
-  for (i = 0; i < object->len; ++i) {
-    if (Json_stringCmp(object->field_names[i], field)) continue;
-    break;
-  }
-
+  const size_t i = Json__objectFind(object, field);
   if (i >= object->len) return;
+  if (Json__storageRefs(object->field_values) > 1 && !Json__objectRealloc(object, object->cap)) return;
 
-  if (object->field_names[i].is_heap) free(object->field_names[i].data);
+  if (Json__storageOf(object->field_values)->index) Json__objectIndexRemove(object, i);
+  if (object->field_names[i].is_heap) Json__release(NULL, object->field_names[i].data);
   Json_destroyValue(&object->field_values[i]);
 
   if (i < object->len - 1) {
@@ -438,408 +1628,4788 @@ void Json_objectDelete(Json_Value *_object, Json_String field)
   --object->len;
 }
 
-void Json_destroyObject(Json_Value *object)
+static
+void Json__destroyObject(Json_Value *object, const Json_Allocator *allocator)
 {
   if (!object) return;
   if (object->type != JSON_TYPE_OBJECT) return;
 
-  for (size_t i = 0; i < object->v.as_object.len; ++i) {
-    if (object->v.as_object.field_names[i].is_heap) {
-      free(object->v.as_object.field_names[i].data);
-    }
-    Json_destroyValue(&object->v.as_object.field_values[i]);
+  // storage somebody else still shares stays as it is
+  Json_Object *obj = &object->v.as_object;
+  Json__Storage *hdr = Json__storageOf(obj->field_values);
+  const long refs = Json__storageRefs(obj->field_values);
+  if (refs > 1 && Json__atomicAdd(&hdr->refs, -1)) {
+    object->type = JSON_TYPE_NULL;
+    obj->len = obj->cap = 0;
+    return;
+  }
+
+  for (size_t i = 0; i < obj->len; ++i) {
+    if (obj->field_names[i].is_heap) Json__release(allocator, obj->field_names[i].data);
+    Json_destroyValueWith(&obj->field_values[i], allocator);
   }
 
-  free(object->v.as_object.field_names);
-  free(object->v.as_object.field_values);
+  if (refs) {
+    if (hdr) Json__release(allocator, hdr->index);
+    Json__release(allocator, obj->field_names);
+    Json__release(allocator, hdr);
+  }
   object->type = JSON_TYPE_NULL;
-  object->v.as_object.len = object->v.as_object.cap = 0;
+  obj->len = obj->cap = 0;
 }
 
-static
-void Json__realPrintValue(
-  FILE *file,
-  const Json_Value *value,
-  int ntabs,
-  Json_Boolean omit_start_tabs
-)
+void Json_destroyObject(Json_Value *object)
 {
-  if (!file || !value) return;
+  Json__destroyObject(object, NULL);
+}
 
-  if (!omit_start_tabs) {
-    for (int i = 0; i < ntabs; ++i) putc('\t', file);
-  }
+void Json_destroyValueWith(Json_Value *value, const Json_Allocator *allocator)
+{
+  if (!value) return;
 
   switch (value->type) {
-    case JSON_TYPE_NULL: fprintf(file, "null"); break;
-
-    case JSON_TYPE_BOOLEAN:
-      fprintf(file, (value->v.as_boolean)? "true" : "false");
+    case JSON_TYPE_STRING:
+      if (value->v.as_string.is_heap) {
+        Json__release(allocator, value->v.as_string.data);
+      }
       break;
 
-    case JSON_TYPE_NUMBER: {
-      const char *str = isinf(value->v.as_number)? "-Infinity" :
-                        isnan(value->v.as_number)? "-NaN"      : NULL;
+    case JSON_TYPE_ARRAY:  Json__destroyArray(value, allocator);  break;
+    case JSON_TYPE_OBJECT: Json__destroyObject(value, allocator); break;
+    default: break;
+  }
+
+  memset(value, 0, sizeof(*value));
+}
 
-      if (str) {
-        if (!signbit(value->v.as_number)) ++str;
-        Json_Value tmp;
-        Json_String jstr = {JSON_FALSE, strlen(str), (char *)(void *)str};
-        Json_asValue(&tmp, JSON_TYPE_STRING, jstr);
+Json_Boolean Json_clone(const Json_Value *value, Json_Value *out)
+{
+  if (!value || !out) return JSON_FALSE;
+  memset(out, 0, sizeof(*out));
 
-        Json__realPrintValue(file, &tmp, ntabs, JSON_TRUE);
-        break;
-      }
+  switch (value->type) {
+    case JSON_TYPE_STRING: {
+      const Json_String str = Json_stringDup(value->v.as_string);
+      if (!str.data) return JSON_FALSE;
 
-      fprintf(file, "%.16g", value->v.as_number);
+      out->type = JSON_TYPE_STRING;
+      out->v.as_string = str;
     } break;
 
-    case JSON_TYPE_STRING:
-      putc('"', file);
-
-      for (size_t i = 0; i < value->v.as_string.len; ++i) {
-        unsigned long codepoint = ((unsigned long)value->v.as_string.data[i]) & 0xff;
-
-        if (codepoint <= 0x7f) {
-          switch ((char)codepoint) {
-            case '"':  fprintf(file, "\\\""); continue;
-            case '\\': fprintf(file, "\\\\"); continue;
-            case '/':  fprintf(file, "\\/");  continue;
-            case '\b': fprintf(file, "\\b");  continue;
-            case '\f': fprintf(file, "\\f");  continue;
-            case '\n': fprintf(file, "\\n");  continue;
-            case '\r': fprintf(file, "\\r");  continue;
-            case '\t': fprintf(file, "\\t");  continue;
-            default: break;
-          }
+    case JSON_TYPE_ARRAY: {
+      const Json_Array *src = &value->v.as_array;
+      Json_Array *dst = &out->v.as_array;
+      out->type = JSON_TYPE_ARRAY;
+      if (!src->len) break;
 
-          if (!isprint(codepoint)) {
-            fprintf(file, "\\u%.4lx", codepoint);
-            continue;
-          }
+      dst->elems = (Json_Value *)Json__storageAlloc(NULL, sizeof(Json_Value) * src->len);
+      if (!dst->elems) {
+        memset(out, 0, sizeof(*out));
+        return JSON_FALSE;
+      }
+      dst->cap = src->len;
 
-          fprintf(file, "%c", (char)codepoint);
-          continue;
+      for (; dst->len < src->len; ++dst->len) {
+        if (!Json_clone(&src->elems[dst->len], &dst->elems[dst->len])) {
+          Json_destroyValue(out);
+          return JSON_FALSE;
         }
+      }
+    } break;
 
-        if (codepoint >> 5 == 6) {
-          codepoint &= 0x1f;
-          unsigned char byte = ((unsigned char)value->v.as_string.data[++i]);
-          codepoint = (codepoint << 6) | (byte & 0x3f);
-          fprintf(file, "\\u%.4lx", codepoint);
+    case JSON_TYPE_OBJECT: {
+      const Json_Object *src = &value->v.as_object;
+      Json_Object *dst = &out->v.as_object;
+      out->type = JSON_TYPE_OBJECT;
+      if (!src->len) break;
 
-          continue;
+      dst->field_names = (Json_String *)Json__alloc(NULL, sizeof(Json_String) * src->len);
+      dst->field_values = (Json_Value *)Json__storageAlloc(NULL, sizeof(Json_Value) * src->len);
+      if (!dst->field_names || !dst->field_values) {
+        Json_destroyValue(out);
+        return JSON_FALSE;
+      }
+      dst->cap = src->len;
+
+      // names are copied too, even interned ones
+      for (; dst->len < src->len; ++dst->len) {
+        Json_String *name = &dst->field_names[dst->len];
+        *name = Json_stringDup(src->field_names[dst->len]);
+        if (!name->data) {
+          Json_destroyValue(out);
+          return JSON_FALSE;
         }
 
-        if (codepoint >> 4 == 0xc) {
-          codepoint &= 0xf;
-          unsigned char byte = ((unsigned char)value->v.as_string.data[++i]);
-          codepoint = (codepoint << 6) | (byte & 0x3f);
-          byte = ((unsigned char)value->v.as_string.data[++i]);
-          codepoint = (codepoint << 6) | (byte & 0x3f);
-          fprintf(file, "\\u%.4lx", codepoint);
-
-          continue;
+        if (!Json_clone(&src->field_values[dst->len], &dst->field_values[dst->len])) {
+          Json__release(NULL, name->data);
+          Json_destroyValue(out);
+          return JSON_FALSE;
         }
+      }
 
-        if (codepoint >> 3 == 0x1e) {
-          codepoint &= 7;
-          unsigned char byte = ((unsigned char)value->v.as_string.data[++i]);
-          codepoint = (codepoint << 6) | (byte & 0x3f);
-          byte = ((unsigned char)value->v.as_string.data[++i]);
-          codepoint = (codepoint << 6) | (byte & 0x3f);
-          byte = ((unsigned char)value->v.as_string.data[++i]);
-          codepoint = (codepoint << 6) | (byte & 0x3f);
-
-          // invalid character
-          if (codepoint > 0x10FFFF) {
-            fprintf(file, "\\ufffd");
-            continue;
-          }
+      if (dst->len >= JSON_OBJECT_INDEX_MIN) Json__objectIndexBuild(dst, NULL);
+    } break;
 
-          // json uses utf-16 surrogates for characters outside the BMP
-          // convert the codepoint to these values and print them
-          codepoint -= 0x10000;
-          unsigned short lo, hi;
-          hi = 0xd800 + (codepoint >> 10);
-          lo = 0xdc00 + (codepoint & 0x3ff);
+    default: *out = *value; break;
+  }
 
-          fprintf(file, "\\u%.4x\\u%.4x", hi, lo);
-          continue;
-        }
+  return JSON_TRUE;
+}
 
-        fprintf(file, "\\ufffd");
-        continue;
+Json_Boolean Json_snapshot(const Json_Value *value, Json_Value *out)
+{
+  if (!value || !out) return JSON_FALSE;
+
+  const void *storage = NULL;
+  if (value->type == JSON_TYPE_ARRAY) {
+    storage = value->v.as_array.elems;
+  } else if (value->type == JSON_TYPE_OBJECT) {
+    storage = value->v.as_object.field_values;
+  } else if (value->type == JSON_TYPE_STRING && value->v.as_string.is_heap) {
+    const Json_String str = Json_stringDup(value->v.as_string);
+    if (!str.data) return JSON_FALSE;
+
+    *out = *value;
+    out->v.as_string = str;
+    return JSON_TRUE;
+  }
+
+  // heap storage gets one more owner, borrowed storage stays borrowed (from
+  // an arena that has to outlive both)
+  if (storage && Json__storageRefs(storage)) Json__atomicAdd(&Json__storageOf(storage)->refs, 1);
+
+  *out = *value;
+  return JSON_TRUE;
+}
+
+Json_Boolean Json_unshare(Json_Value *value)
+{
+  if (!value) return JSON_FALSE;
+
+  if (value->type == JSON_TYPE_ARRAY) {
+    Json_Array *array = &value->v.as_array;
+    return Json__storageRefs(array->elems) <= 1 || Json__arrayRealloc(array, array->cap);
+  }
+
+  if (value->type == JSON_TYPE_OBJECT) {
+    Json_Object *object = &value->v.as_object;
+    return Json__storageRefs(object->field_values) <= 1 || Json__objectRealloc(object, object->cap);
+  }
+
+  return JSON_TRUE;
+}
+
+Json_Value *Json_objectEdit(Json_Value *object, Json_String field)
+{
+  if (!object || object->type != JSON_TYPE_OBJECT || !Json_unshare(object)) return NULL;
+  return Json_objectGet(object, field);
+}
+
+Json_Value *Json_arrayEdit(Json_Value *array, size_t idx)
+{
+  if (!array || array->type != JSON_TYPE_ARRAY || idx >= array->v.as_array.len) return NULL;
+  if (!Json_unshare(array)) return NULL;
+  return &array->v.as_array.elems[idx];
+}
+
+// the index a frozen object has: sized for its fields, or none at all once
+// there are too few of them for it to pay off
+static
+size_t Json__frozenIndexCap(const Json_Object *object)
+{
+  if (object->len < JSON_OBJECT_INDEX_MIN) return 0;
+
+  size_t cap = 32;
+  while (cap < 2 * object->len) cap *= 2;
+  return cap;
+}
+
+// index tables for freezing, all allocated before anything is changed
+typedef struct {
+  size_t **tables;
+  size_t len;
+  size_t cap;
+  size_t next;
+} Json__FreezeTables;
+
+// storage that is shared or borrowed is left as it is
+static
+Json_Boolean Json__freezeAlloc(const Json_Value *value, Json__FreezeTables *t)
+{
+  if (value->type == JSON_TYPE_ARRAY) {
+    for (size_t i = 0; i < value->v.as_array.len; ++i) {
+      if (!Json__freezeAlloc(&value->v.as_array.elems[i], t)) return JSON_FALSE;
+    }
+  } else if (value->type == JSON_TYPE_OBJECT) {
+    const Json_Object *object = &value->v.as_object;
+    const Json__Storage *hdr = Json__storageOf(object->field_values);
+    const size_t cap = Json__frozenIndexCap(object);
+
+    if (cap && hdr->index_cap != cap && Json__storageRefs(object->field_values) == 1) {
+      if (t->len == t->cap) {
+        const size_t grown = Json__growCap(t->cap);
+        size_t **tables = (size_t **)Json__resize(NULL, t->tables, sizeof(size_t *) * grown);
+        if (!tables) return JSON_FALSE;
+        t->tables = tables;
+        t->cap = grown;
       }
 
-      putc('"', file);
-      break;
+      t->tables[t->len] = (size_t *)Json__alloc(NULL, sizeof(size_t) * cap);
+      if (!t->tables[t->len]) return JSON_FALSE;
+      ++t->len;
+    }
 
-    case JSON_TYPE_ARRAY:
-      fprintf(file, "[");
+    for (size_t i = 0; i < object->len; ++i) {
+      if (!Json__freezeAlloc(&object->field_values[i], t)) return JSON_FALSE;
+    }
+  }
 
-      for (size_t i = 0; i < value->v.as_array.len; ++i) {
-        if (i) fprintf(file, ",");
-        fprintf(file, "\n");
+  return JSON_TRUE;
+}
 
-        Json__realPrintValue(file, &value->v.as_array.elems[i], ntabs + 1, JSON_FALSE);
+// visits the same objects as Json__freezeAlloc; shrinking can't fail in a
+// way that matters, the old storage just stays bigger
+static
+void Json__freezeApply(Json_Value *value, Json__FreezeTables *t)
+{
+  if (value->type == JSON_TYPE_ARRAY) {
+    Json_Array *array = &value->v.as_array;
+    if (array->cap > array->len && Json__storageRefs(array->elems) == 1) Json__arrayRealloc(array, array->len);
+
+    for (size_t i = 0; i < array->len; ++i) Json__freezeApply(&array->elems[i], t);
+  } else if (value->type == JSON_TYPE_OBJECT) {
+    Json_Object *object = &value->v.as_object;
+    if (Json__storageRefs(object->field_values) == 1) {
+      if (object->cap > object->len) Json__objectRealloc(object, object->len);
+
+      Json__Storage *hdr = Json__storageOf(object->field_values);
+      const size_t cap = Json__frozenIndexCap(object);
+      if (hdr && hdr->index_cap != cap) {
+        Json__release(NULL, hdr->index);
+        hdr->index = NULL;
+        hdr->index_cap = 0;
+        if (cap) Json__objectIndexFill(object, t->tables[t->next++], cap);
       }
+    }
 
-      fprintf(file, "\n");
-      for (int i = 0; i < ntabs; ++i) putc('\t', file);
-      fprintf(file, "]");
-      break;
+    for (size_t i = 0; i < object->len; ++i) Json__freezeApply(&object->field_values[i], t);
+  }
+}
 
-    case JSON_TYPE_OBJECT:
-      fprintf(file, "{");
+Json_Boolean Json_freeze(Json_Value *value)
+{
+  if (!value) return JSON_FALSE;
 
-      for (size_t i = 0; i < value->v.as_object.len; ++i) {
-        if (i) fprintf(file, ",");
-        fprintf(file, "\n");
+  Json__FreezeTables tables;
+  memset(&tables, 0, sizeof(tables));
+
+  const Json_Boolean ok = Json__freezeAlloc(value, &tables);
+  if (ok) {
+    Json__freezeApply(value, &tables);
+  } else {
+    for (size_t i = 0; i < tables.len; ++i) Json__release(NULL, tables.tables[i]);
+  }
 
-        Json_Value tmp;
-        Json__realPrintValue(
-          file,
-          Json_asValue(&tmp, JSON_TYPE_STRING, value->v.as_object.field_names[i]),
-          ntabs + 1,
-          JSON_FALSE
-        );
+  Json__release(NULL, tables.tables);
+  return ok;
+}
 
-        fprintf(file, ": ");
+Json_Frozen *Json_frozenCreate(Json_Value *value)
+{
+  if (!value) return NULL;
 
-        Json__realPrintValue(file, &value->v.as_object.field_values[i], ntabs + 1, JSON_TRUE);
-      }
+  Json_Frozen *doc = (Json_Frozen *)Json__alloc(NULL, sizeof(Json_Frozen));
+  if (!doc) return NULL;
 
-      fprintf(file, "\n");
-      for (int i = 0; i < ntabs; ++i) putc('\t', file);
-      fprintf(file, "}");
-      break;
+  if (!Json_freeze(value)) {
+    Json__release(NULL, doc);
+    return NULL;
   }
+
+  doc->root = *value;
+  doc->refs = 1;
+  memset(value, 0, sizeof(*value));
+  return doc;
 }
 
-void Json_printValue(FILE *file, const Json_Value *value)
+Json_Frozen *Json_frozenRetain(Json_Frozen *doc)
 {
-  Json__realPrintValue(file, value, 0, JSON_TRUE);
-  fprintf(file, "\n");
+  if (doc) Json__atomicAdd(&doc->refs, 1);
+  return doc;
 }
 
-size_t Json_parseFile(FILE *file, Json_Value *out)
+void Json_frozenRelease(Json_Frozen *doc)
 {
-  if (!file || !out) return 0;
+  if (!doc || Json__atomicAdd(&doc->refs, -1)) return;
 
-  const long start = ftell(file);
-  fseek(file, 0, SEEK_END);
-  const long buf_sz = ftell(file) - start + 1;
-  if (buf_sz <= 1l || buf_sz > 1073741823l) return 0;
+  Json_destroyValue(&doc->root);
+  Json__release(NULL, doc);
+}
 
-  char *buffer = (char *)calloc(1, buf_sz);
-  if (!buffer) return 0;
+void Json_publishInit(Json_Published *slot, Json_Frozen *doc)
+{
+  if (!slot) return;
 
-  fseek(file, start, SEEK_SET);
-  fread(buffer, 1, buf_sz, file);
-  const size_t ret = Json_parseStr(buf_sz, buffer, out);
+  memset(slot, 0, sizeof(*slot));
+  slot->current = doc;
+}
+
+Json_Frozen *Json_publishAcquire(Json_Published *slot)
+{
+  if (!slot) return NULL;
+
+  // readers[epoch] keeps a swap from dropping what this loads; the epoch is
+  // checked again since a stale one may belong to a swap done waiting
+  long epoch;
+  for (;;) {
+    epoch = Json__atomicLoad(&slot->epoch);
+    Json__atomicAdd(&slot->readers[epoch], 1);
+    if (Json__atomicLoad(&slot->epoch) == epoch) break;
+    Json__atomicAdd(&slot->readers[epoch], -1);
+  }
+
+  Json_Frozen *doc = Json_frozenRetain(Json__atomicLoadFrozen(&slot->current));
+  Json__atomicAdd(&slot->readers[epoch], -1);
+  return doc;
+}
+
+void Json_publishSwap(Json_Published *slot, Json_Frozen *doc)
+{
+  if (!slot) return;
 
-  free(buffer);
+  // swaps take turns, they only happen once in a while
+  while (Json__atomicSwap(&slot->writing, 1)) continue;
+
+  Json_Frozen *old = Json__atomicSwapFrozen(&slot->current, doc);
+
+  // new acquires find doc, and flipping the epoch first means only the old
+  // epoch's acquires are waited for
+  const long epoch = Json__atomicLoad(&slot->epoch);
+  Json__atomicSwap(&slot->epoch, !epoch);
+  while (Json__atomicLoad(&slot->readers[epoch])) continue;
+
+  Json__atomicSwap(&slot->writing, 0);
+  Json_frozenRelease(old);
+}
+
+void Json_publishDestroy(Json_Published *slot)
+{
+  if (!slot) return;
+
+  Json_frozenRelease(slot->current);
+  memset(slot, 0, sizeof(*slot));
+}
+
+// shortest round-trip formatting, Grisu2 by Florian Loitsch ("Printing
+// Floating-Point Numbers Quickly and Accurately with Integers", 2010)
+typedef struct {
+  unsigned long long f;
+  int e;
+} Json__DiyFp;
+
+static
+Json__DiyFp Json__diyMul(Json__DiyFp a, Json__DiyFp b)
+{
+  const unsigned long long m32 = 0xffffffffull;
+  const unsigned long long ah = a.f >> 32, al = a.f & m32;
+  const unsigned long long bh = b.f >> 32, bl = b.f & m32;
+  const unsigned long long hh = ah * bh, lh = al * bh, hl = ah * bl, ll = al * bl;
+
+  // the low half only contributes its carry, rounded
+  unsigned long long mid = (ll >> 32) + (hl & m32) + (lh & m32);
+  mid += 1ull << 31;
+
+  Json__DiyFp ret;
+  ret.f = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+  ret.e = a.e + b.e + 64;
   return ret;
 }
 
-size_t Json_parseStr(size_t buf_sz, const char *buffer, Json_Value *out)
+static
+Json__DiyFp Json__diyNormalize(Json__DiyFp v)
 {
-  size_t ret = 0;
+  while (!(v.f & (1ull << 63))) {
+    v.f <<= 1;
+    --v.e;
+  }
 
-  if (!buffer || !buf_sz || !out) return 0;
-  memset(out, 0, sizeof(*out));
+  return v;
+}
+
+// 10^k for k = -348, -340, ..., 340, normalized to 64 bit significands
+static
+Json__DiyFp Json__cachedPower(int e, int *k)
+{
+  static const unsigned long long f[] = {
+  0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+  0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+  0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+  0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+  0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+  0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+  0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+  0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+  0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+  0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+  0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+  0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+  0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+  0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+  0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+  0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+  0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+  0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+  0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+  0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+  0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+  0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+  0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+  0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+  0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+  0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+  0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+  0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+  0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+  };
+
+  static const short exp[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+  -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+  -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+  -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+  694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+  1013, 1039, 1066,
+  };
+
+  const double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = (int)dk;
+  if (dk - ik > 0.0) ++ik;
+
+  const unsigned idx = (unsigned)((ik >> 3) + 1);
+  *k = -(-348 + (int)(idx << 3));
+
+  Json__DiyFp ret;
+  ret.f = f[idx];
+  ret.e = exp[idx];
+  return ret;
+}
 
-  while (isspace(buffer[ret])) {
-    ++ret;
-    if (ret >= buf_sz) return 0;
+static
+void Json__grisuRound(
+  char *buf,
+  int len,
+  unsigned long long delta,
+  unsigned long long rest,
+  unsigned long long ten_kappa,
+  unsigned long long wp_w
+)
+{
+  while (rest < wp_w && delta - rest >= ten_kappa
+         && (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    --buf[len - 1];
+    rest += ten_kappa;
   }
+}
 
-  // TODO: parse arrays and objects
-  if (isdigit(buffer[ret])) {
-    out->type = JSON_TYPE_NUMBER;
-    int tmp = 0;
-    if (sscanf(&buffer[ret], "%lf%n", &out->v.as_number, &tmp) != 1) return ret;
-    ret += tmp;
-    return ret;
+static
+void Json__grisuDigits(Json__DiyFp w, Json__DiyFp mp, unsigned long long delta, char *buf, int *len, int *k)
+{
+  static const unsigned long long pow10[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull
+  };
+
+  const int shift = -mp.e;
+  const unsigned long long one = 1ull << shift;
+  const unsigned long long wp_w = mp.f - w.f;
+  unsigned long p1 = (unsigned long)(mp.f >> shift);
+  unsigned long long p2 = mp.f & (one - 1);
+
+  int kappa = 1;
+  while (kappa < 10 && p1 >= pow10[kappa]) ++kappa;
+
+  *len = 0;
+  while (kappa > 0) {
+    const unsigned long d = (unsigned long)(p1 / pow10[kappa - 1]);
+    p1 %= (unsigned long)pow10[kappa - 1];
+    if (d || *len) buf[(*len)++] = (char)('0' + d);
+    --kappa;
+
+    const unsigned long long rest = ((unsigned long long)p1 << shift) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      Json__grisuRound(buf, *len, delta, rest, pow10[kappa] << shift, wp_w);
+      return;
+    }
   }
 
-  switch (buffer[ret]) {
-    case 'n':
-      if (buf_sz < 4) break;
-      if (memcmp(buffer, "null", 4)) break;
-      ret += 4;
-      out->type = JSON_TYPE_NULL;
-      break;
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    const char d = (char)(p2 >> shift);
+    if (d || *len) buf[(*len)++] = (char)('0' + d);
+    p2 &= one - 1;
+    --kappa;
+
+    if (p2 < delta) {
+      *k += kappa;
+      Json__grisuRound(buf, *len, delta, p2, one, (-kappa < 20)? wp_w * pow10[-kappa] : 0);
+      return;
+    }
+  }
+}
 
-    case 't':
-      if (buf_sz < 4) break;
-      if (memcmp(buffer, "true", 4)) break;
-      ret += 4;
-      out->type = JSON_TYPE_BOOLEAN;
-      out->v.as_boolean = JSON_TRUE;
-      break;
+// val must be finite and positive; produces digits and k with val ~= digits * 10^k
+static
+int Json__grisu2(double val, char *buf, int *k)
+{
+  unsigned long long bits;
+  memcpy(&bits, &val, sizeof(bits));
+
+  const unsigned long long hidden = 1ull << 52;
+  const int biased = (int)((bits >> 52) & 0x7ff);
+  Json__DiyFp v;
+  v.f = bits & (hidden - 1);
+  v.e = (biased)? biased - 1075 : -1074;
+  if (biased) v.f += hidden;
+
+  // the neighbourhood of values that still read back as val
+  Json__DiyFp plus, minus;
+  plus.f = (v.f << 1) + 1;
+  plus.e = v.e - 1;
+  plus = Json__diyNormalize(plus);
+
+  if (v.f == hidden) {
+    minus.f = (v.f << 2) - 1;
+    minus.e = v.e - 2;
+  } else {
+    minus.f = (v.f << 1) - 1;
+    minus.e = v.e - 1;
+  }
+  minus.f <<= minus.e - plus.e;
+  minus.e = plus.e;
+
+  const Json__DiyFp c_mk = Json__cachedPower(plus.e, k);
+  const Json__DiyFp w = Json__diyMul(Json__diyNormalize(v), c_mk);
+  Json__DiyFp wp = Json__diyMul(plus, c_mk);
+  Json__DiyFp wm = Json__diyMul(minus, c_mk);
+  ++wm.f;
+  --wp.f;
+
+  int len;
+  Json__grisuDigits(w, wp, wp.f - wm.f, buf, &len, k);
+  return len;
+}
 
-    case 'f':
-      if (buf_sz < 5) break;
-      if (memcmp(buffer, "false", 5)) break;
-      ret += 5;
-      out->type = JSON_TYPE_BOOLEAN;
-      out->v.as_boolean = JSON_FALSE;
-      break;
+size_t Json_formatInteger(char *buf, Json_Integer val)
+{
+  if (!buf) return 0;
+
+  char tmp[24];
+  size_t n = 0;
+  unsigned long long u = (val < 0)? 0ull - (unsigned long long)val : (unsigned long long)val;
+  do {
+    tmp[n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+
+  size_t len = 0;
+  if (val < 0) buf[len++] = '-';
+  while (n) buf[len++] = tmp[--n];
+  buf[len] = '\0';
+  return len;
+}
 
-    case '"': {
-      out->type = JSON_TYPE_STRING;
-      out->v.as_string.is_heap = JSON_TRUE;
-      size_t nalloced = 0;
-
-      size_t str_idx = 0;
-      size_t i;
-      for (i = ret + 1; i < buf_sz; ++i) {
-        if (buffer[i] == '"') break;
-  
-        if (str_idx + 4 > nalloced) {
-          nalloced = (nalloced)? 2 * nalloced : 64;
-          out->v.as_string.data = (char *)realloc(out->v.as_string.data, nalloced);
-          if (!out->v.as_string.data) break; // TODO: error handling
-        }
+size_t Json_formatNumber(char *buf, Json_Number val)
+{
+  if (!buf) return 0;
 
-        if (buffer[i] == '\\') {
-          ++i;
-          switch (buffer[i]) {
-            case '"':  out->v.as_string.data[str_idx++] = '"';  continue;
-            case '\\': out->v.as_string.data[str_idx++] = '\\'; continue;
-            case '/':  out->v.as_string.data[str_idx++] = '/';  continue;
-            case 'b':  out->v.as_string.data[str_idx++] = '\b'; continue;
-            case 'f':  out->v.as_string.data[str_idx++] = '\f'; continue;
-            case 'n':  out->v.as_string.data[str_idx++] = '\n'; continue;
-            case 'r':  out->v.as_string.data[str_idx++] = '\r'; continue;
-            case 't':  out->v.as_string.data[str_idx++] = '\t'; continue;
-            case 'u': {
-              int n = 0, m = 0;
-              unsigned short hi = 0, lo = 0;
-              if (sscanf(&buffer[i], "u%4hx%n", &hi, &n) != 1) {
-                printf("here? %x\n", hi);
-                memcpy(&out->v.as_string.data[str_idx], "\ufffd", 3);
-                str_idx += 3;
-                i += n + m;
-                continue;
-              }
-
-              if (hi >= 0xd800 && hi <= 0xdbff) {
-                if (sscanf(&buffer[i+n], "\\u%4hx%n", &lo, &m) != 1 || lo < 0xdc00 || lo > 0xdfff) {
-                  printf("here? %d\n", __LINE__);
-                  memcpy(&out->v.as_string.data[str_idx], "\ufffd", 3);
-                  str_idx += 3;
-                  i += n + m;
-                  continue;
-                }
-
-                const unsigned long codepoint = 0x10000l + (((hi - 0xd800) << 10l) | (lo - 0xdc00));
-                out->v.as_string.data[str_idx++] = 0xf0 | ((codepoint >> 18) & 7);
-                out->v.as_string.data[str_idx++] = 0x80 | ((codepoint >> 12) & 0x3f);
-                out->v.as_string.data[str_idx++] = 0x80 | ((codepoint >> 6)  & 0x3f);
-                out->v.as_string.data[str_idx++] = 0x80 | (codepoint & 0x3f);
-                i += n + m - 1;
-                continue;
-              }
-
-              if (hi <= 0x7F) {
-                out->v.as_string.data[str_idx++] = (char)hi;
-                i += n + m;
-                continue;
-              }
-
-              if (hi <= 0x7FF) {
-                out->v.as_string.data[str_idx++] = (char)(0xc0 | ((hi >> 6) & 0x1f));
-                out->v.as_string.data[str_idx++] = (char)(0x80 | (hi & 0x3f));
-                i += n + m;
-                continue;
-              }
-
-              out->v.as_string.data[str_idx++] = (char)(0xe0 | ((hi >> 12) & 0xf));
-              out->v.as_string.data[str_idx++] = (char)(0x80 | ((hi >> 6) & 0x3f));
-              out->v.as_string.data[str_idx++] = (char)(0x80 | (hi & 0x3f));
-              i += n + m;
-            }
-            continue;
-            default: break; // TODO: error handling
-          }
-        }
+  if (isnan(val) || isinf(val)) {
+    const char *str = (isnan(val))? "NaN" : (val < 0)? "-Infinity" : "Infinity";
+    memcpy(buf, str, strlen(str) + 1);
+    return strlen(str);
+  }
 
-        if ((unsigned char)buffer[i] <= 0x7f) {
-          out->v.as_string.data[str_idx++] = buffer[i];
-          continue;
-        }
+  size_t len = 0;
+  if (signbit(val)) {
+    buf[len++] = '-';
+    val = -val;
+  }
 
-        if ((unsigned char)buffer[i] >> 5 == 6) {
-          printf("2: %.2s\n", &buffer[i]);
-          out->v.as_string.data[str_idx++] = buffer[i++];
-          out->v.as_string.data[str_idx++] = buffer[i];
-          continue;
-        }
+  if (val == 0.0) {
+    buf[len++] = '0';
+    buf[len] = '\0';
+    return len;
+  }
 
-        if ((unsigned char)buffer[i] >> 4 == 0xe) {
-          printf("3: %.3s\n", &buffer[i]);
-          out->v.as_string.data[str_idx++] = buffer[i++];
-          out->v.as_string.data[str_idx++] = buffer[i++];
-          out->v.as_string.data[str_idx++] = buffer[i];
-          continue;
-        }
-  
-        printf("4: %.4s\n", &buffer[i]);
-        out->v.as_string.data[str_idx++] = buffer[i++];
-        out->v.as_string.data[str_idx++] = buffer[i++];
-        out->v.as_string.data[str_idx++] = buffer[i++];
-        out->v.as_string.data[str_idx++] = buffer[i];
-        continue;
+  // whole numbers that a double holds exactly skip the digit generation
+  if (val < 9007199254740992.0 && (double)(Json_Integer)val == val) {
+    return len + Json_formatInteger(&buf[len], (Json_Integer)val);
+  }
+
+  char *out = &buf[len];
+  int k;
+  const int ndigits = Json__grisu2(val, out, &k);
+  const int kk = ndigits + k; // 10^(kk - 1) <= val < 10^kk
+
+  if (k >= 0 && kk <= 21) {
+    // 1234e7 -> 12340000000
+    for (int i = ndigits; i < kk; ++i) out[i] = '0';
+    len += (size_t)kk;
+  } else if (kk > 0 && kk <= 21) {
+    // 1234e-2 -> 12.34
+    memmove(&out[kk + 1], &out[kk], (size_t)(ndigits - kk));
+    out[kk] = '.';
+    len += (size_t)ndigits + 1;
+  } else if (kk > -6 && kk <= 0) {
+    // 1234e-6 -> 0.001234
+    const int offset = 2 - kk;
+    memmove(&out[offset], out, (size_t)ndigits);
+    out[0] = '0';
+    out[1] = '.';
+    for (int i = 2; i < offset; ++i) out[i] = '0';
+    len += (size_t)(ndigits + offset);
+  } else {
+    // 1234e30 -> 1.234e33
+    int n = 1;
+    if (ndigits > 1) {
+      memmove(&out[2], &out[1], (size_t)(ndigits - 1));
+      out[1] = '.';
+      n = ndigits + 1;
+    }
+
+    out[n++] = 'e';
+    int exp = kk - 1;
+    if (exp < 0) {
+      out[n++] = '-';
+      exp = -exp;
+    }
+
+    if (exp >= 100) out[n++] = (char)('0' + exp / 100);
+    if (exp >= 10) out[n++] = (char)('0' + exp / 10 % 10);
+    out[n++] = (char)('0' + exp % 10);
+    len += (size_t)n;
+  }
+
+  buf[len] = '\0';
+  return len;
+}
+
+struct Json_ArenaBlock {
+  Json_ArenaBlock *next;
+  size_t cap;
+  size_t used;
+};
+
+// every arena allocation is aligned to this, which is enough for any Json_ type
+#define JSON__ARENA_ALIGN 16
+#define JSON__ARENA_HDR \
+  ((sizeof(Json_ArenaBlock) + JSON__ARENA_ALIGN - 1) & ~(size_t)(JSON__ARENA_ALIGN - 1))
+
+void Json_arenaInit(Json_Arena *arena, size_t block_sz)
+{
+  if (!arena) return;
+  memset(arena, 0, sizeof(*arena));
+  arena->block_sz = (block_sz)? block_sz : JSON_ARENA_BLOCK_SIZE;
+}
+
+void *Json_arenaAlloc(Json_Arena *arena, size_t sz)
+{
+  if (!arena) return NULL;
+  sz = (sz + JSON__ARENA_ALIGN - 1) & ~(size_t)(JSON__ARENA_ALIGN - 1);
+
+  Json_ArenaBlock *block = arena->cur;
+  if (!block || block->cap - block->used < sz) {
+    // blocks after the current one are empty ones kept around by Json_arenaReset
+    if (block && block->next && block->next->cap >= sz) {
+      block = block->next;
+    } else {
+      const size_t cap = (sz > arena->block_sz)? sz : arena->block_sz;
+      Json_ArenaBlock *fresh = (Json_ArenaBlock *)Json__alloc(NULL, JSON__ARENA_HDR + cap);
+      if (!fresh) return NULL;
+
+      fresh->cap = cap;
+      fresh->used = 0;
+      if (block) {
+        fresh->next = block->next;
+        block->next = fresh;
+      } else {
+        fresh->next = arena->first;
+        arena->first = fresh;
       }
 
-      out->v.as_string.len = str_idx;
-      ret = i + 1;
-    } break;
+      block = fresh;
+    }
 
-    case '[': {
-      out->type = JSON_TYPE_ARRAY;
-      memset(&out->v.as_array, 0, sizeof(Json_Array));
+    arena->cur = block;
+  }
 
-      ret += 1;
-      do {
-        while (isspace(buffer[ret]) && ret < buf_sz) ++ret;
-        Json_Value elem;
-        ret += Json_parseStr(buf_sz - ret, &buffer[ret], &elem);
-        Json_arrayAppend(out, &elem);
-      } while (buffer[ret++] == ',');
-      
-      while (isspace(buffer[ret]) && ret < buf_sz) ++ret;
-      if (buffer[ret] != ']') break;
-    } break;
+  void *ret = (char *)block + JSON__ARENA_HDR + block->used;
+  block->used += sz;
+  return ret;
+}
 
-    case '{': {
-      out->type = JSON_TYPE_OBJECT;
-      memset(&out->v.as_object, 0, sizeof(Json_Object));
+// grows the most recent allocation in place when possible,
+// otherwise falls back to a fresh allocation and a copy
+static
+void *Json__arenaRealloc(Json_Arena *arena, void *ptr, size_t old_sz, size_t new_sz)
+{
+  if (!ptr) return Json_arenaAlloc(arena, new_sz);
 
-      ret += 1;
-      do {
-        while (isspace(buffer[ret]) && ret < buf_sz) ++ret;
-        Json_Value name, val;
-        ret += Json_parseStr(buf_sz - ret, &buffer[ret], &name) ;
-        if (name.type != JSON_TYPE_STRING) break;
-        while (isspace(buffer[ret]) && ret < buf_sz) ++ret;
-        if (buffer[ret++] != ':') break;
-        while (isspace(buffer[ret]) && ret < buf_sz) ++ret;
-        ret += Json_parseStr(buf_sz - ret, &buffer[ret], &val);
-        Json_objectSet(out, name.v.as_string, &val);
-      } while (buffer[ret++] == ',');
-      
-      while (isspace(buffer[ret]) && ret < buf_sz) ++ret;
-      if (buffer[ret] != '}') break;
-    } break;
+  Json_ArenaBlock *block = arena->cur;
+  old_sz = (old_sz + JSON__ARENA_ALIGN - 1) & ~(size_t)(JSON__ARENA_ALIGN - 1);
+  const size_t grown = (new_sz + JSON__ARENA_ALIGN - 1) & ~(size_t)(JSON__ARENA_ALIGN - 1);
 
+  char *top = (char *)block + JSON__ARENA_HDR + block->used;
+  if ((char *)ptr + old_sz == top && block->used - old_sz + grown <= block->cap) {
+    block->used = block->used - old_sz + grown;
+    return ptr;
   }
 
-  while (isspace(buffer[ret]) && ret < buf_sz) ++ret;
+  void *ret = Json_arenaAlloc(arena, new_sz);
+  if (ret) memcpy(ret, ptr, (old_sz < new_sz)? old_sz : new_sz);
   return ret;
 }
 
+void Json_arenaReset(Json_Arena *arena)
+{
+  if (!arena) return;
+
+  for (Json_ArenaBlock *block = arena->first; block; block = block->next) {
+    block->used = 0;
+  }
+
+  arena->cur = arena->first;
+}
+
+void Json_arenaDestroy(Json_Arena *arena)
+{
+  if (!arena) return;
+
+  Json_ArenaBlock *block = arena->first;
+  while (block) {
+    Json_ArenaBlock *next = block->next;
+    Json__release(NULL, block);
+    block = next;
+  }
+
+  arena->first = arena->cur = NULL;
+}
+
+// releases the stack once ctx won't parse anything else
+static
+void Json__parseDone(Json__ParseCtx *ctx)
+{
+  Json__parseTrack(ctx, sizeof(Json_Value) * ctx->stack_cap, 0);
+  Json__release(ctx->allocator, ctx->stack);
+  ctx->stack = NULL;
+  ctx->stack_len = ctx->stack_cap = 0;
+}
+
+// set in Json__ParseCtx.flags where other threads read ctx->keys concurrently
+#define JSON__PARSE_KEYS_FIXED 0x80000000u
+
+void Json_keyPoolInit(Json_KeyPool *pool)
+{
+  if (!pool) return;
+  memset(pool, 0, sizeof(*pool));
+  Json_arenaInit(&pool->arena, 0);
+}
+
+void Json_keyPoolDestroy(Json_KeyPool *pool)
+{
+  if (!pool) return;
+  Json__release(NULL, pool->names);
+  Json_arenaDestroy(&pool->arena);
+  memset(pool, 0, sizeof(*pool));
+}
+
+static
+const Json_String *Json__keyPoolLookup(Json_KeyPool *pool, Json_String name, Json_Boolean insert)
+{
+  if (name.len > JSON_KEY_POOL_MAX_LEN) return NULL;
+
+  const size_t hash = Json__hashString(name);
+  size_t slot = 0;
+  if (pool->cap) {
+    const size_t mask = pool->cap - 1;
+    for (slot = hash & mask; pool->names[slot].data; slot = (slot + 1) & mask) {
+      const Json_String *known = &pool->names[slot];
+      if (known->len == name.len && !memcmp(known->data, name.data, name.len)) return known;
+    }
+  }
+
+  if (!insert || pool->len >= JSON_KEY_POOL_MAX_KEYS) return NULL;
+
+  if (2 * (pool->len + 1) > pool->cap) {
+    const size_t cap = (pool->cap)? 2 * pool->cap : 64;
+    Json_String *names = (Json_String *)Json__calloc(NULL, cap, sizeof(Json_String));
+    if (!names) return NULL;
+
+    for (size_t i = 0; i < pool->cap; ++i) {
+      if (!pool->names[i].data) continue;
+
+      size_t to = Json__hashString(pool->names[i]) & (cap - 1);
+      while (names[to].data) to = (to + 1) & (cap - 1);
+      names[to] = pool->names[i];
+    }
+
+    Json__release(NULL, pool->names);
+    pool->names = names;
+    pool->cap = cap;
+
+    for (slot = hash & (cap - 1); names[slot].data; slot = (slot + 1) & (cap - 1));
+  }
+
+  char *data = (char *)Json_arenaAlloc(&pool->arena, name.len + 1);
+  if (!data) return NULL;
+  if (name.len) memcpy(data, name.data, name.len);
+  data[name.len] = '\0';
+
+  pool->names[slot].is_heap = JSON_FALSE;
+  pool->names[slot].len = name.len;
+  pool->names[slot].data = data;
+  ++pool->len;
+  return &pool->names[slot];
+}
+
+Json_String Json_keyPoolIntern(Json_KeyPool *pool, Json_String name)
+{
+  if (!pool || !name.data) return name;
+
+  const Json_String *interned = Json__keyPoolLookup(pool, name, JSON_TRUE);
+  return (interned)? *interned : name;
+}
+
+// JSON_FALSE if the array can't grow, and src is still the caller's
+static
+Json_Boolean Json__parseAppend(Json__ParseCtx *ctx, Json_Array *array, const Json_Value *src)
+{
+  if (array->len + 1 > array->cap) {
+    const size_t cap = Json__growCap(array->cap);
+    Json_Value *elems = (Json_Value *)Json__storageRealloc(
+      ctx, array->elems, sizeof(Json_Value) * array->cap, sizeof(Json_Value) * cap
+    );
+
+    if (!elems) return JSON_FALSE;
+    array->elems = elems;
+    array->cap = cap;
+  }
+
+  array->elems[array->len++] = *src;
+  return JSON_TRUE;
+}
+
+// JSON_FALSE if the object can't grow, and field and src are still the caller's
+static
+Json_Boolean Json__parseSet(Json__ParseCtx *ctx, Json_Object *object, Json_String field, const Json_Value *src)
+{
+  // duplicate keys keep the last value, like Json_objectSet
+  const size_t i = Json__objectFind(object, field);
+  if (i < object->len) {
+    if (!ctx->arena) {
+      Json_destroyValueWith(&object->field_values[i], ctx->allocator);
+      if (field.is_heap) Json__release(ctx->allocator, field.data);
+    }
+
+    object->field_values[i] = *src;
+    return JSON_TRUE;
+  }
+
+  if (object->len + 1 > object->cap) {
+    const size_t cap = Json__growCap(object->cap);
+    Json_String *names = (Json_String *)Json__parseRealloc(
+      ctx, object->field_names, sizeof(Json_String) * object->cap, sizeof(Json_String) * cap
+    );
+    if (names) object->field_names = names;
+
+    Json_Value *values = (Json_Value *)Json__storageRealloc(
+      ctx, object->field_values, sizeof(Json_Value) * object->cap, sizeof(Json_Value) * cap
+    );
+    if (values) object->field_values = values;
+
+    if (!names || !values) return JSON_FALSE;
+    object->cap = cap;
+  }
+
+  object->field_names[object->len]  = field;
+  object->field_values[object->len] = *src;
+  ++object->len;
+  Json__objectIndexAppended(object, ctx);
+  return JSON_TRUE;
+}
+
+// makes room for n more values on ctx->stack
+static
+Json_Boolean Json__parseReserve(Json__ParseCtx *ctx, size_t n)
+{
+  if (ctx->stack_len + n <= ctx->stack_cap) return JSON_TRUE;
+
+  size_t cap = (ctx->stack_cap)? 2 * ctx->stack_cap : 256;
+  while (cap < ctx->stack_len + n) cap *= 2;
+
+  Json_Value *stack = (Json_Value *)Json__resize(ctx->allocator, ctx->stack, sizeof(Json_Value) * cap);
+  if (!stack) return JSON_FALSE;
+  Json__parseTrack(ctx, sizeof(Json_Value) * ctx->stack_cap, sizeof(Json_Value) * cap);
+
+  ctx->stack = stack;
+  ctx->stack_cap = cap;
+  return JSON_TRUE;
+}
+
+// throws away a value that failed to parse, what it took from an arena stays
+static
+void Json__parseDrop(Json__ParseCtx *ctx, Json_Value *out)
+{
+  if (!ctx->arena) Json_destroyValueWith(out, ctx->allocator);
+  memset(out, 0, sizeof(*out));
+}
+
+// moves the elements stacked since base into array, JSON_FALSE (and the
+// elements destroyed) if there was no memory for it
+static
+Json_Boolean Json__parseArrayEnd(Json__ParseCtx *ctx, Json_Array *array, size_t base)
+{
+  const size_t len = ctx->stack_len - base;
+  ctx->stack_len = base;
+  if (!len) return JSON_TRUE;
+
+  Json_Value *elems = (Json_Value *)Json__storageAlloc(ctx, sizeof(Json_Value) * len);
+  if (!elems) {
+    if (!ctx->arena) for (size_t i = 0; i < len; ++i) Json_destroyValueWith(&ctx->stack[base + i], ctx->allocator);
+    return JSON_FALSE;
+  }
+
+  memcpy(elems, &ctx->stack[base], sizeof(Json_Value) * len);
+  array->elems = elems;
+  array->len = array->cap = len;
+  return JSON_TRUE;
+}
+
+// like Json__parseArrayEnd, for the name, value pairs stacked since base
+static
+Json_Boolean Json__parseObjectEnd(Json__ParseCtx *ctx, Json_Object *object, size_t base)
+{
+  const size_t len = (ctx->stack_len - base) / 2;
+  if (!len) {
+    ctx->stack_len = base;
+    return JSON_TRUE;
+  }
+
+  object->field_names = (Json_String *)Json__parseAlloc(ctx, sizeof(Json_String) * len);
+  object->field_values = (Json_Value *)Json__storageAlloc(ctx, sizeof(Json_Value) * len);
+
+  if (!object->field_names || !object->field_values) {
+    Json__parseFree(ctx, object->field_names, sizeof(Json_String) * len);
+    Json__storageFree(ctx, object->field_values, sizeof(Json_Value) * len);
+    if (!ctx->arena) {
+      for (size_t i = base; i < base + 2 * len; ++i) Json_destroyValueWith(&ctx->stack[i], ctx->allocator);
+    }
+
+    object->field_names = NULL;
+    object->field_values = NULL;
+    ctx->stack_len = base;
+    return JSON_FALSE;
+  }
+
+  // duplicates are only resolved now, so the last one still wins, and with
+  // room for every pair no set can fail
+  object->cap = len;
+  for (size_t i = 0; i < len; ++i) {
+    const Json_Value *pair = &ctx->stack[base + 2 * i];
+    Json__parseSet(ctx, object, pair[0].v.as_string, &pair[1]);
+  }
+
+  ctx->stack_len = base;
+  return JSON_TRUE;
+}
+
+// class masks of a 64 byte block; control holds bytes below 0x20, non-ASCII,
+// '/' and DEL
+typedef struct {
+  unsigned long long quote;
+  unsigned long long backslash;
+  unsigned long long open;
+  unsigned long long close;
+  unsigned long long comma;
+  unsigned long long colon;
+  unsigned long long space;
+  unsigned long long control;
+  unsigned long long slash;
+} Json__BlockMasks;
+
+// the groups of masks a scan asks for, the others are left 0
+enum {
+  JSON__CLASS_STRING  = 0x1, // quote, backslash
+  JSON__CLASS_BRACKET = 0x2, // open, close
+  JSON__CLASS_PUNCT   = 0x4, // comma, colon
+  JSON__CLASS_SPACE   = 0x8,
+  JSON__CLASS_CONTROL = 0x10,
+  JSON__CLASS_SLASH   = 0x20
+};
+
+#ifdef JSON__HAVE_SSE2
+// the byte mask of four 16 byte compares as one 64 bit mask
+static
+unsigned long long Json__sse2Bits(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+  return (unsigned long long)(unsigned)_mm_movemask_epi8(a)
+       | (unsigned long long)(unsigned)_mm_movemask_epi8(b) << 16
+       | (unsigned long long)(unsigned)_mm_movemask_epi8(c) << 32
+       | (unsigned long long)(unsigned)_mm_movemask_epi8(d) << 48;
+}
+
+static
+__m128i Json__sse2Space(__m128i chunk)
+{
+  return _mm_or_si128(
+    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))),
+    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')))
+  );
+}
+
+static
+__m128i Json__sse2Slash(__m128i chunk)
+{
+  return _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('/')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x7f)));
+}
+
+static
+void Json__blockMasksSse2(const char *p, unsigned classes, Json__BlockMasks *out)
+{
+  const __m128i a = _mm_loadu_si128((const __m128i *)(const void *)&p[0]);
+  const __m128i b = _mm_loadu_si128((const __m128i *)(const void *)&p[16]);
+  const __m128i c = _mm_loadu_si128((const __m128i *)(const void *)&p[32]);
+  const __m128i d = _mm_loadu_si128((const __m128i *)(const void *)&p[48]);
+
+  if (classes & JSON__CLASS_STRING) {
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+    out->quote = Json__sse2Bits(
+      _mm_cmpeq_epi8(a, quote), _mm_cmpeq_epi8(b, quote), _mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(d, quote)
+    );
+    out->backslash = Json__sse2Bits(
+      _mm_cmpeq_epi8(a, backslash), _mm_cmpeq_epi8(b, backslash), _mm_cmpeq_epi8(c, backslash), _mm_cmpeq_epi8(d, backslash)
+    );
+  }
+
+  if (classes & JSON__CLASS_BRACKET) {
+    // '[' | 0x20 == '{' and ']' | 0x20 == '}', so folding case halves the compares
+    const __m128i fold = _mm_set1_epi8(0x20), open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}');
+    const __m128i fa = _mm_or_si128(a, fold), fb = _mm_or_si128(b, fold);
+    const __m128i fc = _mm_or_si128(c, fold), fd = _mm_or_si128(d, fold);
+    out->open = Json__sse2Bits(
+      _mm_cmpeq_epi8(fa, open), _mm_cmpeq_epi8(fb, open), _mm_cmpeq_epi8(fc, open), _mm_cmpeq_epi8(fd, open)
+    );
+    out->close = Json__sse2Bits(
+      _mm_cmpeq_epi8(fa, close), _mm_cmpeq_epi8(fb, close), _mm_cmpeq_epi8(fc, close), _mm_cmpeq_epi8(fd, close)
+    );
+  }
+
+  if (classes & JSON__CLASS_PUNCT) {
+    const __m128i comma = _mm_set1_epi8(','), colon = _mm_set1_epi8(':');
+    out->comma = Json__sse2Bits(
+      _mm_cmpeq_epi8(a, comma), _mm_cmpeq_epi8(b, comma), _mm_cmpeq_epi8(c, comma), _mm_cmpeq_epi8(d, comma)
+    );
+    out->colon = Json__sse2Bits(
+      _mm_cmpeq_epi8(a, colon), _mm_cmpeq_epi8(b, colon), _mm_cmpeq_epi8(c, colon), _mm_cmpeq_epi8(d, colon)
+    );
+  }
+
+  if (classes & JSON__CLASS_SPACE) {
+    out->space = Json__sse2Bits(Json__sse2Space(a), Json__sse2Space(b), Json__sse2Space(c), Json__sse2Space(d));
+  }
+
+  if (classes & JSON__CLASS_CONTROL) {
+    // a signed compare catches both control characters and bytes over 0x7f
+    const __m128i limit = _mm_set1_epi8(0x20);
+    out->control = Json__sse2Bits(
+      _mm_cmplt_epi8(a, limit), _mm_cmplt_epi8(b, limit), _mm_cmplt_epi8(c, limit), _mm_cmplt_epi8(d, limit)
+    );
+  }
+
+  if (classes & JSON__CLASS_SLASH) {
+    out->slash = Json__sse2Bits(Json__sse2Slash(a), Json__sse2Slash(b), Json__sse2Slash(c), Json__sse2Slash(d));
+  }
+}
+
+// the same with two 32 byte halves
+__attribute__((target("avx2"))) static
+unsigned long long Json__avx2Bits(__m256i lo, __m256i hi)
+{
+  return (unsigned long long)(unsigned)_mm256_movemask_epi8(lo)
+       | (unsigned long long)(unsigned)_mm256_movemask_epi8(hi) << 32;
+}
+
+__attribute__((target("avx2"))) static
+__m256i Json__avx2Space(__m256i chunk)
+{
+  return _mm256_or_si256(
+    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'))),
+    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')))
+  );
+}
+
+__attribute__((target("avx2"))) static
+__m256i Json__avx2Slash(__m256i chunk)
+{
+  return _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(0x7f)));
+}
+
+__attribute__((target("avx2"))) static
+void Json__blockMasksAvx2(const char *p, unsigned classes, Json__BlockMasks *out)
+{
+  const __m256i lo = _mm256_loadu_si256((const __m256i *)(const void *)&p[0]);
+  const __m256i hi = _mm256_loadu_si256((const __m256i *)(const void *)&p[32]);
+
+  if (classes & JSON__CLASS_STRING) {
+    const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+    out->quote = Json__avx2Bits(_mm256_cmpeq_epi8(lo, quote), _mm256_cmpeq_epi8(hi, quote));
+    out->backslash = Json__avx2Bits(_mm256_cmpeq_epi8(lo, backslash), _mm256_cmpeq_epi8(hi, backslash));
+  }
+
+  if (classes & JSON__CLASS_BRACKET) {
+    const __m256i fold = _mm256_set1_epi8(0x20), open = _mm256_set1_epi8('{'), close = _mm256_set1_epi8('}');
+    const __m256i flo = _mm256_or_si256(lo, fold), fhi = _mm256_or_si256(hi, fold);
+    out->open = Json__avx2Bits(_mm256_cmpeq_epi8(flo, open), _mm256_cmpeq_epi8(fhi, open));
+    out->close = Json__avx2Bits(_mm256_cmpeq_epi8(flo, close), _mm256_cmpeq_epi8(fhi, close));
+  }
+
+  if (classes & JSON__CLASS_PUNCT) {
+    const __m256i comma = _mm256_set1_epi8(','), colon = _mm256_set1_epi8(':');
+    out->comma = Json__avx2Bits(_mm256_cmpeq_epi8(lo, comma), _mm256_cmpeq_epi8(hi, comma));
+    out->colon = Json__avx2Bits(_mm256_cmpeq_epi8(lo, colon), _mm256_cmpeq_epi8(hi, colon));
+  }
+
+  if (classes & JSON__CLASS_SPACE) out->space = Json__avx2Bits(Json__avx2Space(lo), Json__avx2Space(hi));
+
+  if (classes & JSON__CLASS_CONTROL) {
+    const __m256i limit = _mm256_set1_epi8(0x20);
+    out->control = Json__avx2Bits(_mm256_cmpgt_epi8(limit, lo), _mm256_cmpgt_epi8(limit, hi));
+  }
+
+  if (classes & JSON__CLASS_SLASH) out->slash = Json__avx2Bits(Json__avx2Slash(lo), Json__avx2Slash(hi));
+}
+
+// 0 until the first block is classified, then 2 if the cpu has AVX2 and 1 if not
+static long Json__simdLevel;
+#else
+static
+void Json__blockMasksScalar(const char *p, unsigned classes, Json__BlockMasks *out)
+{
+  Json__BlockMasks all;
+  memset(&all, 0, sizeof(all));
+
+  for (int i = 0; i < 64; ++i) {
+    const unsigned long long bit = 1ull << i;
+    const unsigned char c = (unsigned char)p[i];
+    if (c < 0x20 || c >= 0x80) all.control |= bit;
+
+    switch (c) {
+      case '"':  all.quote |= bit; break;
+      case '\\': all.backslash |= bit; break;
+      case '[': case '{': all.open |= bit; break;
+      case ']': case '}': all.close |= bit; break;
+      case ',':  all.comma |= bit; break;
+      case ':':  all.colon |= bit; break;
+      case ' ': case '\n': case '\r': case '\t': all.space |= bit; break;
+      case '/': case 0x7f: all.slash |= bit; break;
+      default: break;
+    }
+  }
+
+  if (classes & JSON__CLASS_STRING)  { out->quote = all.quote; out->backslash = all.backslash; }
+  if (classes & JSON__CLASS_BRACKET) { out->open = all.open; out->close = all.close; }
+  if (classes & JSON__CLASS_PUNCT)   { out->comma = all.comma; out->colon = all.colon; }
+  if (classes & JSON__CLASS_SPACE)   out->space = all.space;
+  if (classes & JSON__CLASS_CONTROL) out->control = all.control;
+  if (classes & JSON__CLASS_SLASH)   out->slash = all.slash;
+}
+#endif
+
+// classifies p[0..n), at most 64 bytes of it; a short block is padded with
+// NULs, so its masks only mean something below n
+static
+void Json__blockMasks(const char *p, size_t n, unsigned classes, Json__BlockMasks *out)
+{
+  char tail[64];
+  if (n < 64) {
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, p, n);
+    p = tail;
+  }
+
+  memset(out, 0, sizeof(*out));
+
+#ifdef JSON__HAVE_SSE2
+  long level = Json__atomicLoad(&Json__simdLevel);
+  if (!level) {
+    level = (__builtin_cpu_supports("avx2"))? 2 : 1;
+    Json__atomicSwap(&Json__simdLevel, level);
+  }
+
+  if (level == 2) Json__blockMasksAvx2(p, classes, out);
+  else Json__blockMasksSse2(p, classes, out);
+#else
+  Json__blockMasksScalar(p, classes, out);
+#endif
+}
+
+static
+int Json__popcount64(unsigned long long x)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  int n = 0;
+  for (; x; x &= x - 1) ++n;
+  return n;
+#endif
+}
+
+static
+int Json__ctz64(unsigned long long x)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  for (; !(x & 1); x >>= 1) ++n;
+  return n;
+#endif
+}
+
+// drops escaped quotes from m and returns the in-string mask, both carried
+// over from the block before
+static
+unsigned long long Json__blockStrings(Json__BlockMasks *m, unsigned long long *next_escaped, unsigned long long *in_string)
+{
+  const unsigned long long odd_bits = 0xaaaaaaaaaaaaaaaaull;
+
+  // characters after an odd number of backslashes are escaped
+  const unsigned long long potential = m->backslash & ~*next_escaped;
+  const unsigned long long codes = (((potential << 1) | odd_bits) - potential) ^ odd_bits;
+  const unsigned long long escaped = codes ^ (potential | *next_escaped);
+  *next_escaped = (codes & m->backslash) >> 63;
+  m->quote &= ~escaped;
+
+  // prefix xor of the real quotes marks everything inside strings
+  unsigned long long strings = m->quote;
+  strings ^= strings << 1;
+  strings ^= strings << 2;
+  strings ^= strings << 4;
+  strings ^= strings << 8;
+  strings ^= strings << 16;
+  strings ^= strings << 32;
+  strings ^= *in_string;
+  *in_string = (unsigned long long)0 - (strings >> 63);
+  return strings;
+}
+
+// finds the bytes of p[0..n) in classes (for JSON__CLASS_SPACE alone, the
+// ones not in it), classifying each 64 byte block once
+typedef struct {
+  const char *p;
+  size_t n;
+  unsigned classes;
+  size_t block; // the classified block starts here, n before the first one
+  unsigned long long hits;
+} Json__Finder;
+
+static
+void Json__finderInit(Json__Finder *f, const char *p, size_t n, unsigned classes)
+{
+  f->p = p;
+  f->n = n;
+  f->classes = classes;
+  f->block = n;
+  f->hits = 0;
+}
+
+// the first hit at or after from, or n if there is none
+static
+size_t Json__finderNext(Json__Finder *f, size_t from)
+{
+  while (from < f->n) {
+    if (from < f->block || from - f->block >= 64) {
+      Json__BlockMasks m;
+      Json__blockMasks(&f->p[from], f->n - from, f->classes, &m);
+
+      f->block = from;
+      f->hits = m.quote | m.backslash | m.open | m.close | m.comma | m.colon | m.control | m.slash;
+      if (f->classes & JSON__CLASS_SPACE) f->hits |= ~m.space;
+    }
+
+    const unsigned long long hits = f->hits & (~0ull << (from - f->block));
+    if (hits) {
+      const size_t at = f->block + (size_t)Json__ctz64(hits);
+      return (at < f->n)? at : f->n;
+    }
+
+    from = f->block + 64;
+  }
+
+  return f->n;
+}
+
+static
+size_t Json__findNonSpace(const char *p, size_t n)
+{
+  // most whitespace runs are a byte or two, so those don't pay for a block
+  for (size_t i = 0; i < n && i < 4; ++i) {
+    if (p[i] != ' ' && p[i] != '\n' && p[i] != '\r' && p[i] != '\t') return i;
+  }
+
+  if (n <= 4) return n;
+
+  Json__Finder f;
+  Json__finderInit(&f, p, n, JSON__CLASS_SPACE);
+  return Json__finderNext(&f, 4);
+}
+
+// index of the bracket closing buffer[0] (buf_sz if unclosed), calling split
+// for each comma of an array on the way
+static
+size_t Json__scanContainer(
+  size_t buf_sz,
+  const char *buffer,
+  Json_Boolean (*split)(void *user, size_t pos),
+  void *user
+)
+{
+  unsigned long long next_escaped = 0, in_string = 0;
+  size_t depth = 0;
+
+  for (size_t base = 0; base < buf_sz; base += 64) {
+    Json__BlockMasks m;
+    Json__blockMasks(&buffer[base], buf_sz - base, JSON__CLASS_STRING | JSON__CLASS_BRACKET | JSON__CLASS_PUNCT, &m);
+    const unsigned long long strings = Json__blockStrings(&m, &next_escaped, &in_string);
+
+    const unsigned long long open = m.open & ~strings;
+    const unsigned long long close = m.close & ~strings;
+    const unsigned long long comma = m.comma & ~strings;
+
+    // a block that can't get back to the container's own level is skipped whole
+    const size_t nclose = (size_t)Json__popcount64(close);
+    if (depth > nclose + 1) {
+      depth = depth + (size_t)Json__popcount64(open) - nclose;
+      continue;
+    }
+
+    for (unsigned long long bits = open | close | comma; bits; bits &= bits - 1) {
+      const unsigned long long bit = bits & (0 - bits);
+      const size_t pos = base + (size_t)Json__ctz64(bits);
+
+      if (open & bit) {
+        ++depth;
+      } else if (close & bit) {
+        if (!--depth) return pos;
+      } else if (depth == 1 && split && !split(user, pos)) {
+        return buf_sz;
+      }
+    }
+  }
+
+  return buf_sz;
+}
+
+// indexes the next window of input
+static
+void Json__indexFill(Json__Index *index)
+{
+  const size_t end = (index->buf_sz - index->end > JSON__INDEX_WINDOW)? index->end + JSON__INDEX_WINDOW : index->buf_sz;
+  index->window = index->end;
+  index->len = index->next = 0;
+
+  for (size_t base = index->window; base < end; base += 64) {
+    Json__BlockMasks m;
+    Json__blockMasks(
+      &index->buffer[base], end - base, JSON__CLASS_STRING | JSON__CLASS_BRACKET | JSON__CLASS_PUNCT | JSON__CLASS_SPACE, &m
+    );
+    const unsigned long long strings = Json__blockStrings(&m, &index->next_escaped, &index->in_string);
+
+    // a scalar starts wherever a byte that isn't anything else follows one that is
+    const unsigned long long ops = m.open | m.close | m.comma | m.colon;
+    const unsigned long long scalar = ~(ops | m.space | m.quote | strings);
+    const unsigned long long starts = scalar & ~((scalar << 1) | index->prev_scalar);
+    index->prev_scalar = scalar >> 63;
+
+    unsigned long long bits = ((ops & ~strings) | m.quote | starts);
+    if (end - base < 64) bits &= (1ull << (end - base)) - 1;
+
+    for (; bits; bits &= bits - 1) {
+      index->tokens[index->len++] = (unsigned)(base - index->window) + (unsigned)Json__ctz64(bits);
+    }
+  }
+
+  index->end = end;
+}
+
+// the offset of the first token at or after at, or buf_sz if there is none;
+// at never goes backwards within a parse
+static
+size_t Json__indexSeek(Json__Index *index, size_t at)
+{
+  for (;;) {
+    for (; index->next < index->len; ++index->next) {
+      const size_t pos = index->window + index->tokens[index->next];
+      if (pos >= at) return pos;
+    }
+
+    if (index->end >= index->buf_sz) return index->buf_sz;
+    Json__indexFill(index);
+  }
+}
+
+static
+size_t Json__parseHex4(size_t buf_sz, const char *buffer, unsigned long *out)
+{
+  if (buf_sz < 4) return 0;
+
+  unsigned long val = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    const char c = buffer[i];
+    val <<= 4;
+    if (c >= '0' && c <= '9')      val |= (unsigned long)(c - '0');
+    else if (c >= 'a' && c <= 'f') val |= (unsigned long)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F') val |= (unsigned long)(c - 'A' + 10);
+    else return 0;
+  }
+
+  *out = val;
+  return 4;
+}
+
+static
+size_t Json__encodeUtf8(unsigned long codepoint, char *out)
+{
+  if (codepoint <= 0x7f) {
+    out[0] = (char)codepoint;
+    return 1;
+  }
+
+  if (codepoint <= 0x7ff) {
+    out[0] = (char)(0xc0 | ((codepoint >> 6) & 0x1f));
+    out[1] = (char)(0x80 | (codepoint & 0x3f));
+    return 2;
+  }
+
+  if (codepoint <= 0xffff) {
+    out[0] = (char)(0xe0 | ((codepoint >> 12) & 0xf));
+    out[1] = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+    out[2] = (char)(0x80 | (codepoint & 0x3f));
+    return 3;
+  }
+
+  out[0] = (char)(0xf0 | ((codepoint >> 18) & 7));
+  out[1] = (char)(0x80 | ((codepoint >> 12) & 0x3f));
+  out[2] = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+  out[3] = (char)(0x80 | (codepoint & 0x3f));
+  return 4;
+}
+
+// decodes the escapes in raw[0..raw_len) into out, which must have room for
+// raw_len + raw_len / 2 bytes (a malformed "\u" turns 2 bytes into 3)
+static
+size_t Json__unescape(size_t raw_len, const char *raw, char *out)
+{
+  size_t len = 0;
+  size_t i = 0;
+
+  while (i < raw_len) {
+    const char *esc = (const char *)memchr(&raw[i], '\\', raw_len - i);
+    const size_t run = (esc)? (size_t)(esc - &raw[i]) : raw_len - i;
+    memcpy(&out[len], &raw[i], run);
+    len += run;
+    i += run;
+    if (i >= raw_len) break;
+
+    // skip the backslash
+    if (++i >= raw_len) break;
+    switch (raw[i++]) {
+      case '"':  out[len++] = '"';  continue;
+      case '\\': out[len++] = '\\'; continue;
+      case '/':  out[len++] = '/';  continue;
+      case 'b':  out[len++] = '\b'; continue;
+      case 'f':  out[len++] = '\f'; continue;
+      case 'n':  out[len++] = '\n'; continue;
+      case 'r':  out[len++] = '\r'; continue;
+      case 't':  out[len++] = '\t'; continue;
+      case 'u': {
+        unsigned long hi = 0, lo = 0;
+        const size_t n = Json__parseHex4(raw_len - i, &raw[i], &hi);
+        if (!n) {
+          len += Json__encodeUtf8(0xfffd, &out[len]);
+          continue;
+        }
+
+        i += n;
+        if (hi < 0xd800 || hi > 0xdfff) {
+          len += Json__encodeUtf8(hi, &out[len]);
+          continue;
+        }
+
+        // json uses utf-16 surrogates for characters outside the BMP,
+        // a lone or reversed surrogate becomes U+FFFD
+        if (hi <= 0xdbff && i + 6 <= raw_len && raw[i] == '\\' && raw[i + 1] == 'u'
+            && Json__parseHex4(raw_len - i - 2, &raw[i + 2], &lo) && lo >= 0xdc00 && lo <= 0xdfff) {
+          i += 6;
+          len += Json__encodeUtf8(0x10000ul + (((hi - 0xd800) << 10) | (lo - 0xdc00)), &out[len]);
+          continue;
+        }
+
+        len += Json__encodeUtf8(0xfffd, &out[len]);
+      } continue;
+
+      // unknown escapes keep the escaped character
+      default: out[len++] = raw[i - 1]; continue;
+    }
+  }
+
+  return len;
+}
+
+// turns the raw bytes between two quotes into a Json_String,
+// borrowing them when the parse allows it; JSON_FALSE if out of memory
+static
+Json_Boolean Json__makeString(
+  Json__ParseCtx *ctx,
+  size_t raw_len,
+  const char *raw,
+  Json_Boolean has_escapes,
+  Json_String *out
+)
+{
+  static char empty[1] = "";
+
+  out->is_heap = JSON_FALSE;
+  out->len = 0;
+  out->data = empty;
+  if (!raw_len) return JSON_TRUE;
+
+  if (!has_escapes && (ctx->flags & JSON_PARSE_BORROW)) {
+    out->data = (char *)(void *)raw;
+    out->len = raw_len;
+    return JSON_TRUE;
+  }
+
+  const size_t cap = (has_escapes)? raw_len + raw_len / 2 : raw_len;
+  char *data = (char *)Json__parseAlloc(ctx, cap);
+  if (!data) return JSON_FALSE;
+
+  size_t len = raw_len;
+  if (has_escapes) {
+    len = Json__unescape(raw_len, raw, data);
+    if (len < cap && len) {
+      char *shrunk = (char *)Json__parseRealloc(ctx, data, cap, len);
+      if (shrunk) data = shrunk;
+    }
+  } else {
+    memcpy(data, raw, raw_len);
+  }
+
+  if (!len) {
+    Json__parseFree(ctx, data, cap);
+    return JSON_TRUE;
+  }
+
+  out->is_heap = !ctx->arena;
+  out->data = data;
+  out->len = len;
+  return JSON_TRUE;
+}
+
+// buffer[0] is the opening quote; returns the index of the closing one,
+// or buf_sz if the string is unterminated
+static
+size_t Json__scanString(size_t buf_sz, const char *buffer, Json_Boolean *has_escapes)
+{
+  Json__Finder f;
+  Json__finderInit(&f, buffer, buf_sz, JSON__CLASS_STRING);
+
+  size_t i = 1;
+  while (i < buf_sz) {
+    i = Json__finderNext(&f, i);
+    if (i >= buf_sz || buffer[i] == '"') break;
+
+    if (has_escapes) *has_escapes = JSON_TRUE;
+    i += 2;
+  }
+
+  return (i < buf_sz)? i : buf_sz;
+}
+
+// Json__scanString for the parser; with an index the closing quote is just
+// the token after the opening one
+static
+size_t Json__parseStringEnd(Json__ParseCtx *ctx, size_t buf_sz, const char *buffer, Json_Boolean *has_escapes)
+{
+  if (!ctx->index) return Json__scanString(buf_sz, buffer, has_escapes);
+
+  const size_t offset = (size_t)(buffer - ctx->index->buffer);
+  const size_t i = Json__indexSeek(ctx->index, offset + 1) - offset;
+  if (i >= buf_sz || buffer[i] != '"') return buf_sz;
+
+  *has_escapes = memchr(&buffer[1], '\\', i - 1) != NULL;
+  return i;
+}
+
+// buffer[0] is the opening quote; returns the number of bytes consumed, or
+// 0 (and an empty out) if the string is never closed or can't be copied
+static
+size_t Json__parseString(Json__ParseCtx *ctx, size_t buf_sz, const char *buffer, Json_String *out)
+{
+  Json_Boolean has_escapes = JSON_FALSE;
+  const size_t i = Json__parseStringEnd(ctx, buf_sz, buffer, &has_escapes);
+  if (i >= buf_sz || !Json__makeString(ctx, i - 1, &buffer[1], has_escapes, out)) {
+    memset(out, 0, sizeof(*out));
+    return 0;
+  }
+
+  return i + 1;
+}
+
+// like Json__makeString, but for object keys, which are shared through
+// ctx->keys when there is one
+static
+Json_Boolean Json__makeKey(
+  Json__ParseCtx *ctx,
+  size_t raw_len,
+  const char *raw,
+  Json_Boolean has_escapes,
+  Json_String *out
+)
+{
+  if (ctx->keys && raw_len <= JSON_KEY_POOL_MAX_LEN) {
+    Json_String name = {JSON_FALSE, raw_len, (char *)(void *)raw};
+    if (has_escapes) {
+      Json__ParseCtx heap;
+      Json__parseInit(&heap, NULL);
+      heap.allocator = ctx->allocator;
+      if (!Json__makeString(&heap, raw_len, raw, JSON_TRUE, &name)) return JSON_FALSE;
+    }
+
+    const Json_String *interned = Json__keyPoolLookup(ctx->keys, name, !(ctx->flags & JSON__PARSE_KEYS_FIXED));
+    if (name.is_heap) Json__release(ctx->allocator, name.data);
+    if (interned) {
+      *out = *interned;
+      return JSON_TRUE;
+    }
+  }
+
+  return Json__makeString(ctx, raw_len, raw, has_escapes, out);
+}
+
+static
+size_t Json__parseKey(Json__ParseCtx *ctx, size_t buf_sz, const char *buffer, Json_String *out)
+{
+  Json_Boolean has_escapes = JSON_FALSE;
+  const size_t i = Json__parseStringEnd(ctx, buf_sz, buffer, &has_escapes);
+  if (i >= buf_sz || !Json__makeKey(ctx, i - 1, &buffer[1], has_escapes, out)) {
+    memset(out, 0, sizeof(*out));
+    return 0;
+  }
+
+  return i + 1;
+}
+
+static
+size_t Json__parseValue(Json__ParseCtx *ctx, size_t buf_sz, const char *buffer, Json_Value *out);
+
+// a whole parse of one document with a fresh ctx, which gets a structural
+// index for it
+static
+size_t Json__parseRoot(Json__ParseCtx *ctx, size_t buf_sz, const char *buffer, Json_Value *out)
+{
+  const double start = (ctx->stats)? Json__now() : 0.0;
+
+  Json__Index index;
+  index.buffer = buffer;
+  index.buf_sz = buf_sz;
+  index.window = index.end = index.len = index.next = 0;
+  index.next_escaped = index.in_string = index.prev_scalar = 0;
+  ctx->index = &index;
+
+  const size_t ret = Json__parseValue(ctx, buf_sz, buffer, out);
+  ctx->index = NULL;
+  Json__parseDone(ctx);
+
+  if (ctx->stats) ctx->stats->seconds += Json__now() - start;
+  return ret;
+}
+
+static
+size_t Json__parseFile(Json__ParseCtx *ctx, FILE *file, Json_Value *out)
+{
+  if (!out) return 0;
+  memset(out, 0, sizeof(*out));
+  if (!file) return 0;
+
+  const long start = ftell(file);
+  fseek(file, 0, SEEK_END);
+  const long buf_sz = ftell(file) - start + 1;
+  if (buf_sz <= 1l || buf_sz > 1073741823l) return 0;
+
+  // borrowed strings point into the buffer, so it has to live in the arena
+  const Json_Boolean keep = ctx->arena && (ctx->flags & JSON_PARSE_BORROW);
+  if (!keep) ctx->flags &= ~JSON_PARSE_BORROW;
+
+  char *buffer = (char *)((keep)? Json__parseAlloc(ctx, buf_sz) : Json__alloc(ctx->allocator, buf_sz));
+  if (!buffer) return 0;
+  buffer[buf_sz - 1] = '\0';
+
+  fseek(file, start, SEEK_SET);
+  fread(buffer, 1, buf_sz - 1, file);
+  const size_t ret = Json__parseRoot(ctx, buf_sz, buffer, out);
+
+  if (!keep) Json__release(ctx->allocator, buffer);
+  return ret;
+}
+
+size_t Json_parseFile(FILE *file, Json_Value *out)
+{
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, NULL);
+  return Json__parseFile(&ctx, file, out);
+}
+
+size_t Json_parseFileArena(Json_Arena *arena, FILE *file, Json_Value *out)
+{
+  if (!arena) {
+    if (out) memset(out, 0, sizeof(*out));
+    return 0;
+  }
+
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, NULL);
+  ctx.arena = arena;
+  return Json__parseFile(&ctx, file, out);
+}
+
+size_t Json_parseStr(size_t buf_sz, const char *buffer, Json_Value *out)
+{
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, NULL);
+  return Json__parseRoot(&ctx, buf_sz, buffer, out);
+}
+
+size_t Json_parseStrArena(Json_Arena *arena, size_t buf_sz, const char *buffer, Json_Value *out)
+{
+  if (!arena) {
+    if (out) memset(out, 0, sizeof(*out));
+    return 0;
+  }
+
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, NULL);
+  ctx.arena = arena;
+  return Json__parseRoot(&ctx, buf_sz, buffer, out);
+}
+
+size_t Json_parseFileEx(FILE *file, Json_Value *out, const Json_ParseOptions *opts)
+{
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, opts);
+  return Json__parseFile(&ctx, file, out);
+}
+
+size_t Json_parseStrEx(size_t buf_sz, const char *buffer, Json_Value *out, const Json_ParseOptions *opts)
+{
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, opts);
+  return Json__parseRoot(&ctx, buf_sz, buffer, out);
+}
+
+Json_Boolean Json_mapFile(const char *path, Json_MappedFile *out)
+{
+  if (!path || !out) return JSON_FALSE;
+  memset(out, 0, sizeof(*out));
+
+#ifdef JSON__HAVE_MMAP
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return JSON_FALSE;
+
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size <= 0 || (unsigned long long)st.st_size > (size_t)-1) {
+    close(fd);
+    return JSON_FALSE;
+  }
+
+  void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return JSON_FALSE;
+
+  // the parser only ever walks forwards
+# if defined(MADV_SEQUENTIAL)
+  madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+# elif defined(POSIX_MADV_SEQUENTIAL)
+  posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+# endif
+
+  out->data = (const char *)data;
+  out->len = (size_t)st.st_size;
+  out->is_mapped = JSON_TRUE;
+  return JSON_TRUE;
+#else
+  FILE *file = fopen(path, "rb");
+  if (!file) return JSON_FALSE;
+
+  char *data = NULL;
+  size_t len = 0, cap = 0;
+  for (;;) {
+    if (len == cap) {
+      cap = (cap)? 2 * cap : 64 * 1024;
+      char *grown = (char *)Json__resize(NULL, data, cap);
+      if (!grown) break;
+      data = grown;
+    }
+
+    const size_t n = fread(&data[len], 1, cap - len, file);
+    len += n;
+    if (n == 0) break;
+  }
+
+  const int failed = ferror(file);
+  fclose(file);
+  if (!len || !data || failed) {
+    Json__release(NULL, data);
+    return JSON_FALSE;
+  }
+
+  out->data = data;
+  out->len = len;
+  return JSON_TRUE;
+#endif
+}
+
+void Json_unmapFile(Json_MappedFile *file)
+{
+  if (!file || !file->data) return;
+
+#ifdef JSON__HAVE_MMAP
+  if (file->is_mapped) munmap((void *)file->data, file->len);
+  else Json__release(NULL, (void *)file->data);
+#else
+  Json__release(NULL, (void *)file->data);
+#endif
+
+  memset(file, 0, sizeof(*file));
+}
+
+size_t Json_parseFileMapped(const char *path, Json_Value *out, const Json_ParseOptions *opts)
+{
+  if (!out) return 0;
+  memset(out, 0, sizeof(*out));
+
+  Json_MappedFile file;
+  if (!Json_mapFile(path, &file)) return 0;
+
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, opts);
+  ctx.flags &= ~JSON_PARSE_BORROW;
+
+  const size_t ret = Json__parseRoot(&ctx, file.len, file.data, out);
+  Json_unmapFile(&file);
+  return ret;
+}
+
+static
+size_t Json__skipSpace(size_t buf_sz, const char *buffer, size_t i)
+{
+  if (i >= buf_sz) return i;
+  return i + Json__findNonSpace(&buffer[i], buf_sz - i);
+}
+
+// Json__skipSpace for the parser, which jumps to the next token when it has
+// an index; buffer ends where the indexed one does
+static
+size_t Json__parseSpace(Json__ParseCtx *ctx, size_t buf_sz, const char *buffer, size_t i)
+{
+  if (i >= buf_sz) return i;
+
+  const char c = buffer[i];
+  if (c != ' ' && c != '\n' && c != '\r' && c != '\t') return i;
+  if (!ctx->index) return i + Json__findNonSpace(&buffer[i], buf_sz - i);
+
+  const size_t offset = (size_t)(buffer - ctx->index->buffer);
+  return Json__indexSeek(ctx->index, offset + i) - offset;
+}
+
+static
+Json_Boolean Json__isNumberChar(char c)
+{
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// the powers of ten a double holds exactly
+static const double Json__pow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// correctly rounded slow path: strtod on "<digits>e<exponent>", which has no
+// decimal point and so reads the same in every locale
+static
+double Json__strtodDigits(size_t len, const char *buffer, long exp10)
+{
+  char local[64];
+  const size_t cap = len + 32;
+  char *str = (cap <= sizeof(local))? local : (char *)Json__alloc(NULL, cap);
+  if (!str) return NAN;
+
+  size_t n = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (isdigit((unsigned char)buffer[i])) str[n++] = buffer[i];
+  }
+  snprintf(&str[n], cap - n, "e%ld", exp10);
+
+  const double ret = strtod(str, NULL);
+  if (str != local) Json__release(NULL, str);
+  return ret;
+}
+
+// returns the number of bytes consumed, or 0 if buffer doesn't start with a number
+static
+size_t Json__parseNumber(size_t buf_sz, const char *buffer, Json_Value *out)
+{
+  size_t i = 0;
+  const Json_Boolean neg = buf_sz && buffer[0] == '-';
+  if (neg) ++i;
+
+  // up to 19 significant digits always fit in the mantissa
+  const size_t digits = i;
+  unsigned long long mantissa = 0;
+  int nsig = 0;
+  long exp10 = 0;
+  Json_Boolean truncated = JSON_FALSE;
+
+  if (i >= buf_sz || !isdigit((unsigned char)buffer[i])) return 0;
+  if (buffer[i] == '0') {
+    ++i;
+  } else for (; i < buf_sz && isdigit((unsigned char)buffer[i]); ++i) {
+    if (nsig < 19) {
+      mantissa = 10 * mantissa + (unsigned)(buffer[i] - '0');
+      ++nsig;
+    } else {
+      ++exp10;
+      truncated = JSON_TRUE;
+    }
+  }
+
+  const size_t int_end = i;
+  if (i < buf_sz && buffer[i] == '.') {
+    if (++i >= buf_sz || !isdigit((unsigned char)buffer[i])) return 0;
+
+    for (; i < buf_sz && isdigit((unsigned char)buffer[i]); ++i) {
+      if (nsig >= 19) {
+        truncated = JSON_TRUE;
+        continue;
+      }
+
+      mantissa = 10 * mantissa + (unsigned)(buffer[i] - '0');
+      if (mantissa) ++nsig;
+      --exp10;
+    }
+  }
+
+  const size_t mantissa_end = i;
+  long exp = 0;
+  if (i < buf_sz && (buffer[i] == 'e' || buffer[i] == 'E')) {
+    ++i;
+    const Json_Boolean exp_neg = i < buf_sz && buffer[i] == '-';
+    if (i < buf_sz && (buffer[i] == '-' || buffer[i] == '+')) ++i;
+    if (i >= buf_sz || !isdigit((unsigned char)buffer[i])) return 0;
+    for (; i < buf_sz && isdigit((unsigned char)buffer[i]); ++i) {
+      if (exp < 100000) exp = 10 * exp + (buffer[i] - '0');
+    }
+
+    if (exp_neg) exp = -exp;
+    exp10 += exp;
+  }
+
+  memset(out, 0, sizeof(*out));
+
+  if (i == int_end && !truncated) {
+    if (!neg && mantissa <= 9223372036854775807ull) {
+      out->type = JSON_TYPE_INTEGER;
+      out->v.as_integer = (Json_Integer)mantissa;
+      return i;
+    }
+
+    // -0 stays a double so the sign survives
+    if (neg && mantissa && mantissa <= 9223372036854775808ull) {
+      out->type = JSON_TYPE_INTEGER;
+      out->v.as_integer = -(Json_Integer)(mantissa - 1) - 1;
+      return i;
+    }
+  }
+
+  out->type = JSON_TYPE_NUMBER;
+
+  // exact when both the mantissa and the power of ten are exact doubles
+  // and only one rounding happens
+  double val;
+  if (!truncated && mantissa <= (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+    val = (exp10 < 0)? (double)mantissa / Json__pow10[-exp10] : (double)mantissa * Json__pow10[exp10];
+  } else if (!mantissa && !truncated) {
+    val = 0.0;
+  } else {
+    // strtod gets every digit with the decimal point dropped, so the
+    // exponent has to account for the digits that followed it
+    const long frac = (long)((mantissa_end > int_end)? mantissa_end - int_end - 1 : 0);
+    val = Json__strtodDigits(mantissa_end - digits, &buffer[digits], exp - frac);
+  }
+
+  out->v.as_number = (neg)? -val : val;
+  return i;
+}
+
+// bytes consumed with trailing whitespace, or 0 with out null on error;
+// never reads past buffer[buf_sz - 1]
+static
+size_t Json__parseValue(Json__ParseCtx *ctx, size_t buf_sz, const char *buffer, Json_Value *out)
+{
+  if (!out) return 0;
+  memset(out, 0, sizeof(*out));
+  if (!buffer || !buf_sz) return 0;
+
+  size_t ret = Json__parseSpace(ctx, buf_sz, buffer, 0);
+  if (ret >= buf_sz) return 0;
+  if (ctx->stats) ++ctx->stats->nodes;
+
+  if (buffer[ret] == '-' || isdigit((unsigned char)buffer[ret])) {
+    const size_t n = Json__parseNumber(buf_sz - ret, &buffer[ret], out);
+    if (!n) {
+      memset(out, 0, sizeof(*out));
+      return 0;
+    }
+    return Json__parseSpace(ctx, buf_sz, buffer, ret + n);
+  }
+
+  switch (buffer[ret]) {
+    case 'n':
+      if (buf_sz - ret < 4 || memcmp(&buffer[ret], "null", 4)) return 0;
+      ret += 4;
+      out->type = JSON_TYPE_NULL;
+      break;
+
+    case 't':
+      if (buf_sz - ret < 4 || memcmp(&buffer[ret], "true", 4)) return 0;
+      ret += 4;
+      out->type = JSON_TYPE_BOOLEAN;
+      out->v.as_boolean = JSON_TRUE;
+      break;
+
+    case 'f':
+      if (buf_sz - ret < 5 || memcmp(&buffer[ret], "false", 5)) return 0;
+      ret += 5;
+      out->type = JSON_TYPE_BOOLEAN;
+      out->v.as_boolean = JSON_FALSE;
+      break;
+
+    case '"': {
+      const size_t n = Json__parseString(ctx, buf_sz - ret, &buffer[ret], &out->v.as_string);
+      if (!n) return 0;
+      out->type = JSON_TYPE_STRING;
+      ret += n;
+    } break;
+
+    case '[': {
+      out->type = JSON_TYPE_ARRAY;
+      memset(&out->v.as_array, 0, sizeof(Json_Array));
+
+      ret = Json__parseSpace(ctx, buf_sz, buffer, ret + 1);
+      if (ret < buf_sz && buffer[ret] == ']') {
+        ++ret;
+        break;
+      }
+
+      const size_t base = ctx->stack_len;
+      Json_Boolean closed = JSON_FALSE;
+      while (ret < buf_sz) {
+        Json_Value elem;
+        const size_t n = Json__parseValue(ctx, buf_sz - ret, &buffer[ret], &elem);
+        if (!n) break;
+
+        ret += n;
+        if (!Json__parseReserve(ctx, 1)) {
+          if (!ctx->arena) Json_destroyValueWith(&elem, ctx->allocator);
+          break;
+        }
+        ctx->stack[ctx->stack_len++] = elem;
+
+        if (ret < buf_sz && buffer[ret] == ',') {
+          ret = Json__parseSpace(ctx, buf_sz, buffer, ret + 1);
+          continue;
+        }
+
+        closed = ret < buf_sz && buffer[ret] == ']';
+        ++ret;
+        break;
+      }
+
+      if (!Json__parseArrayEnd(ctx, &out->v.as_array, base) || !closed) {
+        Json__parseDrop(ctx, out);
+        return 0;
+      }
+    } break;
+
+    case '{': {
+      out->type = JSON_TYPE_OBJECT;
+      memset(&out->v.as_object, 0, sizeof(Json_Object));
+
+      ret = Json__parseSpace(ctx, buf_sz, buffer, ret + 1);
+      if (ret < buf_sz && buffer[ret] == '}') {
+        ++ret;
+        break;
+      }
+
+      const size_t base = ctx->stack_len;
+      Json_Boolean closed = JSON_FALSE;
+      while (ret < buf_sz && buffer[ret] == '"') {
+        Json_Value name;
+        memset(&name, 0, sizeof(name));
+        name.type = JSON_TYPE_STRING;
+
+        size_t n = Json__parseKey(ctx, buf_sz - ret, &buffer[ret], &name.v.as_string);
+        if (!n) break;
+        ret = Json__parseSpace(ctx, buf_sz, buffer, ret + n);
+
+        n = 0;
+        Json_Value val;
+        if (ret < buf_sz && buffer[ret] == ':') {
+          ret = Json__parseSpace(ctx, buf_sz, buffer, ret + 1);
+          n = Json__parseValue(ctx, buf_sz - ret, &buffer[ret], &val);
+        }
+
+        if (n && !Json__parseReserve(ctx, 2)) {
+          if (!ctx->arena) Json_destroyValueWith(&val, ctx->allocator);
+          n = 0;
+        }
+
+        if (!n) {
+          if (name.v.as_string.is_heap) Json__release(ctx->allocator, name.v.as_string.data);
+          break;
+        }
+
+        ret += n;
+        ctx->stack[ctx->stack_len++] = name;
+        ctx->stack[ctx->stack_len++] = val;
+
+        if (ret < buf_sz && buffer[ret] == ',') {
+          ret = Json__parseSpace(ctx, buf_sz, buffer, ret + 1);
+          continue;
+        }
+
+        closed = ret < buf_sz && buffer[ret] == '}';
+        ++ret;
+        break;
+      }
+
+      if (!Json__parseObjectEnd(ctx, &out->v.as_object, base) || !closed) {
+        Json__parseDrop(ctx, out);
+        return 0;
+      }
+    } break;
+
+    default: return 0;
+  }
+
+  return Json__parseSpace(ctx, buf_sz, buffer, ret);
+}
+
+enum {
+  JSON__PUSH_VALUE,        // a value must come next
+  JSON__PUSH_ARRAY_FIRST,  // just after '[', a value or ']'
+  JSON__PUSH_OBJECT_FIRST, // just after '{', a key or '}'
+  JSON__PUSH_KEY,          // just after ',' in an object
+  JSON__PUSH_COLON,
+  JSON__PUSH_AFTER,        // a value ended, ',' or a closing bracket
+  JSON__PUSH_STRING,
+  JSON__PUSH_KEY_STRING,
+  JSON__PUSH_NUMBER,
+  JSON__PUSH_LITERAL,
+  JSON__PUSH_DONE
+};
+
+void Json_parserInit(Json_Parser *parser, const Json_ParseOptions *opts)
+{
+  if (!parser) return;
+  memset(parser, 0, sizeof(*parser));
+  if (opts) parser->opts = *opts;
+  parser->opts.flags &= ~JSON_PARSE_BORROW;
+  parser->state = JSON__PUSH_VALUE;
+}
+
+static
+Json_Boolean Json__parserTok(Json_Parser *parser, const char *bytes, size_t len)
+{
+  if (parser->tok_len + len > parser->tok_cap) {
+    size_t cap = (parser->tok_cap)? parser->tok_cap : 64;
+    while (cap < parser->tok_len + len) cap *= 2;
+
+    char *tok = (char *)Json__resize(parser->opts.allocator, parser->tok, cap);
+    if (!tok) return JSON_FALSE;
+    parser->tok = tok;
+    parser->tok_cap = cap;
+  }
+
+  if (len) memcpy(&parser->tok[parser->tok_len], bytes, len);
+  parser->tok_len += len;
+  return JSON_TRUE;
+}
+
+// hands a finished value to the innermost open container, or makes it the root;
+// if the container can't grow the value is thrown away and the parse fails
+static
+Json_Boolean Json__parserEmit(Json_Parser *parser, const Json_Value *value)
+{
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, &parser->opts);
+  if (ctx.stats) ++ctx.stats->nodes;
+
+  parser->state = JSON__PUSH_AFTER;
+  if (!parser->depth) {
+    parser->root = *value;
+    parser->state = JSON__PUSH_DONE;
+    return JSON_TRUE;
+  }
+
+  Json_ParserFrame *top = &parser->stack[parser->depth - 1];
+  const Json_Boolean added = (top->value.type == JSON_TYPE_ARRAY)
+    ? Json__parseAppend(&ctx, &top->value.v.as_array, value)
+    : Json__parseSet(&ctx, &top->value.v.as_object, top->key, value);
+
+  if (!added && !ctx.arena) {
+    Json_Value dropped = *value;
+    Json_destroyValueWith(&dropped, ctx.allocator);
+    if (top->value.type == JSON_TYPE_OBJECT && top->key.is_heap) Json__release(ctx.allocator, top->key.data);
+  }
+
+  memset(&top->key, 0, sizeof(top->key));
+  if (!added) parser->failed = JSON_TRUE;
+  return added;
+}
+
+static
+Json_Boolean Json__parserOpen(Json_Parser *parser, Json_Type type)
+{
+  if (parser->depth + 1 > parser->stack_cap) {
+    const size_t cap = (parser->stack_cap)? 2 * parser->stack_cap : 16;
+    Json_ParserFrame *stack = (Json_ParserFrame *)Json__resize(
+      parser->opts.allocator, parser->stack, sizeof(Json_ParserFrame) * cap
+    );
+    if (!stack) return JSON_FALSE;
+    parser->stack = stack;
+    parser->stack_cap = cap;
+  }
+
+  Json_ParserFrame *frame = &parser->stack[parser->depth++];
+  memset(frame, 0, sizeof(*frame));
+  frame->value.type = type;
+
+  parser->state = (type == JSON_TYPE_ARRAY)? JSON__PUSH_ARRAY_FIRST : JSON__PUSH_OBJECT_FIRST;
+  return JSON_TRUE;
+}
+
+static
+Json_Boolean Json__parserClose(Json_Parser *parser)
+{
+  Json_Value value = parser->stack[--parser->depth].value;
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, &parser->opts);
+
+  // containers grew one child at a time, the slack goes now
+  if (value.type == JSON_TYPE_ARRAY) {
+    Json_Array *array = &value.v.as_array;
+    if (array->cap > array->len && array->len && Json__storageRefs(array->elems) == 1) {
+      Json_Value *elems = (Json_Value *)Json__storageRealloc(
+        &ctx, array->elems, sizeof(Json_Value) * array->cap, sizeof(Json_Value) * array->len
+      );
+      if (elems) {
+        array->elems = elems;
+        array->cap = array->len;
+      }
+    }
+  } else {
+    Json_Object *object = &value.v.as_object;
+    if (object->cap > object->len && object->len && Json__storageRefs(object->field_values) == 1) {
+      Json_String *names = (Json_String *)Json__parseRealloc(
+        &ctx, object->field_names, sizeof(Json_String) * object->cap, sizeof(Json_String) * object->len
+      );
+      if (names) object->field_names = names;
+
+      Json_Value *values = (Json_Value *)Json__storageRealloc(
+        &ctx, object->field_values, sizeof(Json_Value) * object->cap, sizeof(Json_Value) * object->len
+      );
+      if (values) object->field_values = values;
+      if (names || values) object->cap = object->len;
+    }
+  }
+
+  return Json__parserEmit(parser, &value);
+}
+
+// finishes a number or literal once the byte after it shows up (or the input ends)
+static
+Json_Boolean Json__parserEndScalar(Json_Parser *parser)
+{
+  Json_Value value;
+  memset(&value, 0, sizeof(value));
+
+  if (parser->state == JSON__PUSH_NUMBER) {
+    if (Json__parseNumber(parser->tok_len, parser->tok, &value) != parser->tok_len) return JSON_FALSE;
+  } else if (parser->tok_len == 4 && !memcmp(parser->tok, "null", 4)) {
+    value.type = JSON_TYPE_NULL;
+  } else if (parser->tok_len == 4 && !memcmp(parser->tok, "true", 4)) {
+    value.type = JSON_TYPE_BOOLEAN;
+    value.v.as_boolean = JSON_TRUE;
+  } else if (parser->tok_len == 5 && !memcmp(parser->tok, "false", 5)) {
+    value.type = JSON_TYPE_BOOLEAN;
+    value.v.as_boolean = JSON_FALSE;
+  } else {
+    return JSON_FALSE;
+  }
+
+  return Json__parserEmit(parser, &value);
+}
+
+static
+Json_Boolean Json__parserStep(Json_Parser *parser, const char *chunk, size_t len)
+{
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, &parser->opts);
+  size_t i = 0;
+
+  while (i < len) {
+    switch (parser->state) {
+      case JSON__PUSH_STRING:
+      case JSON__PUSH_KEY_STRING: {
+        const size_t start = i;
+        for (; i < len; ++i) {
+          if (parser->tok_escaped) {
+            parser->tok_escaped = JSON_FALSE;
+            continue;
+          }
+
+          if (chunk[i] == '\\') {
+            parser->tok_escaped = parser->tok_has_escapes = JSON_TRUE;
+            continue;
+          }
+
+          if (chunk[i] == '"') break;
+        }
+
+        if (!Json__parserTok(parser, &chunk[start], i - start)) return JSON_FALSE;
+        if (i >= len) return JSON_TRUE;
+        ++i;
+
+        Json_String str;
+        const Json_Boolean made = (parser->state == JSON__PUSH_KEY_STRING)
+          ? Json__makeKey(&ctx, parser->tok_len, parser->tok, parser->tok_has_escapes, &str)
+          : Json__makeString(&ctx, parser->tok_len, parser->tok, parser->tok_has_escapes, &str);
+        if (!made) return JSON_FALSE;
+
+        if (parser->state == JSON__PUSH_KEY_STRING) {
+          parser->stack[parser->depth - 1].key = str;
+          parser->state = JSON__PUSH_COLON;
+          continue;
+        }
+
+        Json_Value value;
+        memset(&value, 0, sizeof(value));
+        value.type = JSON_TYPE_STRING;
+        value.v.as_string = str;
+        if (!Json__parserEmit(parser, &value)) return JSON_FALSE;
+      } continue;
+
+      case JSON__PUSH_NUMBER:
+      case JSON__PUSH_LITERAL: {
+        const size_t start = i;
+        if (parser->state == JSON__PUSH_NUMBER) {
+          while (i < len && Json__isNumberChar(chunk[i])) ++i;
+        } else {
+          while (i < len && chunk[i] >= 'a' && chunk[i] <= 'z') ++i;
+        }
+
+        if (!Json__parserTok(parser, &chunk[start], i - start)) return JSON_FALSE;
+        if (i >= len) return JSON_TRUE;
+        if (!Json__parserEndScalar(parser)) return JSON_FALSE;
+      } continue;
+
+      default: break;
+    }
+
+    const char c = chunk[i];
+    if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      ++i;
+      continue;
+    }
+
+    switch (parser->state) {
+      case JSON__PUSH_ARRAY_FIRST:
+        if (c == ']') {
+          ++i;
+          if (!Json__parserClose(parser)) return JSON_FALSE;
+          continue;
+        }
+        // fallthrough
+      case JSON__PUSH_VALUE:
+        parser->tok_len = 0;
+        parser->tok_escaped = parser->tok_has_escapes = JSON_FALSE;
+
+        if (c == '"') {
+          parser->state = JSON__PUSH_STRING;
+          ++i;
+        } else if (c == '-' || isdigit((unsigned char)c)) {
+          parser->state = JSON__PUSH_NUMBER;
+        } else if (c == 'n' || c == 't' || c == 'f') {
+          parser->state = JSON__PUSH_LITERAL;
+        } else if (c == '[' || c == '{') {
+          if (!Json__parserOpen(parser, (c == '[')? JSON_TYPE_ARRAY : JSON_TYPE_OBJECT)) return JSON_FALSE;
+          ++i;
+        } else {
+          return JSON_FALSE;
+        }
+        continue;
+
+      case JSON__PUSH_OBJECT_FIRST:
+        if (c == '}') {
+          ++i;
+          if (!Json__parserClose(parser)) return JSON_FALSE;
+          continue;
+        }
+        // fallthrough
+      case JSON__PUSH_KEY:
+        if (c != '"') return JSON_FALSE;
+        parser->tok_len = 0;
+        parser->tok_escaped = parser->tok_has_escapes = JSON_FALSE;
+        parser->state = JSON__PUSH_KEY_STRING;
+        ++i;
+        continue;
+
+      case JSON__PUSH_COLON:
+        if (c != ':') return JSON_FALSE;
+        parser->state = JSON__PUSH_VALUE;
+        ++i;
+        continue;
+
+      case JSON__PUSH_AFTER: {
+        const Json_Type type = parser->stack[parser->depth - 1].value.type;
+        ++i;
+        if (c == ',') {
+          parser->state = (type == JSON_TYPE_ARRAY)? JSON__PUSH_VALUE : JSON__PUSH_KEY;
+          continue;
+        }
+
+        if (c != ((type == JSON_TYPE_ARRAY)? ']' : '}')) return JSON_FALSE;
+        if (!Json__parserClose(parser)) return JSON_FALSE;
+      } continue;
+
+      // only whitespace may follow the document
+      default: return JSON_FALSE;
+    }
+  }
+
+  return JSON_TRUE;
+}
+
+Json_Boolean Json_parserFeed(Json_Parser *parser, const char *chunk, size_t len)
+{
+  if (!parser || parser->failed) return JSON_FALSE;
+  if (!chunk || !len) return JSON_TRUE;
+
+  Json_Stats *stats = parser->opts.stats;
+  const double start = (stats)? Json__now() : 0.0;
+  if (!Json__parserStep(parser, chunk, len)) parser->failed = JSON_TRUE;
+
+  if (stats) stats->seconds += Json__now() - start;
+  return !parser->failed;
+}
+
+Json_Boolean Json_parserFinish(Json_Parser *parser, Json_Value *out)
+{
+  if (!parser || parser->failed) return JSON_FALSE;
+
+  // a number or literal at the very end has nothing after it to end it
+  if (parser->state == JSON__PUSH_NUMBER || parser->state == JSON__PUSH_LITERAL) {
+    if (!Json__parserEndScalar(parser)) parser->failed = JSON_TRUE;
+  }
+
+  if (parser->failed || parser->state != JSON__PUSH_DONE) return JSON_FALSE;
+
+  if (out) *out = parser->root;
+  memset(&parser->root, 0, sizeof(parser->root));
+  parser->state = JSON__PUSH_VALUE;
+  return JSON_TRUE;
+}
+
+void Json_parserDestroy(Json_Parser *parser)
+{
+  if (!parser) return;
+
+  // arena memory goes away with the arena
+  const Json_Allocator *allocator = parser->opts.allocator;
+  if (!parser->opts.arena) {
+    for (size_t i = 0; i < parser->depth; ++i) {
+      if (parser->stack[i].key.is_heap) Json__release(allocator, parser->stack[i].key.data);
+      Json_destroyValueWith(&parser->stack[i].value, allocator);
+    }
+
+    if (parser->state == JSON__PUSH_DONE) Json_destroyValueWith(&parser->root, allocator);
+  }
+
+  Json__release(allocator, parser->stack);
+  Json__release(allocator, parser->tok);
+  memset(parser, 0, sizeof(*parser));
+}
+
+// skips one value without decoding it and returns the number of bytes it
+// (and any whitespace before and after it) takes up, or 0 if it is malformed
+static
+size_t Json__skipValue(size_t buf_sz, const char *buffer)
+{
+  size_t i = Json__skipSpace(buf_sz, buffer, 0);
+  if (i >= buf_sz) return 0;
+
+  switch (buffer[i]) {
+    case '"': {
+      const size_t end = Json__scanString(buf_sz - i, &buffer[i], NULL);
+      if (i + end >= buf_sz) return 0;
+      i += end + 1;
+    } break;
+
+    case '[':
+    case '{': {
+      const size_t end = Json__scanContainer(buf_sz - i, &buffer[i], NULL, NULL);
+      if (i + end >= buf_sz) return 0;
+      i += end + 1;
+    } break;
+
+    default: {
+      const size_t start = i;
+      while (i < buf_sz && (Json__isNumberChar(buffer[i]) || (buffer[i] >= 'a' && buffer[i] <= 'z'))) ++i;
+      if (i == start) return 0;
+    } break;
+  }
+
+  return Json__skipSpace(buf_sz, buffer, i);
+}
+
+typedef struct {
+  const Json_EventHandler *handler;
+  Json_Boolean stopped;
+
+  // escaped strings are decoded here, everything else is handed out in place
+  size_t scratch_cap;
+  char *scratch;
+} Json__EventCtx;
+
+static
+Json_Boolean Json__eventString(Json__EventCtx *ctx, size_t buf_sz, const char *buffer, Json_String *out, size_t *consumed)
+{
+  Json_Boolean has_escapes = JSON_FALSE;
+  const size_t end = Json__scanString(buf_sz, buffer, &has_escapes);
+  if (end >= buf_sz) return JSON_FALSE;
+
+  *consumed = end + 1;
+  out->is_heap = JSON_FALSE;
+  out->len = end - 1;
+  out->data = (char *)(void *)&buffer[1];
+  if (!has_escapes) return JSON_TRUE;
+
+  const size_t cap = out->len + out->len / 2;
+  if (cap > ctx->scratch_cap) {
+    char *scratch = (char *)Json__resize(NULL, ctx->scratch, cap);
+    if (!scratch) return JSON_FALSE;
+    ctx->scratch = scratch;
+    ctx->scratch_cap = cap;
+  }
+
+  out->len = Json__unescape(out->len, &buffer[1], ctx->scratch);
+  out->data = ctx->scratch;
+  return JSON_TRUE;
+}
+
+// same shape as Json__parseValue, but reports events instead of building values
+static
+size_t Json__parseEvents(Json__EventCtx *ctx, size_t buf_sz, const char *buffer)
+{
+  const Json_EventHandler *h = ctx->handler;
+  int res = JSON_EVENT_CONTINUE;
+
+  size_t ret = Json__skipSpace(buf_sz, buffer, 0);
+  if (ret >= buf_sz) return 0;
+
+  if (buffer[ret] == '-' || isdigit((unsigned char)buffer[ret])) {
+    Json_Value num;
+    const size_t n = Json__parseNumber(buf_sz - ret, &buffer[ret], &num);
+    if (!n) return 0;
+
+    if (num.type == JSON_TYPE_INTEGER && h->integer) res = h->integer(h->user, num.v.as_integer);
+    else if (num.type == JSON_TYPE_INTEGER && h->number) res = h->number(h->user, (Json_Number)num.v.as_integer);
+    else if (h->number) res = h->number(h->user, num.v.as_number);
+    ret += n;
+  } else switch (buffer[ret]) {
+    case 'n':
+      if (buf_sz - ret < 4 || memcmp(&buffer[ret], "null", 4)) return 0;
+      if (h->null) res = h->null(h->user);
+      ret += 4;
+      break;
+
+    case 't':
+    case 'f': {
+      const Json_Boolean val = buffer[ret] == 't';
+      const size_t len = (val)? 4 : 5;
+      if (buf_sz - ret < len || memcmp(&buffer[ret], (val)? "true" : "false", len)) return 0;
+      if (h->boolean) res = h->boolean(h->user, val);
+      ret += len;
+    } break;
+
+    case '"': {
+      Json_String str;
+      size_t n;
+      if (!Json__eventString(ctx, buf_sz - ret, &buffer[ret], &str, &n)) return 0;
+      if (h->string) res = h->string(h->user, str);
+      ret += n;
+    } break;
+
+    case '[':
+    case '{': {
+      const Json_Boolean is_array = buffer[ret] == '[';
+      const char close = (is_array)? ']' : '}';
+
+      res = (is_array)? ((h->start_array)? h->start_array(h->user) : JSON_EVENT_CONTINUE) :
+                        ((h->start_object)? h->start_object(h->user) : JSON_EVENT_CONTINUE);
+      if (res == JSON_EVENT_STOP) break;
+      if (res == JSON_EVENT_SKIP) {
+        const size_t n = Json__skipValue(buf_sz - ret, &buffer[ret]);
+        return (n)? ret + n : 0;
+      }
+
+      ret = Json__skipSpace(buf_sz, buffer, ret + 1);
+      if (ret < buf_sz && buffer[ret] == close) {
+        ++ret;
+      } else for (;;) {
+        if (!is_array) {
+          Json_String key;
+          size_t n;
+          if (ret >= buf_sz || buffer[ret] != '"') return 0;
+          if (!Json__eventString(ctx, buf_sz - ret, &buffer[ret], &key, &n)) return 0;
+          ret = Json__skipSpace(buf_sz, buffer, ret + n);
+          if (ret >= buf_sz || buffer[ret] != ':') return 0;
+          ++ret;
+
+          res = (h->key)? h->key(h->user, key) : JSON_EVENT_CONTINUE;
+          if (res == JSON_EVENT_STOP) {
+            ctx->stopped = JSON_TRUE;
+            return ret;
+          }
+        }
+
+        const size_t n = (!is_array && res == JSON_EVENT_SKIP)?
+          Json__skipValue(buf_sz - ret, &buffer[ret]) :
+          Json__parseEvents(ctx, buf_sz - ret, &buffer[ret]);
+        if (!n) return 0;
+        ret += n;
+        if (ctx->stopped) return ret;
+
+        if (ret < buf_sz && buffer[ret] == ',') {
+          ret = Json__skipSpace(buf_sz, buffer, ret + 1);
+          continue;
+        }
+
+        if (ret >= buf_sz || buffer[ret] != close) return 0;
+        ++ret;
+        break;
+      }
+
+      res = (is_array)? ((h->end_array)? h->end_array(h->user) : JSON_EVENT_CONTINUE) :
+                        ((h->end_object)? h->end_object(h->user) : JSON_EVENT_CONTINUE);
+    } break;
+
+    default: return 0;
+  }
+
+  if (res == JSON_EVENT_STOP) ctx->stopped = JSON_TRUE;
+  return Json__skipSpace(buf_sz, buffer, ret);
+}
+
+size_t Json_parseEvents(size_t buf_sz, const char *buffer, const Json_EventHandler *handler)
+{
+  if (!buffer || !buf_sz || !handler) return 0;
+
+  Json__EventCtx ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.handler = handler;
+
+  const size_t ret = Json__parseEvents(&ctx, buf_sz, buffer);
+  Json__release(NULL, ctx.scratch);
+  return ret;
+}
+
+// minimal worker pool: fn runs once on every thread (the caller included)
+// and is expected to pull its own work items until there are none left
+typedef struct {
+  void (*fn)(void *arg);
+  void *arg;
+
+#ifdef JSON__HAVE_THREADS
+  pthread_mutex_t lock;
+#endif
+  size_t next; // next unclaimed work item
+  size_t count;
+} Json__Pool;
+
+static
+size_t Json__cpuCount(void)
+{
+#if defined(JSON__HAVE_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0) return (size_t)n;
+#endif
+  return 1;
+}
+
+// claims up to batch items starting at *first, returns how many were claimed
+static
+size_t Json__poolClaim(Json__Pool *pool, size_t batch, size_t *first)
+{
+#ifdef JSON__HAVE_THREADS
+  pthread_mutex_lock(&pool->lock);
+#endif
+
+  *first = pool->next;
+  const size_t left = pool->count - pool->next;
+  const size_t n = (left < batch)? left : batch;
+  pool->next += n;
+
+#ifdef JSON__HAVE_THREADS
+  pthread_mutex_unlock(&pool->lock);
+#endif
+  return n;
+}
+
+// folds a worker's counters into the shared ones, timing is left to the caller
+static
+void Json__poolStats(Json__Pool *pool, Json_Stats *into, const Json_Stats *from)
+{
+  if (!into) return;
+
+#ifdef JSON__HAVE_THREADS
+  pthread_mutex_lock(&pool->lock);
+#else
+  (void)pool;
+#endif
+
+  into->allocs += from->allocs;
+  into->bytes += from->bytes;
+  into->live_bytes += from->live_bytes;
+  into->peak_bytes += from->peak_bytes;
+  into->nodes += from->nodes;
+
+#ifdef JSON__HAVE_THREADS
+  pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+#ifdef JSON__HAVE_THREADS
+static
+void *Json__poolMain(void *arg)
+{
+  Json__Pool *pool = (Json__Pool *)arg;
+  pool->fn(pool->arg);
+  return NULL;
+}
+#endif
+
+static
+void Json__poolRun(Json__Pool *pool, size_t nthreads)
+{
+  if (!nthreads) nthreads = Json__cpuCount();
+
+#ifdef JSON__HAVE_THREADS
+  pthread_mutex_init(&pool->lock, NULL);
+
+  // the caller is a worker too, and if spawning fails the ones
+  // that did start (or just the caller) pick up the slack
+  pthread_t *threads = NULL;
+  size_t spawned = 0;
+  if (nthreads > 1) threads = (pthread_t *)Json__alloc(NULL, sizeof(pthread_t) * (nthreads - 1));
+  if (threads) {
+    while (spawned < nthreads - 1 && !pthread_create(&threads[spawned], NULL, Json__poolMain, pool)) {
+      ++spawned;
+    }
+  }
+
+  pool->fn(pool->arg);
+
+  for (size_t i = 0; i < spawned; ++i) pthread_join(threads[i], NULL);
+  Json__release(NULL, threads);
+  pthread_mutex_destroy(&pool->lock);
+#else
+  (void)nthreads;
+  pool->fn(pool->arg);
+#endif
+}
+
+typedef struct {
+  Json__Pool pool;
+  const Json_LinesOptions *opts;
+  Json__ParseCtx ctx;
+  const char *buffer;
+  const size_t *lines; // start and end offset of every record
+  Json_Value *records;
+} Json__LinesJob;
+
+static
+void Json__linesRecord(Json__LinesJob *job, Json__ParseCtx *ctx, size_t i)
+{
+  const size_t start = job->lines[2 * i], len = job->lines[2 * i + 1] - start;
+  Json_Value record;
+
+  Json_Boolean ok = Json__parseValue(ctx, len, &job->buffer[start], &record) == len;
+  if (!ok) {
+    Json_destroyValueWith(&record, ctx->allocator);
+    memset(&record, 0, sizeof(record));
+  }
+
+  if (job->opts->on_record) job->opts->on_record(job->opts->user, i, &record, ok);
+  else job->records[i] = record;
+}
+
+static
+void Json__linesWorker(void *arg)
+{
+  Json__LinesJob *job = (Json__LinesJob *)arg;
+  Json__ParseCtx ctx = job->ctx;
+  Json_Stats stats;
+  memset(&stats, 0, sizeof(stats));
+  if (ctx.stats) ctx.stats = &stats;
+  size_t first, n;
+
+  while ((n = Json__poolClaim(&job->pool, 256, &first))) {
+    for (size_t i = first; i < first + n; ++i) Json__linesRecord(job, &ctx, i);
+  }
+
+  Json__parseDone(&ctx);
+  Json__poolStats(&job->pool, job->ctx.stats, &stats);
+}
+
+size_t Json_parseLines(size_t buf_sz, const char *buffer, Json_Value *out, const Json_LinesOptions *opts)
+{
+  static const Json_LinesOptions defaults = {0, {NULL, 0, NULL, NULL, NULL}, NULL, NULL};
+  if (!opts) opts = &defaults;
+  if (!buffer || (!out && !opts->on_record)) return 0;
+  if (out) {
+    memset(out, 0, sizeof(*out));
+    out->type = JSON_TYPE_ARRAY;
+  }
+
+  // finding the record boundaries is a cheap sequential pass,
+  // doing it up front lets records be parsed in any order
+  const Json_Allocator *allocator = opts->parse.allocator;
+  const double start = (opts->parse.stats)? Json__now() : 0.0;
+  size_t count = 0, cap = 0;
+  size_t *lines = NULL;
+  for (size_t i = 0; i < buf_sz;) {
+    const char *nl = (const char *)memchr(&buffer[i], '\n', buf_sz - i);
+    const size_t end = (nl)? (size_t)(nl - buffer) : buf_sz;
+
+    if (Json__skipSpace(end, buffer, i) < end) {
+      if (count == cap) {
+        cap = (cap)? 2 * cap : 1024;
+        size_t *grown = (size_t *)Json__resize(allocator, lines, sizeof(size_t) * 2 * cap);
+        if (!grown) {
+          Json__release(allocator, lines);
+          return 0;
+        }
+        lines = grown;
+      }
+
+      lines[2 * count] = i;
+      lines[2 * count + 1] = end;
+      ++count;
+    }
+
+    i = end + 1;
+  }
+
+  Json__LinesJob job;
+  memset(&job, 0, sizeof(job));
+  job.pool.fn = Json__linesWorker;
+  job.pool.arg = &job;
+  job.pool.count = count;
+  job.opts = opts;
+  Json__parseInit(&job.ctx, &opts->parse);
+  job.ctx.arena = NULL;
+  job.buffer = buffer;
+  job.lines = lines;
+
+  if (!opts->on_record && count) {
+    job.records = (Json_Value *)Json__storageAlloc(&job.ctx, sizeof(Json_Value) * count);
+    if (!job.records) {
+      Json__release(allocator, lines);
+      return 0;
+    }
+  }
+
+  // the key pool can't grow while the workers read it, so the first record
+  // (which usually has every key the others have) fills it beforehand
+  if (job.ctx.keys && count) {
+    Json__linesRecord(&job, &job.ctx, 0);
+    Json__parseDone(&job.ctx);
+    job.pool.next = 1;
+    job.ctx.flags |= JSON__PARSE_KEYS_FIXED;
+  }
+
+  Json__poolRun(&job.pool, opts->nthreads);
+  Json__release(allocator, lines);
+  if (job.ctx.stats) job.ctx.stats->seconds += Json__now() - start;
+
+  if (job.records) {
+    out->v.as_array.elems = job.records;
+    out->v.as_array.len = out->v.as_array.cap = count;
+  }
+
+  return count;
+}
+
+// one array element waiting to be parsed into its slot
+typedef struct {
+  Json_Value *slot;
+  const char *start;
+  size_t len;
+  Json_Boolean ok;
+} Json__SplitTask;
+
+typedef struct {
+  Json__Pool pool;
+  Json__ParseCtx ctx;
+
+  size_t ntasks;
+  size_t tasks_cap;
+  Json__SplitTask *tasks;
+
+  // values replaced by duplicate keys, which may still have tasks pointing
+  // into them, are only destroyed once the workers are done
+  size_t ndead;
+  size_t dead_cap;
+  Json_Value *dead;
+
+  // the '[' of the array being scanned, and where its current element starts
+  const char *base;
+  size_t last;
+} Json__SplitJob;
+
+static
+Json_Boolean Json__splitPush(Json__SplitJob *job, const char *start, size_t len)
+{
+  if (job->ntasks == job->tasks_cap) {
+    const size_t cap = (job->tasks_cap)? 2 * job->tasks_cap : 1024;
+    Json__SplitTask *tasks = (Json__SplitTask *)Json__resize(
+      job->ctx.allocator, job->tasks, sizeof(Json__SplitTask) * cap
+    );
+    if (!tasks) return JSON_FALSE;
+
+    job->tasks = tasks;
+    job->tasks_cap = cap;
+  }
+
+  Json__SplitTask *task = &job->tasks[job->ntasks++];
+  task->slot = NULL;
+  task->start = start;
+  task->len = len;
+  task->ok = JSON_FALSE;
+  return JSON_TRUE;
+}
+
+static
+Json_Boolean Json__splitComma(void *user, size_t pos)
+{
+  Json__SplitJob *job = (Json__SplitJob *)user;
+
+  if (!Json__splitPush(job, &job->base[job->last], pos - job->last)) return JSON_FALSE;
+  job->last = pos + 1;
+  return JSON_TRUE;
+}
+
+static
+Json_Boolean Json__splitBury(Json__SplitJob *job, const Json_Value *value)
+{
+  if (job->ndead == job->dead_cap) {
+    const size_t cap = (job->dead_cap)? 2 * job->dead_cap : 16;
+    Json_Value *dead = (Json_Value *)Json__resize(job->ctx.allocator, job->dead, sizeof(Json_Value) * cap);
+    if (!dead) return JSON_FALSE;
+
+    job->dead = dead;
+    job->dead_cap = cap;
+  }
+
+  job->dead[job->ndead++] = *value;
+  return JSON_TRUE;
+}
+
+// parses the containers above the split depth and turns the arrays at it
+// into tasks; on failure out is destroyed
+static
+size_t Json__splitValue(Json__SplitJob *job, size_t depth, size_t buf_sz, const char *buffer, Json_Value *out)
+{
+  memset(out, 0, sizeof(*out));
+
+  size_t ret = Json__skipSpace(buf_sz, buffer, 0);
+  if (ret >= buf_sz) return 0;
+
+  if (buffer[ret] == '[' && !depth) {
+    if (job->ctx.stats) ++job->ctx.stats->nodes;
+    out->type = JSON_TYPE_ARRAY;
+
+    const size_t open = ret;
+    ret = Json__skipSpace(buf_sz, buffer, ret + 1);
+    if (ret < buf_sz && buffer[ret] == ']') return Json__skipSpace(buf_sz, buffer, ret + 1);
+
+    // every element runs up to the next top-level comma (or the closing
+    // bracket) and is only validated when it is parsed
+    const size_t first = job->ntasks;
+    job->base = &buffer[open];
+    job->last = 1;
+
+    const size_t end = Json__scanContainer(buf_sz - open, job->base, Json__splitComma, job);
+    if (open + end >= buf_sz || buffer[open + end] != ']') return 0;
+    if (!Json__splitPush(job, &job->base[job->last], end - job->last)) return 0;
+    ret = open + end;
+
+    // the element storage never moves again, so the tasks can point into it
+    const size_t count = job->ntasks - first;
+    Json_Value *elems = (Json_Value *)Json__storageAlloc(&job->ctx, sizeof(Json_Value) * count);
+    if (!elems) return 0;
+    memset(elems, 0, sizeof(Json_Value) * count);
+
+    for (size_t i = 0; i < count; ++i) job->tasks[first + i].slot = &elems[i];
+    out->v.as_array.elems = elems;
+    out->v.as_array.len = out->v.as_array.cap = count;
+    return Json__skipSpace(buf_sz, buffer, ret + 1);
+  }
+
+  if (buffer[ret] == '[' && depth) {
+    if (job->ctx.stats) ++job->ctx.stats->nodes;
+    out->type = JSON_TYPE_ARRAY;
+
+    ret = Json__skipSpace(buf_sz, buffer, ret + 1);
+    if (ret < buf_sz && buffer[ret] == ']') return Json__skipSpace(buf_sz, buffer, ret + 1);
+
+    for (;;) {
+      Json_Value elem;
+      const size_t n = Json__splitValue(job, depth - 1, buf_sz - ret, &buffer[ret], &elem);
+      if (!n) break;
+
+      ret += n;
+      if (!Json__parseAppend(&job->ctx, &out->v.as_array, &elem)) {
+        Json_destroyValueWith(&elem, job->ctx.allocator);
+        break;
+      }
+
+      if (ret < buf_sz && buffer[ret] == ',') {
+        ++ret;
+        continue;
+      }
+
+      if (ret < buf_sz && buffer[ret] == ']') return Json__skipSpace(buf_sz, buffer, ret + 1);
+      break;
+    }
+
+    Json_destroyValueWith(out, job->ctx.allocator);
+    memset(out, 0, sizeof(*out));
+    return 0;
+  }
+
+  if (buffer[ret] == '{' && depth) {
+    if (job->ctx.stats) ++job->ctx.stats->nodes;
+    out->type = JSON_TYPE_OBJECT;
+
+    ret = Json__skipSpace(buf_sz, buffer, ret + 1);
+    if (ret < buf_sz && buffer[ret] == '}') return Json__skipSpace(buf_sz, buffer, ret + 1);
+
+    while (ret < buf_sz && buffer[ret] == '"') {
+      Json_String name;
+      ret += Json__parseKey(&job->ctx, buf_sz - ret, &buffer[ret], &name);
+      ret = Json__skipSpace(buf_sz, buffer, ret);
+
+      size_t n = 0;
+      Json_Value val;
+      if (ret < buf_sz && buffer[ret] == ':') {
+        n = Json__splitValue(job, depth - 1, buf_sz - ret - 1, &buffer[ret + 1], &val);
+      }
+
+      if (!n) {
+        if (name.is_heap) Json__release(job->ctx.allocator, name.data);
+        break;
+      }
+
+      ret += n + 1;
+
+      Json_Object *object = &out->v.as_object;
+      const size_t i = Json__objectFind(object, name);
+      if (i < object->len) {
+        if (name.is_heap) Json__release(job->ctx.allocator, name.data);
+        if (!Json__splitBury(job, &object->field_values[i])) {
+          Json_destroyValueWith(&val, job->ctx.allocator);
+          break;
+        }
+
+        object->field_values[i] = val;
+      } else if (!Json__parseSet(&job->ctx, object, name, &val)) {
+        if (name.is_heap) Json__release(job->ctx.allocator, name.data);
+        Json_destroyValueWith(&val, job->ctx.allocator);
+        break;
+      }
+
+      if (ret < buf_sz && buffer[ret] == ',') {
+        ret = Json__skipSpace(buf_sz, buffer, ret + 1);
+        continue;
+      }
+
+      if (ret < buf_sz && buffer[ret] == '}') return Json__skipSpace(buf_sz, buffer, ret + 1);
+      break;
+    }
+
+    Json_destroyValueWith(out, job->ctx.allocator);
+    memset(out, 0, sizeof(*out));
+    return 0;
+  }
+
+  // scalars, and objects at the split depth
+  return Json__parseValue(&job->ctx, buf_sz, buffer, out);
+}
+
+static
+void Json__splitTask(Json__ParseCtx *ctx, Json__SplitTask *task)
+{
+  const size_t len = Json__parseValue(ctx, task->len, task->start, task->slot);
+  task->ok = len && len == task->len;
+}
+
+static
+void Json__splitWorker(void *arg)
+{
+  Json__SplitJob *job = (Json__SplitJob *)arg;
+  Json__ParseCtx ctx = job->ctx;
+  Json_Stats stats;
+  memset(&stats, 0, sizeof(stats));
+  if (ctx.stats) ctx.stats = &stats;
+  size_t first, n;
+
+  while ((n = Json__poolClaim(&job->pool, 64, &first))) {
+    for (size_t i = first; i < first + n; ++i) Json__splitTask(&ctx, &job->tasks[i]);
+  }
+
+  Json__parseDone(&ctx);
+  Json__poolStats(&job->pool, job->ctx.stats, &stats);
+}
+
+size_t Json_parseStrParallel(size_t buf_sz, const char *buffer, Json_Value *out, const Json_ParallelOptions *opts)
+{
+  static const Json_ParallelOptions defaults = {0, {NULL, 0, NULL, NULL, NULL}, 0};
+  if (!opts) opts = &defaults;
+  if (!out) return 0;
+  memset(out, 0, sizeof(*out));
+  if (!buffer) return 0;
+
+  Json__SplitJob job;
+  memset(&job, 0, sizeof(job));
+  Json__parseInit(&job.ctx, &opts->parse);
+  job.ctx.arena = NULL;
+  const double start = (job.ctx.stats)? Json__now() : 0.0;
+
+  size_t ret = Json__splitValue(&job, opts->depth, buf_sz, buffer, out);
+
+  // every worker starts from a copy of job.ctx and needs its own stack
+  Json__parseDone(&job.ctx);
+
+  if (ret && job.ntasks) {
+    job.pool.fn = Json__splitWorker;
+    job.pool.arg = &job;
+    job.pool.count = job.ntasks;
+
+    // the key pool can't grow while the workers read it, the first element
+    // fills it with what is likely every element's keys
+    if (job.ctx.keys) {
+      Json__splitTask(&job.ctx, &job.tasks[0]);
+      Json__parseDone(&job.ctx);
+      job.pool.next = 1;
+      job.ctx.flags |= JSON__PARSE_KEYS_FIXED;
+    }
+
+    // no point in waking up threads that won't get a batch
+    size_t nthreads = (opts->nthreads)? opts->nthreads : Json__cpuCount();
+    if (nthreads > (job.ntasks + 63) / 64) nthreads = (job.ntasks + 63) / 64;
+    Json__poolRun(&job.pool, nthreads);
+
+    for (size_t i = 0; i < job.ntasks; ++i) {
+      if (!job.tasks[i].ok) ret = 0;
+    }
+  }
+
+  for (size_t i = 0; i < job.ndead; ++i) Json_destroyValueWith(&job.dead[i], job.ctx.allocator);
+  Json__release(job.ctx.allocator, job.dead);
+  Json__release(job.ctx.allocator, job.tasks);
+
+  if (!ret) {
+    Json_destroyValueWith(out, job.ctx.allocator);
+    memset(out, 0, sizeof(*out));
+  }
+
+  if (job.ctx.stats) job.ctx.stats->seconds += Json__now() - start;
+  return ret;
+}
+
+Json_Boolean Json_cursorInit(Json_Cursor *out, size_t buf_sz, const char *buffer)
+{
+  if (!out) return JSON_FALSE;
+
+  out->buffer = buffer;
+  out->buf_sz = (buffer)? buf_sz : 0;
+  out->pos = Json__skipSpace(out->buf_sz, buffer, 0);
+  return out->pos < out->buf_sz;
+}
+
+Json_Type Json_cursorType(const Json_Cursor *cur)
+{
+  if (!cur || cur->pos >= cur->buf_sz) return JSON_TYPE_NULL;
+
+  const char c = cur->buffer[cur->pos];
+  switch (c) {
+    case '"': return JSON_TYPE_STRING;
+    case '[': return JSON_TYPE_ARRAY;
+    case '{': return JSON_TYPE_OBJECT;
+    case 't':
+    case 'f': return JSON_TYPE_BOOLEAN;
+    default: break;
+  }
+
+  if (c == '-' || isdigit((unsigned char)c)) {
+    Json_Value tmp;
+    if (Json__parseNumber(cur->buf_sz - cur->pos, &cur->buffer[cur->pos], &tmp)) return tmp.type;
+  }
+
+  return JSON_TYPE_NULL;
+}
+
+Json_Boolean Json_cursorIter(const Json_Cursor *container, Json_CursorIter *out)
+{
+  if (!container || !out || container->pos >= container->buf_sz) return JSON_FALSE;
+
+  const char c = container->buffer[container->pos];
+  if (c != '[' && c != '{') return JSON_FALSE;
+
+  out->at = *container;
+  ++out->at.pos;
+  out->close = (c == '[')? ']' : '}';
+  out->started = JSON_FALSE;
+  return JSON_TRUE;
+}
+
+// finds the next member, leaving the key's closing quote in *key_end;
+// values are skipped without being looked at any closer
+static
+Json_Boolean Json__cursorMember(
+  Json_CursorIter *iter,
+  size_t *key,
+  size_t *key_end,
+  Json_Boolean *key_escapes,
+  Json_Cursor *value
+)
+{
+  const char *buffer = iter->at.buffer;
+  const size_t buf_sz = iter->at.buf_sz;
+
+  size_t pos = Json__skipSpace(buf_sz, buffer, iter->at.pos);
+  if (pos >= buf_sz || buffer[pos] == iter->close) return JSON_FALSE;
+
+  if (iter->started) {
+    if (buffer[pos] != ',') return JSON_FALSE;
+    pos = Json__skipSpace(buf_sz, buffer, pos + 1);
+  }
+
+  *key = pos;
+  if (iter->close == '}') {
+    if (pos >= buf_sz || buffer[pos] != '"') return JSON_FALSE;
+
+    *key_escapes = JSON_FALSE;
+    *key_end = pos + Json__scanString(buf_sz - pos, &buffer[pos], key_escapes);
+    if (*key_end >= buf_sz) return JSON_FALSE;
+
+    pos = Json__skipSpace(buf_sz, buffer, *key_end + 1);
+    if (pos >= buf_sz || buffer[pos] != ':') return JSON_FALSE;
+    pos = Json__skipSpace(buf_sz, buffer, pos + 1);
+  }
+
+  const size_t n = Json__skipValue(buf_sz - pos, &buffer[pos]);
+  if (!n) return JSON_FALSE;
+
+  value->buffer = buffer;
+  value->buf_sz = buf_sz;
+  value->pos = pos;
+
+  iter->at.pos = pos + n;
+  iter->started = JSON_TRUE;
+  return JSON_TRUE;
+}
+
+Json_Boolean Json_cursorNext(Json_CursorIter *iter, Json_Cursor *key, Json_Cursor *value)
+{
+  if (!iter || !value) return JSON_FALSE;
+
+  size_t key_pos, key_end;
+  Json_Boolean key_escapes;
+  if (!Json__cursorMember(iter, &key_pos, &key_end, &key_escapes, value)) return JSON_FALSE;
+
+  if (key && iter->close == '}') {
+    *key = iter->at;
+    key->pos = key_pos;
+  }
+
+  return JSON_TRUE;
+}
+
+// whether the name whose quotes are at buffer[key] and buffer[key_end] is field
+static
+Json_Boolean Json__cursorKeyIs(const char *buffer, size_t key, size_t key_end, Json_Boolean key_escapes, Json_String field)
+{
+  const size_t raw_len = key_end - key - 1;
+  const char *raw = &buffer[key + 1];
+  if (!key_escapes) return raw_len == field.len && !memcmp(raw, field.data, raw_len);
+
+  // an escaped name can't be longer than its raw text
+  if (raw_len < field.len) return JSON_FALSE;
+
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, NULL);
+  Json_String name;
+  if (!Json__makeString(&ctx, raw_len, raw, JSON_TRUE, &name)) return JSON_FALSE;
+  const Json_Boolean found = !Json_stringCmp(name, field);
+  if (name.is_heap) Json__release(NULL, name.data);
+  return found;
+}
+
+Json_Boolean Json_cursorGet(const Json_Cursor *object, Json_String field, Json_Cursor *out)
+{
+  if (!out || !field.data) return JSON_FALSE;
+
+  Json_CursorIter iter;
+  if (!Json_cursorIter(object, &iter) || iter.close != '}') return JSON_FALSE;
+
+  // keeps going past a match, the last duplicate wins
+  size_t key, key_end;
+  Json_Boolean key_escapes, found = JSON_FALSE;
+  Json_Cursor val;
+  while (Json__cursorMember(&iter, &key, &key_end, &key_escapes, &val)) {
+    if (!Json__cursorKeyIs(object->buffer, key, key_end, key_escapes, field)) continue;
+    *out = val;
+    found = JSON_TRUE;
+  }
+
+  return found;
+}
+
+Json_Boolean Json_cursorAt(const Json_Cursor *array, size_t idx, Json_Cursor *out)
+{
+  if (!out) return JSON_FALSE;
+
+  Json_CursorIter iter;
+  if (!Json_cursorIter(array, &iter) || iter.close != ']') return JSON_FALSE;
+
+  for (size_t i = 0; Json_cursorNext(&iter, NULL, out); ++i) {
+    if (i == idx) return JSON_TRUE;
+  }
+
+  return JSON_FALSE;
+}
+
+// decodes a scalar, or a one element array into elem, for the Json__value*
+// conversions; other containers come out empty
+static
+void Json__cursorDecode(const Json_Cursor *cur, Json_Value *out, Json__Single *elem)
+{
+  memset(out, 0, sizeof(*out));
+  if (!cur || cur->pos >= cur->buf_sz) return;
+
+  const char *buffer = &cur->buffer[cur->pos];
+  const size_t buf_sz = cur->buf_sz - cur->pos;
+  Json__ParseCtx ctx;
+  Json__parseInit(&ctx, NULL);
+  ctx.flags = JSON_PARSE_BORROW;
+
+  switch (buffer[0]) {
+    case '[': {
+      out->type = JSON_TYPE_ARRAY;
+
+      Json_CursorIter iter;
+      Json_Cursor first, second;
+      Json_cursorIter(cur, &iter);
+      if (!Json_cursorNext(&iter, NULL, &first) || Json_cursorNext(&iter, NULL, &second)) break;
+
+      const char c = first.buffer[first.pos];
+      if (c == '[' || c == '{') break;
+
+      Json__cursorDecode(&first, &elem->value, NULL);
+
+      memset(&elem->hdr, 0, sizeof(elem->hdr));
+      out->v.as_array.elems = &elem->value;
+      out->v.as_array.len = out->v.as_array.cap = 1;
+    } break;
+
+    case '{': out->type = JSON_TYPE_OBJECT; break;
+
+    case '"':
+      out->type = JSON_TYPE_STRING;
+      if (!Json__parseString(&ctx, buf_sz, buffer, &out->v.as_string)) memset(out, 0, sizeof(*out));
+      break;
+
+    default:
+      if (!Json__parseRoot(&ctx, buf_sz, buffer, out)) memset(out, 0, sizeof(*out));
+      break;
+  }
+}
+
+static
+void Json__cursorRelease(Json_Value *val, Json__Single *elem)
+{
+  if (val->type == JSON_TYPE_STRING && val->v.as_string.is_heap) Json__release(NULL, val->v.as_string.data);
+  if (val->type == JSON_TYPE_ARRAY && val->v.as_array.len) Json__cursorRelease(&elem->value, NULL);
+}
+
+Json_Boolean Json_cursorBool(const Json_Cursor *cur, Json_Boolean fallback)
+{
+  if (!cur || cur->pos >= cur->buf_sz) return fallback;
+
+  Json_Value val;
+  Json__Single elem;
+  Json__cursorDecode(cur, &val, &elem);
+  const Json_Boolean ret = Json__valueBool(&val, fallback);
+  Json__cursorRelease(&val, &elem);
+  return ret;
+}
+
+Json_Number Json_cursorNum(const Json_Cursor *cur, Json_Number fallback)
+{
+  if (!cur || cur->pos >= cur->buf_sz) return fallback;
+
+  Json_Value val;
+  Json__Single elem;
+  Json__cursorDecode(cur, &val, &elem);
+  const Json_Number ret = Json__valueNum(&val, fallback);
+  Json__cursorRelease(&val, &elem);
+  return ret;
+}
+
+Json_Integer Json_cursorInt(const Json_Cursor *cur, Json_Integer fallback)
+{
+  if (!cur || cur->pos >= cur->buf_sz) return fallback;
+
+  Json_Value val;
+  Json__Single elem;
+  Json__cursorDecode(cur, &val, &elem);
+  const Json_Integer ret = Json__valueInt(&val, fallback);
+  Json__cursorRelease(&val, &elem);
+  return ret;
+}
+
+Json_String Json_cursorStr(const Json_Cursor *cur, Json_String fallback)
+{
+  if (!cur || cur->pos >= cur->buf_sz) return fallback;
+
+  // the string (if any) is handed over to the caller
+  Json_Value val;
+  Json__Single elem;
+  Json__cursorDecode(cur, &val, &elem);
+  const Json_String ret = Json__valueStr(&val, fallback);
+
+  const Json_String *decoded = (val.type == JSON_TYPE_STRING)? &val.v.as_string :
+                               (val.type == JSON_TYPE_ARRAY && val.v.as_array.len && elem.value.type == JSON_TYPE_STRING)? &elem.value.v.as_string :
+                               NULL;
+  if (decoded && decoded->is_heap && decoded->data != ret.data) Json__release(NULL, decoded->data);
+  return ret;
+}
+
+Json_Boolean Json_cursorGetBool(const Json_Cursor *object, Json_String field, Json_Boolean fallback)
+{
+  Json_Cursor val;
+  return (Json_cursorGet(object, field, &val))? Json_cursorBool(&val, fallback) : fallback;
+}
+
+Json_Number Json_cursorGetNum(const Json_Cursor *object, Json_String field, Json_Number fallback)
+{
+  Json_Cursor val;
+  return (Json_cursorGet(object, field, &val))? Json_cursorNum(&val, fallback) : fallback;
+}
+
+Json_Integer Json_cursorGetInt(const Json_Cursor *object, Json_String field, Json_Integer fallback)
+{
+  Json_Cursor val;
+  return (Json_cursorGet(object, field, &val))? Json_cursorInt(&val, fallback) : fallback;
+}
+
+Json_String Json_cursorGetStr(const Json_Cursor *object, Json_String field, Json_String fallback)
+{
+  Json_Cursor val;
+  return (Json_cursorGet(object, field, &val))? Json_cursorStr(&val, fallback) : fallback;
+}
+
+size_t Json_cursorValue(const Json_Cursor *cur, Json_Value *out, const Json_ParseOptions *opts)
+{
+  if (!out) return 0;
+  memset(out, 0, sizeof(*out));
+  if (!cur || cur->pos >= cur->buf_sz) return 0;
+
+  const size_t n = Json__skipValue(cur->buf_sz - cur->pos, &cur->buffer[cur->pos]);
+  if (!n) return 0;
+  return Json_parseStrEx(n, &cur->buffer[cur->pos], out, opts);
+}
+
+Json_Boolean Json_queryCompile(Json_Query *out, Json_String pointer)
+{
+  if (!out) return JSON_FALSE;
+  memset(out, 0, sizeof(*out));
+
+  if (!pointer.len) return JSON_TRUE;
+  if (!pointer.data || pointer.data[0] != '/') return JSON_FALSE;
+
+  for (size_t i = 0; i < pointer.len; ++i) {
+    if (pointer.data[i] == '/') ++out->len;
+  }
+
+  // names only ever get shorter when decoded
+  out->segments = (Json_QuerySegment *)Json__alloc(NULL, sizeof(Json_QuerySegment) * out->len);
+  out->names = (char *)Json__alloc(NULL, pointer.len);
+  if (!out->segments || !out->names) {
+    Json_queryDestroy(out);
+    return JSON_FALSE;
+  }
+
+  size_t seg = 0, used = 0;
+  for (size_t i = 1; i <= pointer.len; ++seg, ++i) {
+    Json_QuerySegment *segment = &out->segments[seg];
+    segment->name.is_heap = JSON_FALSE;
+    segment->name.data = &out->names[used];
+    segment->name.len = 0;
+
+    for (; i < pointer.len && pointer.data[i] != '/'; ++i) {
+      char c = pointer.data[i];
+      if (c == '~') {
+        const char next = (i + 1 < pointer.len)? pointer.data[++i] : '\0';
+        if (next != '0' && next != '1') {
+          Json_queryDestroy(out);
+          return JSON_FALSE;
+        }
+
+        c = (next == '0')? '~' : '/';
+      }
+
+      segment->name.data[segment->name.len++] = c;
+    }
+    used += segment->name.len;
+
+    segment->wildcard = segment->name.len == 1 && segment->name.data[0] == '*';
+
+    // array indices are plain decimal without leading zeros
+    const size_t len = segment->name.len;
+    const char *name = segment->name.data;
+    segment->index = (size_t)-1;
+    if (len && len < 20 && (name[0] != '0' || len == 1)) {
+      size_t index = 0, k = 0;
+      while (k < len && isdigit((unsigned char)name[k])) index = 10 * index + (size_t)(name[k++] - '0');
+      if (k == len) segment->index = index;
+    }
+  }
+
+  return JSON_TRUE;
+}
+
+void Json_queryDestroy(Json_Query *query)
+{
+  if (!query) return;
+
+  Json__release(NULL, query->segments);
+  Json__release(NULL, query->names);
+  memset(query, 0, sizeof(*query));
+}
+
+typedef struct {
+  const Json_Query *query;
+  size_t count;
+  void *user;
+  int (*on_cursor)(void *user, const Json_Cursor *value);
+  int (*on_value)(void *user, Json_Value *value);
+} Json__QueryRun;
+
+static
+int Json__queryCursor(Json__QueryRun *run, size_t seg, const Json_Cursor *cur)
+{
+  if (seg == run->query->len) {
+    ++run->count;
+    return run->on_cursor(run->user, cur);
+  }
+
+  const Json_QuerySegment *segment = &run->query->segments[seg];
+  Json_CursorIter iter;
+  Json_Cursor val;
+  if (!Json_cursorIter(cur, &iter)) return JSON_EVENT_CONTINUE;
+
+  if (iter.close == '}') {
+    size_t key, key_end;
+    Json_Boolean key_escapes, found = JSON_FALSE;
+    Json_Cursor last;
+    while (Json__cursorMember(&iter, &key, &key_end, &key_escapes, &val)) {
+      if (segment->wildcard) {
+        if (Json__queryCursor(run, seg + 1, &val) == JSON_EVENT_STOP) return JSON_EVENT_STOP;
+      } else if (Json__cursorKeyIs(cur->buffer, key, key_end, key_escapes, segment->name)) {
+        last = val;
+        found = JSON_TRUE;
+      }
+    }
+
+    // the last duplicate wins, like Json_objectGet
+    if (found && Json__queryCursor(run, seg + 1, &last) == JSON_EVENT_STOP) return JSON_EVENT_STOP;
+    return JSON_EVENT_CONTINUE;
+  }
+
+  if (!segment->wildcard && segment->index == (size_t)-1) return JSON_EVENT_CONTINUE;
+  for (size_t i = 0; Json_cursorNext(&iter, NULL, &val); ++i) {
+    if (!segment->wildcard && i != segment->index) continue;
+    if (Json__queryCursor(run, seg + 1, &val) == JSON_EVENT_STOP) return JSON_EVENT_STOP;
+    if (!segment->wildcard) break;
+  }
+
+  return JSON_EVENT_CONTINUE;
+}
+
+size_t Json_queryRun(
+  const Json_Query *query,
+  size_t buf_sz,
+  const char *buffer,
+  int (*on_match)(void *user, const Json_Cursor *value),
+  void *user
+)
+{
+  Json_Cursor root;
+  if (!query || !on_match || !Json_cursorInit(&root, buf_sz, buffer)) return 0;
+
+  Json__QueryRun run;
+  memset(&run, 0, sizeof(run));
+  run.query = query;
+  run.user = user;
+  run.on_cursor = on_match;
+
+  Json__queryCursor(&run, 0, &root);
+  return run.count;
+}
+
+static
+int Json__queryValue(Json__QueryRun *run, size_t seg, Json_Value *value)
+{
+  if (seg == run->query->len) {
+    ++run->count;
+    return run->on_value(run->user, value);
+  }
+
+  const Json_QuerySegment *segment = &run->query->segments[seg];
+  if (value->type == JSON_TYPE_OBJECT) {
+    if (!segment->wildcard) {
+      Json_Value *field = Json_objectGet(value, segment->name);
+      return (field)? Json__queryValue(run, seg + 1, field) : JSON_EVENT_CONTINUE;
+    }
+
+    for (size_t i = 0; i < value->v.as_object.len; ++i) {
+      if (Json__queryValue(run, seg + 1, &value->v.as_object.field_values[i]) == JSON_EVENT_STOP) return JSON_EVENT_STOP;
+    }
+  } else if (value->type == JSON_TYPE_ARRAY) {
+    if (!segment->wildcard) {
+      if (segment->index >= value->v.as_array.len) return JSON_EVENT_CONTINUE;
+      return Json__queryValue(run, seg + 1, &value->v.as_array.elems[segment->index]);
+    }
+
+    for (size_t i = 0; i < value->v.as_array.len; ++i) {
+      if (Json__queryValue(run, seg + 1, &value->v.as_array.elems[i]) == JSON_EVENT_STOP) return JSON_EVENT_STOP;
+    }
+  }
+
+  return JSON_EVENT_CONTINUE;
+}
+
+size_t Json_queryValue(
+  const Json_Query *query,
+  Json_Value *root,
+  int (*on_match)(void *user, Json_Value *value),
+  void *user
+)
+{
+  if (!query || !root || !on_match) return 0;
+
+  Json__QueryRun run;
+  memset(&run, 0, sizeof(run));
+  run.query = query;
+  run.user = user;
+  run.on_value = on_match;
+
+  Json__queryValue(&run, 0, root);
+  return run.count;
+}
+
+#define JSON__TAPE_TAG(word)     ((char)((word) >> 56))
+#define JSON__TAPE_PAYLOAD(word) ((word) & 0x00ffffffffffffffull)
+#define JSON__TAPE_WORD(tag, payload) \
+  (((unsigned long long)(unsigned char)(tag) << 56) | (unsigned long long)(payload))
+
+typedef struct {
+  Json_Tape *tape;
+  Json_Boolean failed;
+
+  // the containers still open, by the index of their first word
+  size_t depth;
+  size_t stack_cap;
+  size_t *stack;
+} Json__TapeBuilder;
+
+static
+Json_Boolean Json__tapePush(Json__TapeBuilder *b, unsigned long long word)
+{
+  Json_Tape *tape = b->tape;
+  if (tape->len == tape->cap) {
+    const size_t cap = (tape->cap)? 2 * tape->cap : 1024;
+    unsigned long long *words = (unsigned long long *)Json__resize(NULL, tape->words, sizeof(unsigned long long) * cap);
+    if (!words) {
+      b->failed = JSON_TRUE;
+      return JSON_FALSE;
+    }
+
+    tape->words = words;
+    tape->cap = cap;
+  }
+
+  tape->words[tape->len++] = word;
+  return JSON_TRUE;
+}
+
+// every value (or field name) counts towards its container
+static
+int Json__tapeChild(Json__TapeBuilder *b, char tag, unsigned long long payload)
+{
+  if (b->depth) {
+    Json_Tape *tape = b->tape;
+    const size_t open = b->stack[b->depth - 1];
+    if (JSON__TAPE_TAG(tape->words[open]) == '[' || tag == '"') ++tape->words[open + 1];
+  }
+
+  return (Json__tapePush(b, JSON__TAPE_WORD(tag, payload)))? JSON_EVENT_CONTINUE : JSON_EVENT_STOP;
+}
+
+static
+int Json__tapeAddString(Json__TapeBuilder *b, Json_String str, Json_Boolean is_key)
+{
+  Json_Tape *tape = b->tape;
+  const unsigned long long len = str.len;
+  const size_t need = sizeof(len) + str.len + 1;
+
+  if (tape->strings_cap - tape->strings_len < need) {
+    size_t cap = (tape->strings_cap)? tape->strings_cap : 4096;
+    while (cap - tape->strings_len < need) cap *= 2;
+
+    char *strings = (char *)Json__resize(NULL, tape->strings, cap);
+    if (!strings) {
+      b->failed = JSON_TRUE;
+      return JSON_EVENT_STOP;
+    }
+
+    tape->strings = strings;
+    tape->strings_cap = cap;
+  }
+
+  const size_t offset = tape->strings_len;
+  memcpy(&tape->strings[offset], &len, sizeof(len));
+  if (str.len) memcpy(&tape->strings[offset + sizeof(len)], str.data, str.len);
+  tape->strings[offset + sizeof(len) + str.len] = '\0';
+  tape->strings_len += need;
+
+  // names are counted as the field, so values in objects aren't
+  if (!is_key && b->depth && JSON__TAPE_TAG(tape->words[b->stack[b->depth - 1]]) == '{') {
+    return (Json__tapePush(b, JSON__TAPE_WORD('"', offset)))? JSON_EVENT_CONTINUE : JSON_EVENT_STOP;
+  }
+
+  return Json__tapeChild(b, '"', offset);
+}
+
+static
+int Json__tapeOpen(Json__TapeBuilder *b, char tag)
+{
+  if (b->depth == b->stack_cap) {
+    const size_t cap = (b->stack_cap)? 2 * b->stack_cap : 32;
+    size_t *stack = (size_t *)Json__resize(NULL, b->stack, sizeof(size_t) * cap);
+    if (!stack) {
+      b->failed = JSON_TRUE;
+      return JSON_EVENT_STOP;
+    }
+
+    b->stack = stack;
+    b->stack_cap = cap;
+  }
+
+  const size_t open = b->tape->len;
+  const int ret = (b->depth && JSON__TAPE_TAG(b->tape->words[b->stack[b->depth - 1]]) == '{')?
+                  ((Json__tapePush(b, JSON__TAPE_WORD(tag, 0)))? JSON_EVENT_CONTINUE : JSON_EVENT_STOP) :
+                  Json__tapeChild(b, tag, 0);
+  if (ret != JSON_EVENT_CONTINUE || !Json__tapePush(b, 0)) return JSON_EVENT_STOP;
+
+  b->stack[b->depth++] = open;
+  return JSON_EVENT_CONTINUE;
+}
+
+static
+int Json__tapeClose(Json__TapeBuilder *b)
+{
+  const size_t open = b->stack[--b->depth];
+  b->tape->words[open] |= b->tape->len;
+  return JSON_EVENT_CONTINUE;
+}
+
+// scalars inside objects are the value of a field that was already counted
+static
+int Json__tapeScalar(Json__TapeBuilder *b, char tag, unsigned long long payload)
+{
+  if (b->depth && JSON__TAPE_TAG(b->tape->words[b->stack[b->depth - 1]]) == '{') {
+    return (Json__tapePush(b, JSON__TAPE_WORD(tag, payload)))? JSON_EVENT_CONTINUE : JSON_EVENT_STOP;
+  }
+
+  return Json__tapeChild(b, tag, payload);
+}
+
+static int Json__tapeStartObject(void *user) { return Json__tapeOpen((Json__TapeBuilder *)user, '{'); }
+static int Json__tapeStartArray(void *user)  { return Json__tapeOpen((Json__TapeBuilder *)user, '['); }
+static int Json__tapeEnd(void *user)         { return Json__tapeClose((Json__TapeBuilder *)user); }
+static int Json__tapeNull(void *user)        { return Json__tapeScalar((Json__TapeBuilder *)user, 'n', 0); }
+
+static
+int Json__tapeBoolean(void *user, Json_Boolean val)
+{
+  return Json__tapeScalar((Json__TapeBuilder *)user, (val)? 't' : 'f', 0);
+}
+
+static
+int Json__tapeKey(void *user, Json_String key)
+{
+  return Json__tapeAddString((Json__TapeBuilder *)user, key, JSON_TRUE);
+}
+
+static
+int Json__tapeStr(void *user, Json_String val)
+{
+  return Json__tapeAddString((Json__TapeBuilder *)user, val, JSON_FALSE);
+}
+
+static
+int Json__tapeNumber(void *user, Json_Number val)
+{
+  Json__TapeBuilder *b = (Json__TapeBuilder *)user;
+  unsigned long long bits;
+  memcpy(&bits, &val, sizeof(bits));
+
+  const int ret = Json__tapeScalar(b, 'd', 0);
+  return (ret == JSON_EVENT_CONTINUE && Json__tapePush(b, bits))? JSON_EVENT_CONTINUE : JSON_EVENT_STOP;
+}
+
+static
+int Json__tapeInteger(void *user, Json_Integer val)
+{
+  Json__TapeBuilder *b = (Json__TapeBuilder *)user;
+
+  const int ret = Json__tapeScalar(b, 'l', 0);
+  return (ret == JSON_EVENT_CONTINUE && Json__tapePush(b, (unsigned long long)val))? JSON_EVENT_CONTINUE : JSON_EVENT_STOP;
+}
+
+// frees the builder, and either the tape if building it failed
+// or whatever room it has left over
+static
+Json_Boolean Json__tapeFinish(Json__TapeBuilder *b, Json_Boolean ok)
+{
+  Json_Tape *out = b->tape;
+  Json__release(NULL, b->stack);
+
+  if (!ok || b->failed || b->depth || !out->len) {
+    Json_destroyTape(out);
+    return JSON_FALSE;
+  }
+
+  // the tape is never written again, so it gives back what it didn't use
+  unsigned long long *words = (unsigned long long *)Json__resize(NULL, out->words, sizeof(unsigned long long) * out->len);
+  if (words) {
+    out->words = words;
+    out->cap = out->len;
+  }
+
+  if (out->strings_len) {
+    char *strings = (char *)Json__resize(NULL, out->strings, out->strings_len);
+    if (strings) {
+      out->strings = strings;
+      out->strings_cap = out->strings_len;
+    }
+  }
+
+  return JSON_TRUE;
+}
+
+size_t Json_parseTape(size_t buf_sz, const char *buffer, Json_Tape *out)
+{
+  if (!out) return 0;
+  memset(out, 0, sizeof(*out));
+
+  Json__TapeBuilder b;
+  memset(&b, 0, sizeof(b));
+  b.tape = out;
+
+  Json_EventHandler handler;
+  memset(&handler, 0, sizeof(handler));
+  handler.user = &b;
+  handler.start_object = Json__tapeStartObject;
+  handler.end_object = Json__tapeEnd;
+  handler.start_array = Json__tapeStartArray;
+  handler.end_array = Json__tapeEnd;
+  handler.key = Json__tapeKey;
+  handler.string = Json__tapeStr;
+  handler.number = Json__tapeNumber;
+  handler.boolean = Json__tapeBoolean;
+  handler.null = Json__tapeNull;
+  handler.integer = Json__tapeInteger;
+
+  const size_t ret = Json_parseEvents(buf_sz, buffer, &handler);
+  return (Json__tapeFinish(&b, ret != 0))? ret : 0;
+}
+
+static
+int Json__tapeValue(Json__TapeBuilder *b, const Json_Value *value)
+{
+  switch (value->type) {
+    case JSON_TYPE_NULL: return Json__tapeNull(b);
+    case JSON_TYPE_BOOLEAN: return Json__tapeBoolean(b, value->v.as_boolean);
+    case JSON_TYPE_NUMBER: return Json__tapeNumber(b, value->v.as_number);
+    case JSON_TYPE_INTEGER: return Json__tapeInteger(b, value->v.as_integer);
+    case JSON_TYPE_STRING: return Json__tapeStr(b, value->v.as_string);
+
+    case JSON_TYPE_ARRAY:
+      if (Json__tapeOpen(b, '[') != JSON_EVENT_CONTINUE) return JSON_EVENT_STOP;
+      for (size_t i = 0; i < value->v.as_array.len; ++i) {
+        if (Json__tapeValue(b, &value->v.as_array.elems[i]) != JSON_EVENT_CONTINUE) return JSON_EVENT_STOP;
+      }
+      return Json__tapeClose(b);
+
+    case JSON_TYPE_OBJECT:
+      if (Json__tapeOpen(b, '{') != JSON_EVENT_CONTINUE) return JSON_EVENT_STOP;
+      for (size_t i = 0; i < value->v.as_object.len; ++i) {
+        if (Json__tapeKey(b, value->v.as_object.field_names[i]) != JSON_EVENT_CONTINUE) return JSON_EVENT_STOP;
+        if (Json__tapeValue(b, &value->v.as_object.field_values[i]) != JSON_EVENT_CONTINUE) return JSON_EVENT_STOP;
+      }
+      return Json__tapeClose(b);
+  }
+
+  return JSON_EVENT_STOP;
+}
+
+Json_Boolean Json_tapeFromValue(const Json_Value *value, Json_Tape *out)
+{
+  if (!out) return JSON_FALSE;
+  memset(out, 0, sizeof(*out));
+  if (!value) return JSON_FALSE;
+
+  Json__TapeBuilder b;
+  memset(&b, 0, sizeof(b));
+  b.tape = out;
+
+  return Json__tapeFinish(&b, Json__tapeValue(&b, value) == JSON_EVENT_CONTINUE);
+}
+
+void Json_destroyTape(Json_Tape *tape)
+{
+  if (!tape) return;
+
+  Json__release(NULL, tape->words);
+  Json__release(NULL, tape->strings);
+  memset(tape, 0, sizeof(*tape));
+}
+
+// header words: magic, version (which also catches the other byte order),
+// word count and string bytes
+#define JSON__BINARY_MAGIC   "jsontape"
+#define JSON__BINARY_VERSION 1ull
+#define JSON__BINARY_HDR     (4 * sizeof(unsigned long long))
+
+Json_Boolean Json_saveTape(FILE *file, const Json_Tape *tape)
+{
+  if (!file || !tape || !tape->len) return JSON_FALSE;
+
+  unsigned long long hdr[4];
+  memcpy(&hdr[0], JSON__BINARY_MAGIC, sizeof(hdr[0]));
+  hdr[1] = JSON__BINARY_VERSION;
+  hdr[2] = tape->len;
+  hdr[3] = tape->strings_len;
+
+  if (fwrite(hdr, sizeof(hdr), 1, file) != 1) return JSON_FALSE;
+  if (fwrite(tape->words, sizeof(unsigned long long), tape->len, file) != tape->len) return JSON_FALSE;
+  if (tape->strings_len && fwrite(tape->strings, 1, tape->strings_len, file) != tape->strings_len) return JSON_FALSE;
+  return !fflush(file);
+}
+
+Json_Boolean Json_saveBinary(FILE *file, const Json_Value *value)
+{
+  Json_Tape tape;
+  if (!file || !Json_tapeFromValue(value, &tape)) return JSON_FALSE;
+
+  const Json_Boolean ok = Json_saveTape(file, &tape);
+  Json_destroyTape(&tape);
+  return ok;
+}
+
+typedef struct {
+  size_t end;
+  unsigned long long left; // values (or fields) still to come
+  Json_Boolean is_object;
+  Json_Boolean want_key;
+} Json__TapeFrame;
+
+// one pass over the words of a loaded tape: there is one root, containers
+// nest, end inside their parent and hold what their count says, fields
+// start with a key, numbers have their second word and strings fit
+static
+Json_Boolean Json__tapeCheck(const Json_Tape *tape)
+{
+  Json__TapeFrame *stack = NULL;
+  size_t depth = 0, cap = 0;
+  Json_Boolean ok = JSON_TRUE;
+
+  for (size_t i = 0; ok && i <= tape->len; ++i) {
+    while (ok && depth && stack[depth - 1].end == i) {
+      const Json__TapeFrame *top = &stack[--depth];
+      ok = !top->left && (!top->is_object || top->want_key);
+    }
+    if (!ok || i == tape->len) break;
+    if (!depth && i) {
+      ok = JSON_FALSE;
+      break;
+    }
+
+    const char tag = JSON__TAPE_TAG(tape->words[i]);
+    const unsigned long long payload = JSON__TAPE_PAYLOAD(tape->words[i]);
+    const size_t limit = (depth)? stack[depth - 1].end : tape->len;
+    if (depth) {
+      Json__TapeFrame *top = &stack[depth - 1];
+      if (!top->is_object || top->want_key) {
+        ok = top->left && (!top->is_object || tag == '"');
+        --top->left;
+      }
+      if (top->is_object) top->want_key = !top->want_key;
+    }
+
+    switch (tag) {
+      case '[':
+      case '{':
+        if (payload < i + 2 || payload > limit) {
+          ok = JSON_FALSE;
+          break;
+        }
+
+        if (depth == cap) {
+          cap = (cap)? 2 * cap : 16;
+          Json__TapeFrame *frames = (Json__TapeFrame *)Json__resize(NULL, stack, sizeof(Json__TapeFrame) * cap);
+          if (!frames) {
+            ok = JSON_FALSE;
+            break;
+          }
+          stack = frames;
+        }
+
+        stack[depth].end = (size_t)payload;
+        stack[depth].left = tape->words[++i];
+        stack[depth].is_object = tag == '{';
+        stack[depth].want_key = JSON_TRUE;
+        ++depth;
+        break;
+
+      case 'l':
+      case 'd':
+        if (++i >= limit) ok = JSON_FALSE;
+        break;
+
+      case '"': {
+        unsigned long long len;
+        if (payload > tape->strings_len || tape->strings_len - payload < sizeof(len)) {
+          ok = JSON_FALSE;
+          break;
+        }
+
+        memcpy(&len, &tape->strings[payload], sizeof(len));
+        if (len > tape->strings_len - payload - sizeof(len)) ok = JSON_FALSE;
+      } break;
+
+      default: break;
+    }
+  }
+
+  Json__release(NULL, stack);
+  return ok && !depth;
+}
+
+// points tape into a loaded file if its header and words check out; the
+// header keeps the words 8 byte aligned
+static
+Json_Boolean Json__binaryTape(const Json_MappedFile *file, Json_Tape *tape)
+{
+  unsigned long long hdr[4];
+  if (file->len < JSON__BINARY_HDR) return JSON_FALSE;
+  memcpy(hdr, file->data, sizeof(hdr));
+
+  if (memcmp(&hdr[0], JSON__BINARY_MAGIC, sizeof(hdr[0])) || hdr[1] != JSON__BINARY_VERSION) return JSON_FALSE;
+
+  const unsigned long long room = file->len - JSON__BINARY_HDR;
+  if (!hdr[2] || hdr[2] > room / sizeof(unsigned long long)) return JSON_FALSE;
+  if (hdr[3] != room - hdr[2] * sizeof(unsigned long long)) return JSON_FALSE;
+
+  tape->words = (unsigned long long *)(void *)(file->data + JSON__BINARY_HDR);
+  tape->len = tape->cap = (size_t)hdr[2];
+  tape->strings = (char *)(void *)(file->data + JSON__BINARY_HDR + sizeof(unsigned long long) * tape->len);
+  tape->strings_len = tape->strings_cap = (size_t)hdr[3];
+
+  return Json__tapeCheck(tape);
+}
+
+Json_Boolean Json_loadBinary(const char *path, Json_Binary *out)
+{
+  if (!out) return JSON_FALSE;
+  memset(out, 0, sizeof(*out));
+  if (!Json_mapFile(path, &out->file)) return JSON_FALSE;
+
+  if (!Json__binaryTape(&out->file, &out->tape)) {
+    Json_unloadBinary(out);
+    return JSON_FALSE;
+  }
+
+  return JSON_TRUE;
+}
+
+void Json_unloadBinary(Json_Binary *binary)
+{
+  if (!binary) return;
+
+  Json_unmapFile(&binary->file);
+  memset(binary, 0, sizeof(*binary));
+}
+
+Json_TapeRef Json_tapeRoot(const Json_Tape *tape)
+{
+  Json_TapeRef ref;
+  ref.tape = tape;
+  ref.idx = (tape && tape->len)? 0 : (size_t)-1;
+  return ref;
+}
+
+// the word of a node, or 0 (which has no valid tag) if there is none
+static
+unsigned long long Json__tapeWord(Json_TapeRef ref)
+{
+  if (!ref.tape || ref.idx >= ref.tape->len) return 0;
+  return ref.tape->words[ref.idx];
+}
+
+// index just past the node, so siblings are one jump apart
+static
+size_t Json__tapeNext(Json_TapeRef ref)
+{
+  const unsigned long long word = ref.tape->words[ref.idx];
+  switch (JSON__TAPE_TAG(word)) {
+    case '[':
+    case '{': return (size_t)JSON__TAPE_PAYLOAD(word);
+    case 'l':
+    case 'd': return ref.idx + 2;
+    default: return ref.idx + 1;
+  }
+}
+
+// an empty string if it doesn't fit in the strings
+static
+Json_String Json__tapeString(const Json_Tape *tape, unsigned long long word)
+{
+  static char empty[1] = "";
+
+  Json_String ret;
+  ret.is_heap = JSON_FALSE;
+  ret.len = 0;
+  ret.data = empty;
+
+  const unsigned long long offset = JSON__TAPE_PAYLOAD(word);
+  unsigned long long len;
+  if (offset > tape->strings_len || tape->strings_len - offset < sizeof(len)) return ret;
+  memcpy(&len, &tape->strings[offset], sizeof(len));
+  if (len > tape->strings_len - offset - sizeof(len)) return ret;
+
+  ret.len = (size_t)len;
+  ret.data = &tape->strings[offset + sizeof(len)];
+  return ret;
+}
+
+Json_Type Json_tapeType(Json_TapeRef ref)
+{
+  switch (JSON__TAPE_TAG(Json__tapeWord(ref))) {
+    case 't':
+    case 'f': return JSON_TYPE_BOOLEAN;
+    case 'd': return JSON_TYPE_NUMBER;
+    case 'l': return JSON_TYPE_INTEGER;
+    case '"': return JSON_TYPE_STRING;
+    case '[': return JSON_TYPE_ARRAY;
+    case '{': return JSON_TYPE_OBJECT;
+    default: return JSON_TYPE_NULL;
+  }
+}
+
+size_t Json_tapeLen(Json_TapeRef ref)
+{
+  const char tag = JSON__TAPE_TAG(Json__tapeWord(ref));
+  if (tag != '[' && tag != '{') return 0;
+  return (size_t)ref.tape->words[ref.idx + 1];
+}
+
+Json_Boolean Json_tapeIter(Json_TapeRef container, Json_TapeIter *out)
+{
+  if (!out) return JSON_FALSE;
+
+  const unsigned long long word = Json__tapeWord(container);
+  const char tag = JSON__TAPE_TAG(word);
+  if (tag != '[' && tag != '{') return JSON_FALSE;
+
+  out->at.tape = container.tape;
+  out->at.idx = container.idx + 2;
+  out->end = (size_t)JSON__TAPE_PAYLOAD(word);
+  out->is_object = tag == '{';
+  return JSON_TRUE;
+}
+
+Json_Boolean Json_tapeNext(Json_TapeIter *iter, Json_String *key, Json_TapeRef *value)
+{
+  if (!iter || !value || iter->at.idx >= iter->end) return JSON_FALSE;
+
+  if (iter->is_object) {
+    if (key) *key = Json__tapeString(iter->at.tape, iter->at.tape->words[iter->at.idx]);
+    ++iter->at.idx;
+  }
+
+  *value = iter->at;
+  iter->at.idx = Json__tapeNext(iter->at);
+  return JSON_TRUE;
+}
+
+Json_Boolean Json_tapeGet(Json_TapeRef object, Json_String field, Json_TapeRef *out)
+{
+  if (!out || !field.data) return JSON_FALSE;
+
+  Json_TapeIter iter;
+  if (!Json_tapeIter(object, &iter) || !iter.is_object) return JSON_FALSE;
+
+  Json_String key;
+  while (Json_tapeNext(&iter, &key, out)) {
+    if (key.len == field.len && !memcmp(key.data, field.data, key.len)) return JSON_TRUE;
+  }
+
+  return JSON_FALSE;
+}
+
+Json_Boolean Json_tapeAt(Json_TapeRef array, size_t idx, Json_TapeRef *out)
+{
+  if (!out) return JSON_FALSE;
+
+  Json_TapeIter iter;
+  if (!Json_tapeIter(array, &iter) || iter.is_object) return JSON_FALSE;
+  if (idx >= Json_tapeLen(array)) return JSON_FALSE;
+
+  for (size_t i = 0; Json_tapeNext(&iter, NULL, out); ++i) {
+    if (i == idx) return JSON_TRUE;
+  }
+
+  return JSON_FALSE;
+}
+
+// a scalar as a Json_Value for the Json__value* conversions, with a one
+// element array decoded into elem the way those conversions expect
+static
+void Json__tapeDecode(Json_TapeRef ref, Json_Value *out, Json__Single *elem)
+{
+  memset(out, 0, sizeof(*out));
+
+  const unsigned long long word = Json__tapeWord(ref);
+  switch (JSON__TAPE_TAG(word)) {
+    case 't':
+    case 'f':
+      out->type = JSON_TYPE_BOOLEAN;
+      out->v.as_boolean = JSON__TAPE_TAG(word) == 't';
+      break;
+
+    case 'd':
+      out->type = JSON_TYPE_NUMBER;
+      memcpy(&out->v.as_number, &ref.tape->words[ref.idx + 1], sizeof(Json_Number));
+      break;
+
+    case 'l':
+      out->type = JSON_TYPE_INTEGER;
+      out->v.as_integer = (Json_Integer)ref.tape->words[ref.idx + 1];
+      break;
+
+    case '"':
+      out->type = JSON_TYPE_STRING;
+      out->v.as_string = Json__tapeString(ref.tape, word);
+      break;
+
+    case '[': {
+      out->type = JSON_TYPE_ARRAY;
+      if (Json_tapeLen(ref) != 1) break;
+
+      Json_TapeRef first = {ref.tape, ref.idx + 2};
+      const char tag = JSON__TAPE_TAG(ref.tape->words[first.idx]);
+      if (tag == '[' || tag == '{') break;
+
+      Json__tapeDecode(first, &elem->value, NULL);
+      memset(&elem->hdr, 0, sizeof(elem->hdr));
+      out->v.as_array.elems = &elem->value;
+      out->v.as_array.len = out->v.as_array.cap = 1;
+    } break;
+
+    case '{': out->type = JSON_TYPE_OBJECT; break;
+    default: break;
+  }
+}
+
+Json_Boolean Json_tapeBool(Json_TapeRef ref, Json_Boolean fallback)
+{
+  if (!Json__tapeWord(ref)) return fallback;
+
+  Json_Value val;
+  Json__Single elem;
+  Json__tapeDecode(ref, &val, &elem);
+  return Json__valueBool(&val, fallback);
+}
+
+Json_Number Json_tapeNum(Json_TapeRef ref, Json_Number fallback)
+{
+  if (!Json__tapeWord(ref)) return fallback;
+
+  Json_Value val;
+  Json__Single elem;
+  Json__tapeDecode(ref, &val, &elem);
+  return Json__valueNum(&val, fallback);
+}
+
+Json_Integer Json_tapeInt(Json_TapeRef ref, Json_Integer fallback)
+{
+  if (!Json__tapeWord(ref)) return fallback;
+
+  Json_Value val;
+  Json__Single elem;
+  Json__tapeDecode(ref, &val, &elem);
+  return Json__valueInt(&val, fallback);
+}
+
+Json_String Json_tapeStr(Json_TapeRef ref, Json_String fallback)
+{
+  if (!Json__tapeWord(ref)) return fallback;
+
+  Json_Value val;
+  Json__Single elem;
+  Json__tapeDecode(ref, &val, &elem);
+  return Json__valueStr(&val, fallback);
+}
+
+Json_Boolean Json_tapeGetBool(Json_TapeRef object, Json_String field, Json_Boolean fallback)
+{
+  Json_TapeRef val;
+  return (Json_tapeGet(object, field, &val))? Json_tapeBool(val, fallback) : fallback;
+}
+
+Json_Number Json_tapeGetNum(Json_TapeRef object, Json_String field, Json_Number fallback)
+{
+  Json_TapeRef val;
+  return (Json_tapeGet(object, field, &val))? Json_tapeNum(val, fallback) : fallback;
+}
+
+Json_Integer Json_tapeGetInt(Json_TapeRef object, Json_String field, Json_Integer fallback)
+{
+  Json_TapeRef val;
+  return (Json_tapeGet(object, field, &val))? Json_tapeInt(val, fallback) : fallback;
+}
+
+Json_String Json_tapeGetStr(Json_TapeRef object, Json_String field, Json_String fallback)
+{
+  Json_TapeRef val;
+  return (Json_tapeGet(object, field, &val))? Json_tapeStr(val, fallback) : fallback;
+}
+
+void Json_sinkInitBuffer(Json_Sink *sink)
+{
+  Json_sinkInit(sink, NULL, NULL);
+}
+
+void Json_sinkInit(Json_Sink *sink, Json_Boolean (*write)(void *user, const char *data, size_t len), void *user)
+{
+  if (!sink) return;
+
+  sink->write = write;
+  sink->user = user;
+  sink->data = NULL;
+  sink->len = 0;
+  sink->cap = 0;
+  sink->failed = JSON_FALSE;
+}
+
+Json_Boolean Json_sinkFlush(Json_Sink *sink)
+{
+  if (!sink || sink->failed) return JSON_FALSE;
+  if (!sink->write || !sink->len) return JSON_TRUE;
+
+  if (!sink->write(sink->user, sink->data, sink->len)) sink->failed = JSON_TRUE;
+  sink->len = 0;
+  return !sink->failed;
+}
+
+Json_Boolean Json_sinkWrite(Json_Sink *sink, const char *data, size_t len)
+{
+  if (!sink || sink->failed) return JSON_FALSE;
+
+  // one byte is always kept free for the NUL of buffer sinks
+  if (len < sink->cap - sink->len) {
+    memcpy(&sink->data[sink->len], data, len);
+    sink->len += len;
+    sink->data[sink->len] = '\0';
+    return JSON_TRUE;
+  }
+
+  if (sink->write) {
+    if (!Json_sinkFlush(sink)) return JSON_FALSE;
+
+    // large pieces skip the chunk altogether
+    if (len >= JSON_SINK_CHUNK) {
+      if (!sink->write(sink->user, data, len)) sink->failed = JSON_TRUE;
+      return !sink->failed;
+    }
+
+    if (!sink->data) {
+      sink->data = (char *)Json__alloc(NULL, JSON_SINK_CHUNK);
+      if (!sink->data) {
+        sink->failed = JSON_TRUE;
+        return JSON_FALSE;
+      }
+
+      sink->cap = JSON_SINK_CHUNK;
+    }
+  } else {
+    size_t cap = (sink->cap)? sink->cap : JSON_SINK_CHUNK;
+    while (cap - sink->len <= len) cap *= 2;
+
+    char *data = (char *)Json__resize(NULL, sink->data, cap);
+    if (!data) {
+      sink->failed = JSON_TRUE;
+      return JSON_FALSE;
+    }
+
+    sink->data = data;
+    sink->cap = cap;
+  }
+
+  memcpy(&sink->data[sink->len], data, len);
+  sink->len += len;
+  sink->data[sink->len] = '\0';
+  return JSON_TRUE;
+}
+
+void Json_sinkDestroy(Json_Sink *sink)
+{
+  if (!sink) return;
+
+  Json__release(NULL, sink->data);
+  sink->data = NULL;
+  sink->len = 0;
+  sink->cap = 0;
+}
+
+typedef struct {
+  Json_Sink *sink;
+  Json_Boolean pretty;
+  Json_Boolean raw;
+  const char *indent;
+  size_t indent_len;
+  size_t nodes;
+} Json__Writer;
+
+static
+void Json__writeIndent(Json__Writer *w, int depth)
+{
+  for (int i = 0; i < depth; ++i) Json_sinkWrite(w->sink, w->indent, w->indent_len);
+}
+
+static
+void Json__writeEscape(Json_Sink *sink, unsigned long codepoint)
+{
+  static const char hex[] = "0123456789abcdef";
+  char esc[6] = {'\\', 'u', 0, 0, 0, 0};
+
+  esc[2] = hex[(codepoint >> 12) & 0xf];
+  esc[3] = hex[(codepoint >> 8) & 0xf];
+  esc[4] = hex[(codepoint >> 4) & 0xf];
+  esc[5] = hex[codepoint & 0xf];
+  Json_sinkWrite(sink, esc, sizeof(esc));
+}
+
+// length of the UTF-8 sequence at p, or 0 if it is malformed, overlong or
+// encodes a surrogate
+static
+size_t Json__decodeUtf8(const unsigned char *p, size_t n, unsigned long *out)
+{
+  size_t len;
+  unsigned long codepoint, min;
+
+  if (p[0] >> 5 == 6) {
+    len = 2;
+    codepoint = p[0] & 0x1f;
+    min = 0x80;
+  } else if (p[0] >> 4 == 0xe) {
+    len = 3;
+    codepoint = p[0] & 0xf;
+    min = 0x800;
+  } else if (p[0] >> 3 == 0x1e) {
+    len = 4;
+    codepoint = p[0] & 7;
+    min = 0x10000;
+  } else {
+    return 0;
+  }
+
+  if (len > n) return 0;
+  for (size_t i = 1; i < len; ++i) {
+    if (p[i] >> 6 != 2) return 0;
+    codepoint = (codepoint << 6) | (p[i] & 0x3f);
+  }
+
+  if (codepoint < min || codepoint > 0x10ffff) return 0;
+  if (codepoint >= 0xd800 && codepoint <= 0xdfff) return 0;
+
+  *out = codepoint;
+  return len;
+}
+
+static
+void Json__writeString(Json__Writer *w, size_t len, const char *data)
+{
+  Json_Sink *sink = w->sink;
+
+  Json_sinkWrite(sink, "\"", 1);
+
+  // runs of characters that need no escaping are written in one go; non-ASCII
+  // bytes are always looked at, but only validated in raw mode
+  Json__Finder f;
+  const unsigned classes = JSON__CLASS_STRING | JSON__CLASS_CONTROL;
+  Json__finderInit(&f, data, len, (w->raw)? classes : classes | JSON__CLASS_SLASH);
+
+  size_t run = 0, i = 0;
+  while (i < len) {
+    i = Json__finderNext(&f, i);
+    if (i >= len) break;
+
+    const unsigned char c = (unsigned char)data[i];
+    unsigned long codepoint;
+    size_t n = 1;
+
+    if (c >= 0x80) {
+      n = Json__decodeUtf8((const unsigned char *)&data[i], len - i, &codepoint);
+      if (n && w->raw) {
+        i += n;
+        continue;
+      }
+    }
+
+    Json_sinkWrite(sink, &data[run], i - run);
+
+    if (c < 0x80) {
+      const char *str = NULL;
+      switch ((char)c) {
+        case '"':  str = "\\\""; break;
+        case '\\': str = "\\\\"; break;
+        case '/':  str = "\\/";  break;
+        case '\b': str = "\\b";  break;
+        case '\f': str = "\\f";  break;
+        case '\n': str = "\\n";  break;
+        case '\r': str = "\\r";  break;
+        case '\t': str = "\\t";  break;
+        default: break;
+      }
+
+      if (str) Json_sinkWrite(sink, str, 2);
+      else Json__writeEscape(sink, c);
+    } else if (!n) {
+      // invalid character, only its first byte is dropped
+      Json__writeEscape(sink, 0xfffd);
+      n = 1;
+    } else if (codepoint < 0x10000) {
+      Json__writeEscape(sink, codepoint);
+    } else {
+      // json uses utf-16 surrogates for characters outside the BMP
+      codepoint -= 0x10000;
+      Json__writeEscape(sink, 0xd800 + (codepoint >> 10));
+      Json__writeEscape(sink, 0xdc00 + (codepoint & 0x3ff));
+    }
+
+    i += n;
+    run = i;
+  }
+
+  Json_sinkWrite(sink, &data[run], len - run);
+  Json_sinkWrite(sink, "\"", 1);
+}
+
+static
+void Json__writeValue(Json__Writer *w, const Json_Value *value, int depth)
+{
+  Json_Sink *sink = w->sink;
+  if (sink->failed) return;
+  ++w->nodes;
+
+  switch (value->type) {
+    case JSON_TYPE_NULL: Json_sinkWrite(sink, "null", 4); break;
+
+    case JSON_TYPE_BOOLEAN:
+      if (value->v.as_boolean) Json_sinkWrite(sink, "true", 4);
+      else Json_sinkWrite(sink, "false", 5);
+      break;
+
+    case JSON_TYPE_NUMBER: {
+      char num[JSON_NUMBER_BUFSZ];
+      const size_t len = Json_formatNumber(num, value->v.as_number);
+
+      // json has no infinities or NaN, they go out as strings
+      if (isinf(value->v.as_number) || isnan(value->v.as_number)) {
+        Json__writeString(w, len, num);
+      } else {
+        Json_sinkWrite(sink, num, len);
+      }
+    } break;
+
+    case JSON_TYPE_INTEGER: {
+      char num[JSON_NUMBER_BUFSZ];
+      Json_sinkWrite(sink, num, Json_formatInteger(num, value->v.as_integer));
+    } break;
+
+    case JSON_TYPE_STRING:
+      Json__writeString(w, value->v.as_string.len, value->v.as_string.data);
+      break;
+
+    case JSON_TYPE_ARRAY:
+      Json_sinkWrite(sink, "[", 1);
+
+      for (size_t i = 0; i < value->v.as_array.len; ++i) {
+        if (i) Json_sinkWrite(sink, ",", 1);
+        if (w->pretty) {
+          Json_sinkWrite(sink, "\n", 1);
+          Json__writeIndent(w, depth + 1);
+        }
+
+        Json__writeValue(w, &value->v.as_array.elems[i], depth + 1);
+      }
+
+      if (w->pretty) {
+        Json_sinkWrite(sink, "\n", 1);
+        Json__writeIndent(w, depth);
+      }
+      Json_sinkWrite(sink, "]", 1);
+      break;
+
+    case JSON_TYPE_OBJECT:
+      Json_sinkWrite(sink, "{", 1);
+
+      for (size_t i = 0; i < value->v.as_object.len; ++i) {
+        if (i) Json_sinkWrite(sink, ",", 1);
+        if (w->pretty) {
+          Json_sinkWrite(sink, "\n", 1);
+          Json__writeIndent(w, depth + 1);
+        }
+
+        const Json_String *key = &value->v.as_object.field_names[i];
+        Json__writeString(w, key->len, key->data);
+
+        if (w->pretty) Json_sinkWrite(sink, ": ", 2);
+        else Json_sinkWrite(sink, ":", 1);
+
+        Json__writeValue(w, &value->v.as_object.field_values[i], depth + 1);
+      }
+
+      if (w->pretty) {
+        Json_sinkWrite(sink, "\n", 1);
+        Json__writeIndent(w, depth);
+      }
+      Json_sinkWrite(sink, "}", 1);
+      break;
+  }
+}
+
+Json_Boolean Json_serialize(const Json_Value *value, const Json_WriteOptions *opts, Json_Sink *sink)
+{
+  if (!value || !sink) return JSON_FALSE;
+
+  Json__Writer w;
+  w.sink = sink;
+  w.pretty = opts && (opts->flags & JSON_WRITE_PRETTY);
+  w.raw = opts && (opts->flags & JSON_WRITE_RAW_UTF8);
+  w.indent = (opts && opts->indent)? opts->indent : "\t";
+  w.indent_len = strlen(w.indent);
+  w.nodes = 0;
+
+  Json_Stats *stats = (opts)? opts->stats : NULL;
+  const double start = (stats)? Json__now() : 0.0;
+  Json__writeValue(&w, value, 0);
+  const Json_Boolean ok = Json_sinkFlush(sink);
+
+  if (stats) {
+    stats->nodes += w.nodes;
+    stats->seconds += Json__now() - start;
+  }
+  return ok;
+}
+
+Json_Boolean Json_serializeString(Json_String str, unsigned flags, Json_Sink *sink)
+{
+  if (!sink || (!str.data && str.len)) return JSON_FALSE;
+
+  Json__Writer w;
+  memset(&w, 0, sizeof(w));
+  w.sink = sink;
+  w.raw = (flags & JSON_WRITE_RAW_UTF8) != 0;
+  Json__writeString(&w, str.len, str.data);
+  return !sink->failed;
+}
+
+static
+Json_Boolean Json__writeFile(void *user, const char *data, size_t len)
+{
+  return fwrite(data, 1, len, (FILE *)user) == len;
+}
+
+void Json_printValue(FILE *file, const Json_Value *value)
+{
+  if (!file || !value) return;
+
+  Json_WriteOptions opts = {JSON_WRITE_PRETTY, NULL, NULL};
+  Json_Sink sink;
+  Json_sinkInit(&sink, Json__writeFile, file);
+
+  if (Json_serialize(value, &opts, &sink)) {
+    Json_sinkWrite(&sink, "\n", 1);
+    Json_sinkFlush(&sink);
+  }
+
+  Json_sinkDestroy(&sink);
+}
+
 #endif // JSON_IMPLEMENTATION
@@ -0,0 +1,998 @@
+/*
+This is free and unencumbered software released into the public domain.
+
+Anyone is free to copy, modify, publish, use, compile, sell, or
+distribute this software, either in source code form or as a compiled
+binary, for any purpose, commercial or non-commercial, and by any
+means.
+
+In jurisdictions that recognize copyright laws, the author or authors
+of this software dedicate any and all copyright interest in the
+software to the public domain. We make this dedication for the benefit
+of the public at large and to the detriment of our heirs and
+successors. We intend this dedication to be an overt act of
+relinquishment in perpetuity of all present and future rights to this
+software under copyright law.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// C++17 layer over json.h; JSON_IMPLEMENTATION still goes in one source file,
+// before including either header
+
+#ifndef JSON_HPP_
+#define JSON_HPP_ 1
+
+#include "json.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace json {
+
+enum class Type {
+  null    = JSON_TYPE_NULL,
+  boolean = JSON_TYPE_BOOLEAN,
+  number  = JSON_TYPE_NUMBER,
+  string  = JSON_TYPE_STRING,
+  array   = JSON_TYPE_ARRAY,
+  object  = JSON_TYPE_OBJECT,
+  integer = JSON_TYPE_INTEGER
+};
+
+// tags for constructing empty containers, e.g. Value doc(json::object)
+struct array_t {};
+struct object_t {};
+inline constexpr array_t array{};
+inline constexpr object_t object{};
+
+// a Json_String over text the caller keeps alive
+inline Json_String borrow(std::string_view str)
+{
+  Json_String ret;
+  ret.is_heap = JSON_FALSE;
+  ret.len = str.size();
+  ret.data = const_cast<char *>(str.data());
+  return ret;
+}
+
+inline std::string_view view(Json_String str)
+{
+  return (str.data)? std::string_view(str.data, str.len) : std::string_view();
+}
+
+// read-only and non-owning, empty for anything missing; lookups only read,
+// so any number of threads can share a tree nothing is changing
+class View {
+public:
+  View() = default;
+  View(const Json_Value *value) : value_(value) {}
+
+  const Json_Value *raw() const { return value_; }
+  explicit operator bool() const { return value_ != nullptr; }
+
+  Type type() const { return (value_)? static_cast<Type>(value_->type) : Type::null; }
+  bool isNull() const { return type() == Type::null; }
+  bool isBool() const { return type() == Type::boolean; }
+  bool isNumber() const { return type() == Type::number || type() == Type::integer; }
+  bool isString() const { return type() == Type::string; }
+  bool isArray() const { return type() == Type::array; }
+  bool isObject() const { return type() == Type::object; }
+
+  // no conversions between types beyond integers and doubles, unlike the
+  // C getters, since formatting a number as a string would allocate
+  bool asBool(bool fallback = false) const
+  {
+    return (isBool())? value_->v.as_boolean != JSON_FALSE : fallback;
+  }
+
+  double asNumber(double fallback = 0.0) const
+  {
+    if (type() == Type::integer) return static_cast<double>(value_->v.as_integer);
+    return (type() == Type::number)? value_->v.as_number : fallback;
+  }
+
+  long long asInt(long long fallback = 0) const
+  {
+    if (type() == Type::integer) return value_->v.as_integer;
+    if (type() != Type::number) return fallback;
+
+    const double num = value_->v.as_number;
+    const bool exact = num >= -9223372036854775808.0 && num < 9223372036854775808.0
+                       && static_cast<double>(static_cast<long long>(num)) == num;
+    return (exact)? static_cast<long long>(num) : fallback;
+  }
+
+  std::string_view asString(std::string_view fallback = {}) const
+  {
+    return (isString())? view(value_->v.as_string) : fallback;
+  }
+
+  // elements of an array or fields of an object, 0 for anything else
+  size_t size() const
+  {
+    if (isArray()) return value_->v.as_array.len;
+    if (isObject()) return value_->v.as_object.len;
+    return 0;
+  }
+
+  View operator[](std::string_view field) const
+  {
+    if (!isObject()) return View();
+    return View(Json_objectGet(const_cast<Json_Value *>(value_), borrow(field)));
+  }
+
+  View operator[](size_t idx) const
+  {
+    if (!isArray() || idx >= value_->v.as_array.len) return View();
+    return View(&value_->v.as_array.elems[idx]);
+  }
+
+  bool contains(std::string_view field) const { return static_cast<bool>((*this)[field]); }
+
+  class Elements;
+  class Members;
+
+  // both are empty for anything but an array (or an object)
+  Elements elements() const;
+  Members members() const;
+
+  std::string dump(bool pretty = false) const;
+
+private:
+  const Json_Value *value_ = nullptr;
+};
+
+// an object field, which structured bindings take apart
+struct Member {
+  std::string_view key;
+  View value;
+};
+
+class View::Elements {
+public:
+  class iterator {
+  public:
+    explicit iterator(const Json_Value *at) : at_(at) {}
+    View operator*() const { return View(at_); }
+    iterator &operator++() { ++at_; return *this; }
+    bool operator!=(const iterator &other) const { return at_ != other.at_; }
+    bool operator==(const iterator &other) const { return at_ == other.at_; }
+
+  private:
+    const Json_Value *at_;
+  };
+
+  Elements(const Json_Value *first, size_t len) : first_(first), len_(len) {}
+  iterator begin() const { return iterator(first_); }
+  iterator end() const { return iterator(first_ + len_); }
+  size_t size() const { return len_; }
+
+private:
+  const Json_Value *first_;
+  size_t len_;
+};
+
+class View::Members {
+public:
+  class iterator {
+  public:
+    iterator(const Json_Object *object, size_t idx) : object_(object), idx_(idx) {}
+
+    Member operator*() const
+    {
+      Member ret;
+      ret.key = view(object_->field_names[idx_]);
+      ret.value = View(&object_->field_values[idx_]);
+      return ret;
+    }
+
+    iterator &operator++() { ++idx_; return *this; }
+    bool operator!=(const iterator &other) const { return idx_ != other.idx_; }
+    bool operator==(const iterator &other) const { return idx_ == other.idx_; }
+
+  private:
+    const Json_Object *object_;
+    size_t idx_;
+  };
+
+  explicit Members(const Json_Object *object) : object_(object) {}
+  iterator begin() const { return iterator(object_, 0); }
+  iterator end() const { return iterator(object_, (object_)? object_->len : 0); }
+  size_t size() const { return (object_)? object_->len : 0; }
+
+private:
+  const Json_Object *object_;
+};
+
+inline View::Elements View::elements() const
+{
+  if (!isArray()) return Elements(nullptr, 0);
+  return Elements(value_->v.as_array.elems, value_->v.as_array.len);
+}
+
+inline View::Members View::members() const
+{
+  return Members((isObject())? &value_->v.as_object : nullptr);
+}
+
+inline Json_Boolean appendString(void *user, const char *data, size_t len)
+{
+  static_cast<std::string *>(user)->append(data, len);
+  return JSON_TRUE;
+}
+
+inline std::string View::dump(bool pretty) const
+{
+  std::string out;
+  if (!value_) return out;
+
+  Json_WriteOptions opts;
+  std::memset(&opts, 0, sizeof(opts));
+  opts.flags = (pretty)? JSON_WRITE_PRETTY : 0u;
+
+  Json_Sink sink;
+  Json_sinkInit(&sink, appendString, &out);
+  const bool ok = Json_serialize(value_, &opts, &sink);
+  Json_sinkDestroy(&sink);
+  if (!ok) throw std::bad_alloc();
+  return out;
+}
+
+class Value;
+
+namespace detail {
+
+// fills a fresh Json_Value from a C++ value; throws std::bad_alloc, leaving
+// out null, when a string can't be copied
+template <class T>
+void construct(Json_Value &out, T &&val);
+
+inline void construct(Json_Value &out)
+{
+  std::memset(&out, 0, sizeof(out));
+}
+
+} // namespace detail
+
+// a View that can change the value; going down unshares each container like
+// Json_objectEdit does, so read through a View
+class Ref : public View {
+public:
+  Ref() = default;
+  explicit Ref(Json_Value *value) : View(value), value_(value) {}
+
+  Json_Value *raw() const { return value_; }
+
+  // constructs a new last element in place and returns it
+  template <class... Args>
+  Ref emplaceBack(Args &&...args) const
+  {
+    static_assert(sizeof...(Args) <= 1, "an element is made from at most one value");
+    if (!value_ || value_->type != JSON_TYPE_ARRAY) return Ref();
+
+    // reserving also moves storage that isn't this array's alone
+    Json_Array *array = &value_->v.as_array;
+    const size_t cap = (array->len == array->cap)? ((array->cap < 8)? 8 : 2 * array->cap) : array->cap;
+    if (!Json_arrayReserve(value_, cap)) throw std::bad_alloc();
+
+    Json_Value *slot = &array->elems[array->len];
+    detail::construct(*slot, std::forward<Args>(args)...);
+    ++array->len;
+    return Ref(slot);
+  }
+
+  // sets field to a value constructed in place, replacing whatever it was
+  template <class... Args>
+  Ref emplace(std::string_view field, Args &&...args) const
+  {
+    static_assert(sizeof...(Args) <= 1, "a field is made from at most one value");
+    if (!value_ || value_->type != JSON_TYPE_OBJECT) return Ref();
+
+    // the object keeps the name, so it gets a copy of its own
+    Json_String name = Json_stringDup(borrow(field));
+    if (!name.data) throw std::bad_alloc();
+
+    Json_objectSetNull(value_, name);
+
+    // the field is only missing if the object couldn't grow, in which case
+    // the copy was never taken over and is released as a string value
+    Json_Value *slot = Json_objectGet(value_, borrow(field));
+    if (!slot) {
+      Json_Value unused;
+      detail::construct(unused);
+      unused.type = JSON_TYPE_STRING;
+      unused.v.as_string = name;
+      Json_destroyValue(&unused);
+      throw std::bad_alloc();
+    }
+
+    detail::construct(*slot, std::forward<Args>(args)...);
+    return Ref(slot);
+  }
+
+  Ref operator[](std::string_view field) const
+  {
+    if (!value_ || value_->type != JSON_TYPE_OBJECT) return Ref();
+    if (!Json_unshare(value_)) throw std::bad_alloc();
+    return Ref(Json_objectGet(value_, borrow(field)));
+  }
+
+  Ref operator[](size_t idx) const
+  {
+    if (!value_ || value_->type != JSON_TYPE_ARRAY || idx >= value_->v.as_array.len) return Ref();
+    if (!Json_unshare(value_)) throw std::bad_alloc();
+    return Ref(&value_->v.as_array.elems[idx]);
+  }
+
+  void erase(std::string_view field) const { Json_objectDelete(value_, borrow(field)); }
+  // Json_arrayDelete leaves the element to its caller, here it's destroyed
+  void erase(size_t idx) const
+  {
+    if (!value_ || value_->type != JSON_TYPE_ARRAY || idx >= value_->v.as_array.len) return;
+    if (!Json_unshare(value_)) throw std::bad_alloc();
+
+    Json_destroyValue(&value_->v.as_array.elems[idx]);
+    Json_arrayDelete(value_, idx);
+  }
+
+  void reserve(size_t cap) const
+  {
+    if (!value_) return;
+    const bool ok = (value_->type == JSON_TYPE_ARRAY)? Json_arrayReserve(value_, cap) :
+                    (value_->type == JSON_TYPE_OBJECT)? Json_objectReserve(value_, cap) : true;
+    if (!ok) throw std::bad_alloc();
+  }
+
+  void shrinkToFit() const
+  {
+    Json_arrayShrink(value_);
+    Json_objectShrink(value_);
+  }
+
+private:
+  Json_Value *value_ = nullptr;
+};
+
+// owns a heap tree; move only, with explicit copies by snapshot() or clone()
+class Value {
+public:
+  Value() { detail::construct(value_); }
+
+  template <class T, class = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Value>>>
+  Value(T &&val) { detail::construct(value_, std::forward<T>(val)); }
+
+  Value(const Value &) = delete;
+  Value &operator=(const Value &) = delete;
+
+  Value(Value &&other) noexcept : value_(other.value_) { detail::construct(other.value_); }
+
+  Value &operator=(Value &&other) noexcept
+  {
+    if (this != &other) {
+      Json_destroyValue(&value_);
+      value_ = other.value_;
+      detail::construct(other.value_);
+    }
+    return *this;
+  }
+
+  ~Value() { Json_destroyValue(&value_); }
+
+  // takes over a tree from the C api, leaving raw null
+  static Value adopt(Json_Value &raw)
+  {
+    Value ret;
+    ret.value_ = raw;
+    detail::construct(raw);
+    return ret;
+  }
+
+  // gives the tree back to the C api, this is left null
+  Json_Value release()
+  {
+    Json_Value ret = value_;
+    detail::construct(value_);
+    return ret;
+  }
+
+  Json_Value *raw() { return &value_; }
+  const Json_Value *raw() const { return &value_; }
+
+  // shares this tree until either one is changed (see Json_snapshot)
+  Value snapshot() const
+  {
+    Value ret;
+    if (!Json_snapshot(&value_, &ret.value_)) throw std::bad_alloc();
+    return ret;
+  }
+
+  Value clone() const
+  {
+    Value ret;
+    if (!Json_clone(&value_, &ret.value_)) throw std::bad_alloc();
+    return ret;
+  }
+
+  View view() const { return View(&value_); }
+  Ref ref() { return Ref(&value_); }
+  operator View() const { return view(); }
+
+  Type type() const { return view().type(); }
+  size_t size() const { return view().size(); }
+  View operator[](std::string_view field) const { return view()[field]; }
+  View operator[](size_t idx) const { return view()[idx]; }
+  Ref operator[](std::string_view field) { return ref()[field]; }
+  Ref operator[](size_t idx) { return ref()[idx]; }
+
+  template <class... Args>
+  Ref emplaceBack(Args &&...args) { return ref().emplaceBack(std::forward<Args>(args)...); }
+
+  template <class... Args>
+  Ref emplace(std::string_view field, Args &&...args) { return ref().emplace(field, std::forward<Args>(args)...); }
+
+  void erase(std::string_view field) { ref().erase(field); }
+  void erase(size_t idx) { ref().erase(idx); }
+  void reserve(size_t cap) { ref().reserve(cap); }
+  void shrinkToFit() { ref().shrinkToFit(); }
+
+  std::string dump(bool pretty = false) const { return view().dump(pretty); }
+
+private:
+  Json_Value value_;
+};
+
+namespace detail {
+
+template <class T>
+void construct(Json_Value &out, T &&val)
+{
+  using U = std::decay_t<T>;
+  std::memset(&out, 0, sizeof(out));
+
+  if constexpr (std::is_same_v<U, std::nullptr_t>) {
+    out.type = JSON_TYPE_NULL;
+  } else if constexpr (std::is_same_v<U, bool>) {
+    out.type = JSON_TYPE_BOOLEAN;
+    out.v.as_boolean = (val)? JSON_TRUE : JSON_FALSE;
+  } else if constexpr (std::is_integral_v<U>) {
+    out.type = JSON_TYPE_INTEGER;
+    out.v.as_integer = static_cast<Json_Integer>(val);
+  } else if constexpr (std::is_floating_point_v<U>) {
+    out.type = JSON_TYPE_NUMBER;
+    out.v.as_number = static_cast<Json_Number>(val);
+  } else if constexpr (std::is_same_v<U, array_t>) {
+    out.type = JSON_TYPE_ARRAY;
+  } else if constexpr (std::is_same_v<U, object_t>) {
+    out.type = JSON_TYPE_OBJECT;
+  } else if constexpr (std::is_same_v<U, Value>) {
+    static_assert(!std::is_lvalue_reference_v<T>, "a Value has to be moved in");
+    out = val.release();
+  } else {
+    static_assert(std::is_convertible_v<T, std::string_view>, "no json type for this");
+    const Json_String str = Json_stringDup(borrow(std::string_view(val)));
+    if (!str.data) throw std::bad_alloc();
+
+    out.type = JSON_TYPE_STRING;
+    out.v.as_string = str;
+  }
+}
+
+} // namespace detail
+
+// parses text, which has to be exactly one json value, into out; on
+// failure out is left null
+inline bool parse(std::string_view text, Value &out)
+{
+  Json_Value raw;
+  const size_t len = Json_parseStr(text.size(), text.data(), &raw);
+  if (len && len == text.size()) {
+    out = Value::adopt(raw);
+    return true;
+  }
+
+  Json_destroyValue(&raw);
+  out = Value();
+  return false;
+}
+
+// a read-only tree parsed into an arena of its own, which goes away with
+// the Document in one go instead of value by value
+class Document {
+public:
+  Document() { std::memset(&arena_, 0, sizeof(arena_)); detail::construct(root_); }
+
+  Document(const Document &) = delete;
+  Document &operator=(const Document &) = delete;
+
+  Document(Document &&other) noexcept : arena_(other.arena_), root_(other.root_)
+  {
+    std::memset(&other.arena_, 0, sizeof(other.arena_));
+    detail::construct(other.root_);
+  }
+
+  Document &operator=(Document &&other) noexcept
+  {
+    if (this != &other) {
+      Json_arenaDestroy(&arena_);
+      arena_ = other.arena_;
+      root_ = other.root_;
+      std::memset(&other.arena_, 0, sizeof(other.arena_));
+      detail::construct(other.root_);
+    }
+    return *this;
+  }
+
+  ~Document() { Json_arenaDestroy(&arena_); }
+
+  // like json::parse, a failed parse leaves an empty Document
+  bool parse(std::string_view text)
+  {
+    Json_arenaDestroy(&arena_);
+    Json_arenaInit(&arena_, 0);
+
+    const size_t len = Json_parseStrArena(&arena_, text.size(), text.data(), &root_);
+    if (len && len == text.size()) return true;
+
+    Json_arenaDestroy(&arena_);
+    std::memset(&arena_, 0, sizeof(arena_));
+    detail::construct(root_);
+    return false;
+  }
+
+  View root() const { return View(&root_); }
+  View operator[](std::string_view field) const { return root()[field]; }
+  View operator[](size_t idx) const { return root()[idx]; }
+
+private:
+  Json_Arena arena_;
+  Json_Value root_;
+};
+
+// binding structs, which list their fields once:
+//
+//   struct Route {
+//     std::string path;
+//     std::vector<std::string> tags;
+//     static constexpr auto jsonFields = json::fields(JSON_FIELD(Route, path), JSON_FIELD(Route, tags));
+//   };
+//
+// members can be bool, arithmetic, std::string, std::optional, std::vector
+// (not of bool) and other such structs
+
+namespace detail {
+
+// FNV-1a, computed at compile time for field names and at run time for keys
+constexpr unsigned long long hashName(std::string_view name)
+{
+  unsigned long long hash = 14695981039346656037ull;
+  for (char c : name) hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  return hash;
+}
+
+// whether a name can go out between quotes as it is
+constexpr bool plainName(std::string_view name)
+{
+  for (char c : name) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    if (u < 0x20 || u >= 0x80 || c == '"' || c == '\\' || c == '/') return false;
+  }
+  return true;
+}
+
+} // namespace detail
+
+template <class T, class M>
+struct Field {
+  std::string_view name;
+  unsigned long long hash;
+  bool plain;
+  M T::*member;
+};
+
+template <class T, class M>
+constexpr Field<T, M> field(std::string_view name, M T::*member)
+{
+  return Field<T, M>{name, detail::hashName(name), detail::plainName(name), member};
+}
+
+template <class... F>
+constexpr std::tuple<F...> fields(F... list)
+{
+  return std::tuple<F...>(list...);
+}
+
+#define JSON_FIELD(type, member) ::json::field(#member, &type::member)
+
+namespace detail {
+
+template <class T, class = void>
+struct HasFields : std::false_type {};
+
+template <class T>
+struct HasFields<T, std::void_t<decltype(T::jsonFields)>> : std::true_type {};
+
+struct Binder;
+
+// somewhere a value can be decoded into
+struct Target {
+  void *obj;
+  const Binder *binder;
+};
+
+// what a type does with each event, NULL where that event doesn't fit it;
+// scalars return false for values they can't hold
+struct Binder {
+  void (*null)(void *obj);
+  bool (*boolean)(void *obj, bool val);
+  bool (*integer)(void *obj, Json_Integer val);
+  bool (*number)(void *obj, Json_Number val);
+  bool (*string)(void *obj, std::string_view val);
+
+  // structs: where the field key goes, false if there is no such field
+  bool (*member)(void *obj, std::string_view key, Target *out);
+
+  // vectors: empties it when an array starts, then adds each element
+  void (*clear)(void *obj);
+  Target (*element)(void *obj);
+
+  // optionals: the value inside, which is made to exist first
+  Target (*unwrap)(void *obj);
+};
+
+template <class T, class = void>
+struct Bind;
+
+template <class T>
+inline constexpr const Binder *binderOf = &Bind<T>::binder;
+
+template <>
+struct Bind<bool> {
+  static bool boolean(void *obj, bool val) { *static_cast<bool *>(obj) = val; return true; }
+
+  static constexpr Binder binder = {nullptr, boolean, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+};
+
+template <class T>
+struct Bind<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+  static bool integer(void *obj, Json_Integer val)
+  {
+    if constexpr (std::is_signed_v<T>) {
+      if (static_cast<Json_Integer>(static_cast<T>(val)) != val) return false;
+    } else {
+      if (val < 0 || static_cast<unsigned long long>(val) > std::numeric_limits<T>::max()) return false;
+    }
+
+    *static_cast<T *>(obj) = static_cast<T>(val);
+    return true;
+  }
+
+  // only numbers without a fraction, e.g. 1e3
+  static bool number(void *obj, Json_Number val)
+  {
+    if (!(val >= -9.2e18 && val <= 9.2e18) || std::trunc(val) != val) return false;
+    return integer(obj, static_cast<Json_Integer>(val));
+  }
+
+  static constexpr Binder binder = {nullptr, nullptr, integer, number, nullptr, nullptr, nullptr, nullptr, nullptr};
+};
+
+template <class T>
+struct Bind<T, std::enable_if_t<std::is_floating_point_v<T>>> {
+  static bool integer(void *obj, Json_Integer val) { *static_cast<T *>(obj) = static_cast<T>(val); return true; }
+  static bool number(void *obj, Json_Number val) { *static_cast<T *>(obj) = static_cast<T>(val); return true; }
+
+  static constexpr Binder binder = {nullptr, nullptr, integer, number, nullptr, nullptr, nullptr, nullptr, nullptr};
+};
+
+template <>
+struct Bind<std::string> {
+  static bool string(void *obj, std::string_view val) { static_cast<std::string *>(obj)->assign(val); return true; }
+
+  static constexpr Binder binder = {nullptr, nullptr, nullptr, nullptr, string, nullptr, nullptr, nullptr, nullptr};
+};
+
+template <class T>
+struct Bind<std::optional<T>> {
+  static void null(void *obj) { static_cast<std::optional<T> *>(obj)->reset(); }
+
+  static Target unwrap(void *obj)
+  {
+    auto *opt = static_cast<std::optional<T> *>(obj);
+    if (!opt->has_value()) opt->emplace();
+    return Target{&**opt, binderOf<T>};
+  }
+
+  static constexpr Binder binder = {null, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, unwrap};
+};
+
+template <class T>
+struct Bind<std::vector<T>> {
+  static_assert(!std::is_same_v<T, bool>, "json: std::vector<bool> has no elements to decode into");
+
+  static void clear(void *obj) { static_cast<std::vector<T> *>(obj)->clear(); }
+
+  static Target element(void *obj)
+  {
+    auto *vec = static_cast<std::vector<T> *>(obj);
+    vec->emplace_back();
+    return Target{&vec->back(), binderOf<T>};
+  }
+
+  static constexpr Binder binder = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, clear, element, nullptr};
+};
+
+template <class T>
+struct Bind<T, std::enable_if_t<HasFields<T>::value>> {
+  // hashes are compared first, so a key that matches no field is usually
+  // turned away without looking at a single name
+  static bool member(void *obj, std::string_view key, Target *out)
+  {
+    const unsigned long long hash = hashName(key);
+    return std::apply([&](const auto &...list) {
+      return ((list.hash == hash && list.name == key && bindMember(obj, list, out)) || ...);
+    }, T::jsonFields);
+  }
+
+  template <class M>
+  static bool bindMember(void *obj, const Field<T, M> &f, Target *out)
+  {
+    *out = Target{&(static_cast<T *>(obj)->*f.member), binderOf<M>};
+    return true;
+  }
+
+  static constexpr Binder binder = {nullptr, nullptr, nullptr, nullptr, nullptr, member, nullptr, nullptr, nullptr};
+};
+
+// Json_parseEvents handler that keeps the containers being filled on a stack
+class Decoder {
+public:
+  explicit Decoder(Target root) : next_(root), failed_(false) {}
+
+  bool failed() const { return failed_; }
+
+  Json_EventHandler handler()
+  {
+    Json_EventHandler h;
+    std::memset(&h, 0, sizeof(h));
+    h.user = this;
+    h.start_object = startObject;
+    h.end_object = end;
+    h.start_array = startArray;
+    h.end_array = end;
+    h.key = key;
+    h.string = string;
+    h.number = number;
+    h.integer = integer;
+    h.boolean = boolean;
+    h.null = null;
+    return h;
+  }
+
+private:
+  // where the value that is starting goes; optionals are seen through
+  // unless it is a null
+  Target take(bool is_null)
+  {
+    Target t = next_;
+    if (!stack_.empty() && stack_.back().binder->element) t = stack_.back().binder->element(stack_.back().obj);
+    while (!is_null && t.binder->unwrap) t = t.binder->unwrap(t.obj);
+    return t;
+  }
+
+  int fail()
+  {
+    failed_ = true;
+    return JSON_EVENT_STOP;
+  }
+
+  static int startObject(void *user)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target t = d->take(false);
+    if (!t.binder->member) return d->fail();
+
+    d->stack_.push_back(t);
+    return JSON_EVENT_CONTINUE;
+  }
+
+  static int startArray(void *user)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target t = d->take(false);
+    if (!t.binder->element) return d->fail();
+
+    t.binder->clear(t.obj);
+    d->stack_.push_back(t);
+    return JSON_EVENT_CONTINUE;
+  }
+
+  static int end(void *user)
+  {
+    static_cast<Decoder *>(user)->stack_.pop_back();
+    return JSON_EVENT_CONTINUE;
+  }
+
+  // fields the struct doesn't have are skipped over without being decoded
+  static int key(void *user, Json_String name)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target &top = d->stack_.back();
+    return (top.binder->member(top.obj, view(name), &d->next_))? JSON_EVENT_CONTINUE : JSON_EVENT_SKIP;
+  }
+
+  static int string(void *user, Json_String val)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target t = d->take(false);
+    return (t.binder->string && t.binder->string(t.obj, view(val)))? JSON_EVENT_CONTINUE : d->fail();
+  }
+
+  static int number(void *user, Json_Number val)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target t = d->take(false);
+    return (t.binder->number && t.binder->number(t.obj, val))? JSON_EVENT_CONTINUE : d->fail();
+  }
+
+  static int integer(void *user, Json_Integer val)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target t = d->take(false);
+    return (t.binder->integer && t.binder->integer(t.obj, val))? JSON_EVENT_CONTINUE : d->fail();
+  }
+
+  static int boolean(void *user, Json_Boolean val)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target t = d->take(false);
+    return (t.binder->boolean && t.binder->boolean(t.obj, val != JSON_FALSE))? JSON_EVENT_CONTINUE : d->fail();
+  }
+
+  // null resets an optional and leaves anything else as it was
+  static int null(void *user)
+  {
+    Decoder *d = static_cast<Decoder *>(user);
+    const Target t = d->take(true);
+    if (t.binder->null) t.binder->null(t.obj);
+    return JSON_EVENT_CONTINUE;
+  }
+
+  std::vector<Target> stack_;
+  Target next_;
+  bool failed_;
+};
+
+inline void encodeRaw(Json_Sink *sink, std::string_view text)
+{
+  Json_sinkWrite(sink, text.data(), text.size());
+}
+
+template <class T>
+void encodeValue(Json_Sink *sink, const T &val);
+
+template <class T>
+void encodeContainer(Json_Sink *sink, const std::optional<T> &val);
+
+template <class T>
+void encodeContainer(Json_Sink *sink, const std::vector<T> &val);
+
+template <class T, class M>
+void encodeMember(Json_Sink *sink, const T &obj, const Field<T, M> &f, bool &first)
+{
+  if (!first) encodeRaw(sink, ",");
+  first = false;
+
+  if (f.plain) {
+    encodeRaw(sink, "\"");
+    encodeRaw(sink, f.name);
+    encodeRaw(sink, "\":");
+  } else {
+    Json_serializeString(borrow(f.name), 0, sink);
+    encodeRaw(sink, ":");
+  }
+
+  encodeValue(sink, obj.*f.member);
+}
+
+template <class T>
+void encodeValue(Json_Sink *sink, const T &val)
+{
+  if (sink->failed) return;
+
+  if constexpr (std::is_same_v<T, bool>) {
+    encodeRaw(sink, (val)? "true" : "false");
+  } else if constexpr (std::is_integral_v<T>) {
+    char num[JSON_NUMBER_BUFSZ];
+    const auto res = std::to_chars(num, num + sizeof(num), val);
+    Json_sinkWrite(sink, num, static_cast<size_t>(res.ptr - num));
+  } else if constexpr (std::is_floating_point_v<T>) {
+    // like Json_serialize, non-finite values go out as strings
+    char num[JSON_NUMBER_BUFSZ];
+    const size_t len = Json_formatNumber(num, static_cast<Json_Number>(val));
+    if (std::isfinite(val)) Json_sinkWrite(sink, num, len);
+    else Json_serializeString(borrow(std::string_view(num, len)), 0, sink);
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    Json_serializeString(borrow(val), 0, sink);
+  } else if constexpr (HasFields<T>::value) {
+    bool first = true;
+    encodeRaw(sink, "{");
+    std::apply([&](const auto &...list) { (encodeMember(sink, val, list, first), ...); }, T::jsonFields);
+    encodeRaw(sink, "}");
+  } else {
+    encodeContainer(sink, val);
+  }
+}
+
+template <class T>
+void encodeContainer(Json_Sink *sink, const std::optional<T> &val)
+{
+  if (val) encodeValue(sink, *val);
+  else encodeRaw(sink, "null");
+}
+
+template <class T>
+void encodeContainer(Json_Sink *sink, const std::vector<T> &val)
+{
+  encodeRaw(sink, "[");
+  for (size_t i = 0; i < val.size(); ++i) {
+    if (i) encodeRaw(sink, ",");
+    encodeValue(sink, static_cast<const T &>(val[i]));
+  }
+  encodeRaw(sink, "]");
+}
+
+} // namespace detail
+
+// fills out from exactly one json value, skipping unknown fields; false for
+// malformed text or values that don't fit, with out maybe partly filled
+template <class T>
+bool decode(std::string_view text, T &out)
+{
+  detail::Decoder decoder(detail::Target{&out, detail::binderOf<T>});
+  const Json_EventHandler handler = decoder.handler();
+  const size_t len = Json_parseEvents(text.size(), text.data(), &handler);
+  return !decoder.failed() && len && len == text.size();
+}
+
+// writes val as compact json; callback sinks are flushed before returning,
+// and false means a write or allocation failed
+template <class T>
+bool encode(const T &val, Json_Sink *sink)
+{
+  detail::encodeValue(sink, val);
+  return Json_sinkFlush(sink) != JSON_FALSE;
+}
+
+template <class T>
+std::string encode(const T &val)
+{
+  std::string out;
+  Json_Sink sink;
+  Json_sinkInit(&sink, appendString, &out);
+  const bool ok = encode(val, &sink);
+  Json_sinkDestroy(&sink);
+  if (!ok) throw std::bad_alloc();
+  return out;
+}
+
+} // namespace json
+
+#endif // !JSON_HPP_
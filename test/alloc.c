@@ -0,0 +1,189 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+// a per-parse allocator that counts its live blocks and can be made to fail
+typedef struct {
+  long live;
+  long calls;
+  long fail_after; // 0 never fails
+} Test__Pool;
+
+static
+void *Test__poolAlloc(void *user, size_t sz)
+{
+  Test__Pool *pool = (Test__Pool *)user;
+  const long calls = __atomic_add_fetch(&pool->calls, 1, __ATOMIC_RELAXED);
+  if (pool->fail_after && calls > pool->fail_after) return NULL;
+
+  void *ptr = malloc(sz);
+  if (ptr) __atomic_add_fetch(&pool->live, 1, __ATOMIC_RELAXED);
+  return ptr;
+}
+
+static
+void *Test__poolResize(void *user, void *ptr, size_t sz)
+{
+  Test__Pool *pool = (Test__Pool *)user;
+  const long calls = __atomic_add_fetch(&pool->calls, 1, __ATOMIC_RELAXED);
+  if (pool->fail_after && calls > pool->fail_after) return NULL;
+  return realloc(ptr, sz);
+}
+
+static
+void Test__poolRelease(void *user, void *ptr)
+{
+  Test__Pool *pool = (Test__Pool *)user;
+  __atomic_sub_fetch(&pool->live, 1, __ATOMIC_RELAXED);
+  free(ptr);
+}
+
+static const char Test__doc[] =
+  "{\"name\":\"esc\\u00e9aped\",\"list\":[1,2.5,true,null,\"s\\n\",[],{}],"
+  "\"nested\":{\"a\":{\"b\":[{\"c\":\"d\\t\"}]}}}";
+
+// values in Test__doc, counting the document itself
+#define TEST__DOC_NODES 15
+
+void Test_alloc(void)
+{
+  const long live = Test_liveAllocs();
+
+  Test__Pool pool;
+  memset(&pool, 0, sizeof(pool));
+  const Json_Allocator allocator = {Test__poolAlloc, Test__poolResize, Test__poolRelease, &pool};
+
+  Json_Stats stats;
+  memset(&stats, 0, sizeof(stats));
+
+  Json_ParseOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.allocator = &allocator;
+  opts.stats = &stats;
+
+  // everything comes from the parse's allocator, nothing from the global one
+  Json_Value value;
+  TEST_CHECK(Json_parseStrEx(sizeof(Test__doc) - 1, Test__doc, &value, &opts) == sizeof(Test__doc) - 1);
+  TEST_CHECK(pool.live > 0 && Test_liveAllocs() == live);
+  TEST_CHECK(Test_sameText(&value, Test__doc));
+  TEST_CHECK(Test_liveAllocs() == live);
+
+  TEST_CHECK(stats.nodes == TEST__DOC_NODES);
+  TEST_CHECK(stats.allocs > 0 && stats.allocs <= (size_t)pool.calls);
+  TEST_CHECK(stats.bytes >= stats.live_bytes && stats.live_bytes > 0);
+  TEST_CHECK(stats.peak_bytes >= stats.live_bytes);
+  TEST_CHECK(stats.seconds >= 0.0);
+
+  Json_destroyValueWith(&value, &allocator);
+  TEST_CHECK(pool.live == 0);
+
+  // the counters add up over calls
+  const Json_Stats first = stats;
+  TEST_CHECK(Json_parseStrEx(sizeof(Test__doc) - 1, Test__doc, &value, &opts) == sizeof(Test__doc) - 1);
+  TEST_CHECK(stats.nodes == 2 * first.nodes && stats.allocs == 2 * first.allocs && stats.bytes == 2 * first.bytes);
+  Json_destroyValueWith(&value, &allocator);
+  TEST_CHECK(pool.live == 0);
+
+  // arena parses count what they take from the arena, and the value holds
+  // nothing from the allocator
+  Json_Arena arena;
+  Json_arenaInit(&arena, 0);
+  memset(&stats, 0, sizeof(stats));
+  opts.arena = &arena;
+  TEST_CHECK(Json_parseStrEx(sizeof(Test__doc) - 1, Test__doc, &value, &opts) == sizeof(Test__doc) - 1);
+  TEST_CHECK(stats.nodes == TEST__DOC_NODES && stats.allocs > 0 && stats.live_bytes > 0);
+  TEST_CHECK(pool.live == 0 && Test_sameText(&value, Test__doc));
+  Json_arenaDestroy(&arena);
+  opts.arena = NULL;
+
+  // a failing allocator fails the parse without leaking, and leaves out null
+  for (long n = 1; n < 64; ++n) {
+    pool.calls = 0;
+    pool.fail_after = n;
+    const size_t used = Json_parseStrEx(sizeof(Test__doc) - 1, Test__doc, &value, &opts);
+    if (used) {
+      TEST_CHECK(used == sizeof(Test__doc) - 1 && Test_sameText(&value, Test__doc));
+      Json_destroyValueWith(&value, &allocator);
+    } else {
+      TEST_CHECK(value.type == JSON_TYPE_NULL);
+    }
+    TEST_CHECK(pool.live == 0);
+  }
+
+  // a string that can't be copied fails the push parser too; the token buffer
+  // takes the first call
+  static const char escaped[] = "\"esc\\u00e9aped\" ";
+  Json_Parser parser;
+  pool.calls = 0;
+  pool.fail_after = 1;
+  Json_parserInit(&parser, &opts);
+  TEST_CHECK(!Json_parserFeed(&parser, escaped, sizeof(escaped) - 1));
+  TEST_CHECK(!Json_parserFinish(&parser, &value));
+  Json_parserDestroy(&parser);
+  TEST_CHECK(pool.live == 0);
+
+  // and a container that can't grow fails it rather than dropping the child
+  for (long n = 1; n < 64; ++n) {
+    pool.calls = 0;
+    pool.fail_after = n;
+    Json_parserInit(&parser, &opts);
+    Json_Boolean ok = JSON_TRUE;
+    for (size_t i = 0; ok && i < sizeof(Test__doc) - 1; i += 7) {
+      const size_t left = sizeof(Test__doc) - 1 - i;
+      ok = Json_parserFeed(&parser, &Test__doc[i], (left < 7)? left : 7);
+    }
+
+    if (ok && Json_parserFinish(&parser, &value)) {
+      TEST_CHECK(Test_sameText(&value, Test__doc));
+      Json_destroyValueWith(&value, &allocator);
+    }
+    Json_parserDestroy(&parser);
+    TEST_CHECK(pool.live == 0);
+  }
+  pool.fail_after = 0;
+
+  // parallel parses call it from every worker
+  Json_ParallelOptions parallel;
+  memset(&parallel, 0, sizeof(parallel));
+  parallel.nthreads = 4;
+  parallel.parse.allocator = &allocator;
+
+  char big[64 * 1024];
+  size_t len = 0;
+  len += (size_t)sprintf(&big[len], "[");
+  for (int i = 0; i < 1000; ++i) len += (size_t)sprintf(&big[len], "%s{\"k\":\"v\\\"%d\",\"n\":[%d]}", (i)? "," : "", i, i);
+  len += (size_t)sprintf(&big[len], "]");
+
+  TEST_CHECK(Json_parseStrParallel(len, big, &value, &parallel) == len);
+  TEST_CHECK(value.v.as_array.len == 1000 && pool.live > 1000 && Test_liveAllocs() == live);
+  Json_destroyValueWith(&value, &allocator);
+  TEST_CHECK(pool.live == 0);
+
+  for (long n = 1; n < 4000; n += 397) {
+    pool.calls = 0;
+    pool.fail_after = n;
+    const size_t used = Json_parseStrParallel(len, big, &value, &parallel);
+    if (used) {
+      TEST_CHECK(used == len && value.v.as_array.len == 1000);
+      Json_destroyValueWith(&value, &allocator);
+    }
+    TEST_CHECK(pool.live == 0);
+  }
+  pool.fail_after = 0;
+
+  // writes count the values they wrote
+  Json_WriteOptions write;
+  memset(&write, 0, sizeof(write));
+  memset(&stats, 0, sizeof(stats));
+  write.stats = &stats;
+
+  Json_Sink sink;
+  TEST_CHECK(Test_parse(Test__doc, &value));
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_serialize(&value, &write, &sink));
+  TEST_CHECK(stats.nodes == TEST__DOC_NODES && stats.seconds >= 0.0);
+  Json_sinkDestroy(&sink);
+  Json_destroyValue(&value);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,64 @@
+#include "test.h"
+
+#include <stdint.h>
+
+static const char Test__doc[] =
+  "{\"name\":\"arena\",\"list\":[1,2.5,\"three\",{\"x\":null,\"y\":[]}],\"esc\":\"a\\nb\\u00e9\"}";
+
+void Test_arena(void)
+{
+  const size_t len = sizeof(Test__doc) - 1;
+  const long live = Test_liveAllocs();
+
+  Json_Arena arena;
+  Json_arenaInit(&arena, 256);
+
+  Json_Value value;
+  TEST_CHECK(Json_parseStrArena(&arena, len, Test__doc, &value) == len);
+  TEST_CHECK(Test_sameText(&value, Test__doc));
+
+  // a reset keeps every block, so the same document fits again without allocating
+  const long blocks = Test_liveAllocs() - live;
+  TEST_CHECK(blocks > 0);
+
+  for (int i = 0; i < 4; ++i) {
+    Json_arenaReset(&arena);
+    TEST_CHECK(Json_parseStrArena(&arena, len, Test__doc, &value) == len);
+    TEST_CHECK(Test_sameText(&value, Test__doc));
+    TEST_CHECK(Test_liveAllocs() - live == blocks);
+  }
+
+  // allocations bigger than a block get one of their own, which is reused too
+  Json_arenaReset(&arena);
+  void *small = Json_arenaAlloc(&arena, 24);
+  void *big = Json_arenaAlloc(&arena, 1000);
+  TEST_CHECK(small && big);
+  TEST_CHECK((uintptr_t)small % 16 == 0 && (uintptr_t)big % 16 == 0);
+  if (big) memset(big, 0xab, 1000);
+
+  const long grown = Test_liveAllocs();
+  Json_arenaReset(&arena);
+  TEST_CHECK(Json_arenaAlloc(&arena, 24) == small);
+  TEST_CHECK(Json_arenaAlloc(&arena, 1000) == big);
+  TEST_CHECK(Test_liveAllocs() == grown);
+
+  // a failed parse leaves out null, and so does a missing arena
+  Json_arenaReset(&arena);
+  TEST_CHECK(Json_parseStrArena(&arena, 9, "[1, 2, {]", &value) == 0);
+  TEST_CHECK(value.type == JSON_TYPE_NULL);
+  TEST_CHECK(Json_parseStrArena(NULL, len, Test__doc, &value) == 0);
+  TEST_CHECK(value.type == JSON_TYPE_NULL);
+
+  FILE *file = tmpfile();
+  TEST_CHECK(file != NULL);
+  if (file) {
+    fputs(Test__doc, file);
+    rewind(file);
+    TEST_CHECK(Json_parseFileArena(&arena, file, &value) == len);
+    TEST_CHECK(Test_sameText(&value, Test__doc));
+    fclose(file);
+  }
+
+  Json_arenaDestroy(&arena);
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,187 @@
+#include "test.h"
+
+#define TEST__PATH "test_binary.tmp"
+
+static
+Json_Boolean Test__sameTape(const Json_Tape *a, const Json_Tape *b)
+{
+  return a->len == b->len && !memcmp(a->words, b->words, a->len * sizeof(a->words[0]))
+    && a->strings_len == b->strings_len && (!a->strings_len || !memcmp(a->strings, b->strings, a->strings_len));
+}
+
+static
+Json_Boolean Test__writeFile(const void *data, size_t len)
+{
+  FILE *file = fopen(TEST__PATH, "wb");
+  if (!file) return JSON_FALSE;
+
+  const Json_Boolean ok = fwrite(data, 1, len, file) == len;
+  return !fclose(file) && ok;
+}
+
+// reads every node under ref, returning how many there are
+static
+size_t Test__walk(Json_TapeRef ref)
+{
+  size_t nodes = 1;
+  Json_Value tmp;
+  const Json_String str = Json_tapeStr(ref, JSON_STRLIT(""));
+  if (str.is_heap) Json_destroyValue(Json_asValue(&tmp, JSON_TYPE_STRING, str));
+
+  Json_TapeIter iter;
+  Json_TapeRef child;
+  Json_String key;
+  if (Json_tapeLen(ref)) Json_tapeAt(ref, Json_tapeLen(ref) - 1, &child);
+  if (Json_tapeIter(ref, &iter)) {
+    while (Json_tapeNext(&iter, &key, &child)) nodes += Test__walk(child);
+  }
+
+  return nodes;
+}
+
+// saving the value and saving its parsed tape give the same file, which
+// loads back as that tape
+static
+void Test__roundTrip(const char *text)
+{
+  const size_t len = strlen(text);
+  Json_Value value;
+  Json_Tape tape;
+  TEST_CHECK(Json_parseStr(len, text, &value) == len);
+  TEST_CHECK(Json_parseTape(len, text, &tape) == len);
+
+  FILE *file = fopen(TEST__PATH, "wb");
+  TEST_CHECK(file != NULL);
+  if (!file) return;
+  TEST_CHECK(Json_saveBinary(file, &value));
+  const long from_value = ftell(file);
+  TEST_CHECK(Json_saveTape(file, &tape));
+  TEST_CHECK(ftell(file) == 2 * from_value);
+  fclose(file);
+
+  // two copies back to back don't make one valid file
+  Json_Binary binary;
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+
+  file = fopen(TEST__PATH, "wb");
+  TEST_CHECK(file && Json_saveTape(file, &tape));
+  if (file) fclose(file);
+
+  TEST_CHECK(Json_loadBinary(TEST__PATH, &binary));
+  TEST_CHECK(Test__sameTape(&binary.tape, &tape));
+  TEST_CHECK(Json_tapeType(Json_tapeRoot(&binary.tape)) == value.type);
+  Json_unloadBinary(&binary);
+  TEST_CHECK(binary.tape.words == NULL);
+
+  Json_destroyTape(&tape);
+  Json_destroyValue(&value);
+}
+
+void Test_binary(void)
+{
+  const long live = Test_liveAllocs();
+
+  Test__roundTrip("{\"a\":[1,-2.5e-3,\"x\\u00e9\\n\",true,false,null],\"b\":{},\"c\":[]}");
+  Test__roundTrip("[[[]],[{}],{\"k\":{\"k\":[\"\\\"]\",\"\"]}}]");
+  Test__roundTrip("\"top level\"");
+  Test__roundTrip("-9223372036854775808");
+  Test__roundTrip("null");
+
+  // what was saved reads back through the tape getters
+  static const char doc[] = "{\"id\":42,\"name\":\"ann\",\"score\":9.5,\"tags\":[\"x\",\"y\"]}";
+  Json_Value value;
+  TEST_CHECK(Test_parse(doc, &value));
+  FILE *file = fopen(TEST__PATH, "wb");
+  TEST_CHECK(file && Json_saveBinary(file, &value));
+  if (file) fclose(file);
+  Json_destroyValue(&value);
+
+  Json_Binary binary;
+  Json_TapeRef tags, tag;
+  TEST_CHECK(Json_loadBinary(TEST__PATH, &binary));
+  const Json_TapeRef root = Json_tapeRoot(&binary.tape);
+  TEST_CHECK(Json_tapeGetInt(root, JSON_STRLIT("id"), -1) == 42);
+  TEST_CHECK(Json_tapeGetNum(root, JSON_STRLIT("score"), -1.0) == 9.5);
+  TEST_CHECK(!Json_stringCmp(Json_tapeGetStr(root, JSON_STRLIT("name"), JSON_STRLIT("")), JSON_STRLIT("ann")));
+  TEST_CHECK(Json_tapeGet(root, JSON_STRLIT("tags"), &tags) && Json_tapeLen(tags) == 2);
+  TEST_CHECK(Json_tapeAt(tags, 1, &tag) && !Json_stringCmp(Json_tapeStr(tag, JSON_STRLIT("")), JSON_STRLIT("y")));
+  Json_unloadBinary(&binary);
+
+  // files that aren't saved tapes don't load
+  static const char json_text[] = "{\"not\":\"a tape file\",\"padding\":\"...........\"}";
+  TEST_CHECK(Test__writeFile(json_text, sizeof(json_text) - 1));
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+  TEST_CHECK(Test__writeFile("jsontape", 8));
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+
+  unsigned long long hdr[5];
+  memcpy(&hdr[0], "jsontape", 8);
+  hdr[1] = 2;
+  hdr[2] = 1;
+  hdr[3] = 0;
+  hdr[4] = 0;
+  TEST_CHECK(Test__writeFile(hdr, sizeof(hdr)));
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+  TEST_CHECK(!Json_loadBinary("test_binary_missing.tmp", &binary));
+
+  // nor do truncated ones
+  Json_Tape tape;
+  TEST_CHECK(Json_parseTape(sizeof(doc) - 1, doc, &tape) == sizeof(doc) - 1);
+  file = fopen(TEST__PATH, "wb");
+  TEST_CHECK(file && Json_saveTape(file, &tape));
+  if (file) fclose(file);
+  TEST_CHECK(Json_loadBinary(TEST__PATH, &binary));
+  Json_unloadBinary(&binary);
+
+  file = fopen(TEST__PATH, "rb");
+  char saved[1024];
+  const size_t saved_len = (file)? fread(saved, 1, sizeof(saved), file) : 0;
+  if (file) fclose(file);
+  TEST_CHECK(saved_len > 40 && saved_len < sizeof(saved));
+  TEST_CHECK(Test__writeFile(saved, saved_len - 1));
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+
+  // or corrupt ones: a key past the strings, a string running off their end
+  // and a container ending past the tape
+  unsigned long long word;
+  char bad[1024];
+  memcpy(bad, saved, saved_len);
+  memcpy(&word, &bad[32 + 2 * 8], 8);
+  word |= 0x0000ffffffffffffull;
+  memcpy(&bad[32 + 2 * 8], &word, 8);
+  TEST_CHECK(Test__writeFile(bad, saved_len));
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+
+  memcpy(bad, saved, saved_len);
+  memset(&bad[32 + tape.len * 8], 0x7f, 8);
+  TEST_CHECK(Test__writeFile(bad, saved_len));
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+
+  memcpy(bad, saved, saved_len);
+  memcpy(&word, &bad[32], 8);
+  ++word;
+  memcpy(&bad[32], &word, 8);
+  TEST_CHECK(Test__writeFile(bad, saved_len));
+  TEST_CHECK(!Json_loadBinary(TEST__PATH, &binary));
+
+  // whatever a word is changed to, what still loads reads in bounds
+  static const char kinds[] = {'[', '{', '"', 'l', 'd', 'n'};
+  for (size_t i = 0; i < tape.len; ++i) {
+    for (size_t t = 0; t < sizeof(kinds); ++t) {
+      for (unsigned long long payload = 0; payload < tape.len + 2; ++payload) {
+        memcpy(bad, saved, saved_len);
+        word = ((unsigned long long)(unsigned char)kinds[t] << 56) | payload;
+        memcpy(&bad[32 + i * 8], &word, 8);
+        TEST_CHECK(Test__writeFile(bad, saved_len));
+        if (!Json_loadBinary(TEST__PATH, &binary)) continue;
+
+        TEST_CHECK(Test__walk(Json_tapeRoot(&binary.tape)) <= binary.tape.len);
+        Json_unloadBinary(&binary);
+      }
+    }
+  }
+  Json_destroyTape(&tape);
+
+  remove(TEST__PATH);
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,91 @@
+#include "test.h"
+
+static const char Test__doc[] =
+  "{\"plain\":\"abc\",\"esc\":\"x\\\"y\",\"list\":[\"one\",\"two\\n\",\"\"]}";
+
+static
+Json_Boolean Test__inside(Json_String str, const char *buffer, size_t len)
+{
+  return !str.is_heap && str.data >= buffer && str.data + str.len <= buffer + len;
+}
+
+static
+void Test__checkBorrowed(const Json_Value *value, const char *buffer, size_t len)
+{
+  TEST_CHECK(value->type == JSON_TYPE_OBJECT && value->v.as_object.len == 3);
+  if (value->type != JSON_TYPE_OBJECT || value->v.as_object.len != 3) return;
+
+  const Json_Object *object = &value->v.as_object;
+  TEST_CHECK(Test__inside(object->field_names[0], buffer, len));
+  TEST_CHECK(Test__inside(object->field_values[0].v.as_string, buffer, len));
+
+  // escaped strings are decoded somewhere else
+  const Json_String esc = object->field_values[1].v.as_string;
+  TEST_CHECK(esc.len == 3 && memcmp(esc.data, "x\"y", 3) == 0);
+  TEST_CHECK(!(esc.data >= buffer && esc.data < buffer + len));
+
+  const Json_Array *list = &object->field_values[2].v.as_array;
+  TEST_CHECK(list->len == 3);
+  if (list->len == 3) {
+    TEST_CHECK(Test__inside(list->elems[0].v.as_string, buffer, len));
+    TEST_CHECK(list->elems[1].v.as_string.len == 4);
+    TEST_CHECK(list->elems[2].v.as_string.len == 0);
+  }
+}
+
+void Test_borrow(void)
+{
+  const size_t len = sizeof(Test__doc) - 1;
+  const long live = Test_liveAllocs();
+
+  Json_ParseOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.flags = JSON_PARSE_BORROW;
+
+  // borrowed strings read the buffer, so they see it change
+  char buffer[sizeof(Test__doc)];
+  memcpy(buffer, Test__doc, sizeof(Test__doc));
+
+  Json_Value value;
+  TEST_CHECK(Json_parseStrEx(len, buffer, &value, &opts) == len);
+  Test__checkBorrowed(&value, buffer, len);
+  buffer[10] = 'X';
+  TEST_CHECK(Json_objectGet(&value, JSON_STRLIT("plain"))->v.as_string.data[0] == 'X');
+
+  // borrowed values are changed and destroyed like any other
+  Json_objectSetStr(&value, JSON_STRLIT("more"), Json_stringDup(JSON_STRLIT("heap")));
+  TEST_CHECK(Test_sameText(&value,
+    "{\"plain\":\"Xbc\",\"esc\":\"x\\\"y\",\"list\":[\"one\",\"two\\n\",\"\"],\"more\":\"heap\"}"));
+  Json_destroyValue(&value);
+  TEST_CHECK(Test_liveAllocs() == live);
+
+  Json_Arena arena;
+  Json_arenaInit(&arena, 0);
+  opts.arena = &arena;
+  TEST_CHECK(Json_parseStrEx(len, buffer, &value, &opts) == len);
+  Test__checkBorrowed(&value, buffer, len);
+  Json_arenaDestroy(&arena);
+
+  // a file has no buffer that outlives the call, so only an arena can keep one
+  FILE *file = tmpfile();
+  TEST_CHECK(file != NULL);
+  if (!file) return;
+  fputs(Test__doc, file);
+
+  opts.arena = NULL;
+  rewind(file);
+  TEST_CHECK(Json_parseFileEx(file, &value, &opts) == len);
+  TEST_CHECK(Json_objectGet(&value, JSON_STRLIT("plain"))->v.as_string.is_heap);
+  TEST_CHECK(Test_sameText(&value, Test__doc));
+  Json_destroyValue(&value);
+
+  Json_arenaInit(&arena, 0);
+  opts.arena = &arena;
+  rewind(file);
+  TEST_CHECK(Json_parseFileEx(file, &value, &opts) == len);
+  fclose(file);
+  TEST_CHECK(Test_sameText(&value, Test__doc));
+  Json_arenaDestroy(&arena);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
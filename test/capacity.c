@@ -0,0 +1,101 @@
+#include "test.h"
+
+// every container in value holds exactly as many members as it has
+static
+Json_Boolean Test__exact(const Json_Value *value)
+{
+  switch (value->type) {
+    case JSON_TYPE_ARRAY:
+      if (value->v.as_array.cap != value->v.as_array.len) return JSON_FALSE;
+      for (size_t i = 0; i < value->v.as_array.len; ++i) {
+        if (!Test__exact(&value->v.as_array.elems[i])) return JSON_FALSE;
+      }
+      return JSON_TRUE;
+
+    case JSON_TYPE_OBJECT:
+      if (value->v.as_object.cap != value->v.as_object.len) return JSON_FALSE;
+      for (size_t i = 0; i < value->v.as_object.len; ++i) {
+        if (!Test__exact(&value->v.as_object.field_values[i])) return JSON_FALSE;
+      }
+      return JSON_TRUE;
+
+    default: return JSON_TRUE;
+  }
+}
+
+void Test_capacity(void)
+{
+  const long live = Test_liveAllocs();
+
+  static const char doc[] =
+    "{\"a\":[1,2,3],\"b\":[],\"c\":{},\"d\":[[1],[1,2],{\"x\":[true,false,null,1,2,3,4,5,6,7,8,9]}],"
+    "\"e\":{\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,"
+    "\"k10\":10,\"k11\":11,\"k12\":12,\"k13\":13,\"k14\":14,\"k15\":15,\"k16\":16,\"k17\":17}}";
+
+  Json_Value value;
+  TEST_CHECK(Test_parse(doc, &value));
+  TEST_CHECK(Test__exact(&value));
+
+  // exact containers still grow, and shrink back
+  Json_Value *a = Json_objectGet(&value, JSON_STRLIT("a"));
+  Json_Value num;
+  Json_arrayAppend(a, Json_asValue(&num, JSON_TYPE_INTEGER, (Json_Integer)4));
+  TEST_CHECK(a->v.as_array.len == 4 && a->v.as_array.cap >= 4);
+  Json_arrayShrink(a);
+  TEST_CHECK(a->v.as_array.cap == 4);
+
+  Json_Value *e = Json_objectGet(&value, JSON_STRLIT("e"));
+  Json_objectSetInt(e, JSON_STRLIT("k18"), 18);
+  Json_objectShrink(e);
+  TEST_CHECK(e->v.as_object.cap == 19 && Json_objectGetInt(e, JSON_STRLIT("k17"), -1) == 17);
+  TEST_CHECK(Test__exact(&value));
+  TEST_CHECK(Test_sameText(a, "[1,2,3,4]"));
+  Json_destroyValue(&value);
+
+  // so do arena documents
+  Json_Arena arena;
+  Json_arenaInit(&arena, 0);
+  TEST_CHECK(Json_parseStrArena(&arena, sizeof(doc) - 1, doc, &value) == sizeof(doc) - 1);
+  TEST_CHECK(Test__exact(&value));
+  Json_arenaDestroy(&arena);
+
+  // reserved room is used without moving the storage
+  Json_Value array;
+  memset(&array, 0, sizeof(array));
+  array.type = JSON_TYPE_ARRAY;
+  TEST_CHECK(Json_arrayReserve(&array, 1000));
+  TEST_CHECK(array.v.as_array.cap >= 1000);
+
+  const Json_Value *elems = array.v.as_array.elems;
+  for (int i = 0; i < 1000; ++i) Json_arrayAppend(&array, Json_asValue(&num, JSON_TYPE_INTEGER, (Json_Integer)i));
+  TEST_CHECK(array.v.as_array.elems == elems && array.v.as_array.len == 1000);
+
+  Json_arrayAppend(&array, &num);
+  TEST_CHECK(array.v.as_array.len == 1001 && array.v.as_array.cap > 1001);
+  Json_arrayShrink(&array);
+  TEST_CHECK(array.v.as_array.cap == 1001);
+  Json_destroyValue(&array);
+
+  Json_Value object;
+  memset(&object, 0, sizeof(object));
+  object.type = JSON_TYPE_OBJECT;
+  TEST_CHECK(Json_objectReserve(&object, 40));
+  TEST_CHECK(object.v.as_object.cap >= 40);
+
+  char name[16];
+  const Json_String *names = object.v.as_object.field_names;
+  for (int i = 0; i < 40; ++i) {
+    Json_String field;
+    field.is_heap = JSON_FALSE;
+    field.len = (size_t)sprintf(name, "f%d", i);
+    field.data = name;
+    Json_objectSetInt(&object, Json_stringDup(field), i);
+  }
+  TEST_CHECK(object.v.as_object.field_names == names && object.v.as_object.len == 40);
+  TEST_CHECK(Json_objectGetInt(&object, JSON_STRLIT("f39"), -1) == 39);
+  Json_objectShrink(&object);
+  TEST_CHECK(object.v.as_object.cap == 40 && Json_objectGetInt(&object, JSON_STRLIT("f0"), -1) == 0);
+  Json_destroyValue(&object);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,192 @@
+#include "test.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace test {
+
+struct Owner {
+  std::string name;
+  std::uint8_t level = 0;
+
+  static constexpr auto jsonFields = json::fields(
+    JSON_FIELD(Owner, name), JSON_FIELD(Owner, level)
+  );
+};
+
+struct Route {
+  std::string path;
+  int weight = 1;
+  double ratio = 0.0;
+  bool enabled = false;
+  std::optional<std::string> note;
+  std::optional<Owner> owner;
+  std::vector<std::string> tags;
+  std::vector<std::vector<long long>> grid;
+  std::vector<Owner> backups;
+
+  static constexpr auto jsonFields = json::fields(
+    JSON_FIELD(Route, path), JSON_FIELD(Route, weight), JSON_FIELD(Route, ratio),
+    JSON_FIELD(Route, enabled), JSON_FIELD(Route, note), JSON_FIELD(Route, owner),
+    JSON_FIELD(Route, tags), JSON_FIELD(Route, grid), JSON_FIELD(Route, backups)
+  );
+};
+
+// names that have to be escaped on the way out
+struct Odd {
+  int slash = 0;
+  int quote = 0;
+
+  static constexpr auto jsonFields = json::fields(
+    json::field("a/b", &Odd::slash), json::field("say \"hi\"", &Odd::quote)
+  );
+};
+
+static void roundTrips()
+{
+  static const char text[] =
+    "{\"path\":\"/api/\\u00e9\\n\",\"weight\":-7,\"ratio\":0.1,\"enabled\":true,\"note\":null,"
+    "\"owner\":{\"name\":\"ann\",\"level\":255},\"tags\":[\"a\",\"\"],\"grid\":[[1,2],[],[-9223372036854775808]],"
+    "\"backups\":[{\"name\":\"bob\",\"level\":1}]}";
+
+  Route route;
+  TEST_CHECK(json::decode(text, route));
+  TEST_CHECK(route.path == "/api/\xc3\xa9\n" && route.weight == -7 && route.ratio == 0.1 && route.enabled);
+  TEST_CHECK(!route.note && route.owner && route.owner->name == "ann" && route.owner->level == 255);
+  TEST_CHECK(route.tags.size() == 2 && route.tags[1].empty());
+  TEST_CHECK(route.grid.size() == 3 && route.grid[0][1] == 2 && route.grid[1].empty());
+  TEST_CHECK(route.grid[2][0] == -9223372036854775807ll - 1);
+  TEST_CHECK(route.backups.size() == 1 && route.backups[0].name == "bob");
+
+  // encoding writes what Json_serialize would for the same tree
+  const std::string encoded = json::encode(route);
+  json::Value tree;
+  TEST_CHECK(json::parse(text, tree));
+  TEST_CHECK(same(encoded, tree.dump()));
+
+  Route again;
+  TEST_CHECK(json::decode(encoded, again));
+  TEST_CHECK(same(json::encode(again), encoded));
+
+  // doubles come back exactly
+  std::srand(3);
+  for (int i = 0; i < 2000; ++i) {
+    unsigned long long bits = 0;
+    for (int j = 0; j < 4; ++j) bits = (bits << 16) ^ static_cast<unsigned long long>(std::rand() & 0xffff);
+
+    double val;
+    std::memcpy(&val, &bits, sizeof(val));
+    if (!std::isfinite(val)) continue;
+
+    Route in, out;
+    in.ratio = val;
+    TEST_CHECK(json::decode(json::encode(in), out));
+    TEST_CHECK(std::memcmp(&in.ratio, &out.ratio, sizeof(val)) == 0);
+  }
+
+  Odd odd;
+  odd.slash = 1;
+  odd.quote = 2;
+  TEST_CHECK(same(json::encode(odd), "{\"a\\/b\":1,\"say \\\"hi\\\"\":2}"));
+  Odd odd_again;
+  TEST_CHECK(json::decode(json::encode(odd), odd_again) && odd_again.slash == 1 && odd_again.quote == 2);
+
+  // scalars and containers go at the top level too
+  std::vector<std::optional<int>> list;
+  TEST_CHECK(json::decode("[1,null,3]", list) && list.size() == 3 && !list[1] && *list[2] == 3);
+  TEST_CHECK(same(json::encode(list), "[1,null,3]"));
+  TEST_CHECK(same(json::encode(std::string("\x01")), "\"\\u0001\""));
+  TEST_CHECK(same(json::encode(-0.5), "-0.5"));
+}
+
+static void decoding()
+{
+  // unknown fields are skipped whatever they hold, missing ones keep their values
+  Route route;
+  route.weight = 5;
+  route.note = "kept";
+  TEST_CHECK(json::decode("{\"extra\":{\"path\":\"no\",\"x\":[1,{\"y\":[]}]},\"path\":\"yes\",\"more\":[[]]}", route));
+  TEST_CHECK(route.path == "yes" && route.weight == 5 && route.note && *route.note == "kept");
+
+  // null resets optionals and leaves anything else alone
+  TEST_CHECK(json::decode("{\"note\":null,\"weight\":null}", route));
+  TEST_CHECK(!route.note && route.weight == 5);
+
+  // arrays replace what a vector held
+  route.tags = {"x", "y", "z"};
+  TEST_CHECK(json::decode("{\"tags\":[\"only\"]}", route));
+  TEST_CHECK(route.tags.size() == 1 && route.tags[0] == "only");
+
+  // whole numbers fit integers however they are written
+  TEST_CHECK(json::decode("{\"weight\":1e3}", route) && route.weight == 1000);
+  TEST_CHECK(json::decode("{\"ratio\":3}", route) && route.ratio == 3.0);
+
+  // values that don't fit their members fail
+  static const char *const bad[] = {
+    "{\"weight\":\"1\"}",
+    "{\"weight\":1.5}",
+    "{\"weight\":4294967296}",
+    "{\"owner\":{\"level\":256}}",
+    "{\"owner\":{\"level\":-1}}",
+    "{\"path\":1}",
+    "{\"enabled\":1}",
+    "{\"tags\":{}}",
+    "{\"owner\":[]}",
+    "{\"grid\":[1]}",
+    "[]",
+  };
+  for (const char *text : bad) {
+    Route out;
+    TEST_CHECK(!json::decode(text, out));
+  }
+
+  // and so does anything but exactly one value
+  static const char *const malformed[] = {"", "{}{}", "{\"path\":\"x\"", "{\"path\" \"x\"}", "{} x"};
+  for (const char *text : malformed) {
+    Route out;
+    TEST_CHECK(!json::decode(text, out));
+  }
+}
+
+// a sink that fails its writes makes encode fail
+static Json_Boolean refuse(void *, const char *, size_t)
+{
+  return JSON_FALSE;
+}
+
+static void encoding()
+{
+  Route route;
+  route.path = "p";
+  route.tags = {"t"};
+  TEST_CHECK(same(json::encode(route),
+    "{\"path\":\"p\",\"weight\":1,\"ratio\":0,\"enabled\":false,\"note\":null,\"owner\":null,"
+    "\"tags\":[\"t\"],\"grid\":[],\"backups\":[]}"));
+
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(json::encode(route, &sink));
+  TEST_CHECK(same(std::string_view(sink.data, sink.len), json::encode(route)));
+  Json_sinkDestroy(&sink);
+
+  Json_sinkInit(&sink, refuse, nullptr);
+  TEST_CHECK(!json::encode(route, &sink));
+  Json_sinkDestroy(&sink);
+}
+
+void bind()
+{
+  const long live = liveAllocs();
+
+  roundTrips();
+  decoding();
+  encoding();
+
+  TEST_CHECK(liveAllocs() == live);
+}
+
+} // namespace test
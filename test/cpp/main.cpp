@@ -0,0 +1,72 @@
+#define JSON_IMPLEMENTATION 1
+#include "test.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+namespace test {
+
+static long checks;
+static long failures;
+static std::atomic<long> live;
+
+void check(bool ok, const char *file, int line, const char *expr)
+{
+  checks += 1;
+  if (ok) return;
+
+  failures += 1;
+  std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+}
+
+static void *alloc(void *, size_t sz)
+{
+  void *ptr = std::malloc(sz);
+  if (ptr) live += 1;
+  return ptr;
+}
+
+static void *resize(void *, void *ptr, size_t sz)
+{
+  return std::realloc(ptr, sz);
+}
+
+static void release(void *, void *ptr)
+{
+  live -= 1;
+  std::free(ptr);
+}
+
+long liveAllocs()
+{
+  return live;
+}
+
+bool same(std::string_view got, std::string_view want)
+{
+  if (got == want) return true;
+
+  std::fprintf(stderr, "  got:  %.*s\n  want: %.*s\n", static_cast<int>(got.size()), got.data(),
+               static_cast<int>(want.size()), want.data());
+  return false;
+}
+
+} // namespace test
+
+int main()
+{
+  static const Json_Allocator allocator = {test::alloc, test::resize, test::release, nullptr};
+  Json_setAllocator(&allocator);
+
+  test::value();
+  test::bind();
+
+  if (test::failures) {
+    std::fprintf(stderr, "%ld of %ld checks failed\n", test::failures, test::checks);
+    return 1;
+  }
+
+  std::printf("%ld checks passed\n", test::checks);
+  return 0;
+}
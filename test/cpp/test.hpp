@@ -0,0 +1,27 @@
+#ifndef TEST_HPP_
+#define TEST_HPP_ 1
+
+#include "../../json.hpp"
+
+#include <string>
+#include <string_view>
+
+// a failed check is reported and counted, the suite keeps going
+#define TEST_CHECK(cond) test::check(static_cast<bool>(cond), __FILE__, __LINE__, #cond)
+
+namespace test {
+
+void check(bool ok, const char *file, int line, const char *expr);
+
+// blocks currently held through json.h's allocator, for leak checks
+long liveAllocs();
+
+// text and want the same, printing both when they aren't
+bool same(std::string_view got, std::string_view want);
+
+void value();
+void bind();
+
+} // namespace test
+
+#endif // !TEST_HPP_
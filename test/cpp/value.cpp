@@ -0,0 +1,136 @@
+#include "test.hpp"
+
+#include <utility>
+
+namespace test {
+
+static void parsing()
+{
+  json::Value value;
+  TEST_CHECK(json::parse("{\"a\":[1,2.5,\"x\"],\"b\":null}", value));
+  TEST_CHECK(value.type() == json::Type::object && value.size() == 2);
+  TEST_CHECK(same(value.dump(), "{\"a\":[1,2.5,\"x\"],\"b\":null}"));
+
+  // anything but exactly one value is rejected and leaves out null
+  static const char *const bad[] = {"", "   ", "{} x", "[1,2", "1 2", "{\"a\":}", "nul"};
+  for (const char *text : bad) {
+    TEST_CHECK(json::parse("[true]", value));
+    TEST_CHECK(!json::parse(text, value));
+    TEST_CHECK(value.type() == json::Type::null);
+  }
+
+  TEST_CHECK(json::parse(" 7 ", value) && value.view().asInt() == 7);
+
+  // documents are just as strict, and can be moved around
+  json::Document doc;
+  TEST_CHECK(doc.parse("{\"name\":\"ann\",\"ids\":[3,4]}"));
+  TEST_CHECK(doc["name"].asString() == "ann" && doc["ids"][1].asInt() == 4);
+  TEST_CHECK(!doc.parse("{\"name\":\"ann\"} {}"));
+  TEST_CHECK(doc.root().isNull() && !doc["name"]);
+
+  TEST_CHECK(doc.parse("[\"moved\"]"));
+  json::Document moved(std::move(doc));
+  TEST_CHECK(moved[0].asString() == "moved" && doc.root().isNull());
+  doc = std::move(moved);
+  TEST_CHECK(doc[0].asString() == "moved");
+}
+
+static void views()
+{
+  json::Value value;
+  TEST_CHECK(json::parse("{\"b\":true,\"i\":-3,\"n\":2.0,\"f\":2.5,\"s\":\"str\",\"a\":[1,2,3],\"o\":{\"k\":1}}", value));
+
+  const json::View root = value.view();
+  TEST_CHECK(root["b"].asBool() && root["i"].asInt() == -3 && root["i"].asNumber() == -3.0);
+  TEST_CHECK(root["n"].asInt() == 2 && root["f"].asInt(-1) == -1 && root["f"].asNumber() == 2.5);
+  TEST_CHECK(root["s"].asString() == "str" && root["s"].asInt(9) == 9 && root["i"].asString("x") == "x");
+  TEST_CHECK(!root["missing"] && !root["a"]["k"] && !root["a"][3] && !root["o"][0]);
+  TEST_CHECK(root["missing"]["deeper"].asInt(5) == 5);
+  TEST_CHECK(root.contains("o") && !root.contains("O"));
+
+  long long sum = 0;
+  for (json::View elem : root["a"].elements()) sum += elem.asInt();
+  TEST_CHECK(sum == 6 && root["o"].elements().size() == 0);
+
+  std::string keys;
+  for (auto [key, field] : root.members()) {
+    keys += key;
+    TEST_CHECK(field);
+  }
+  TEST_CHECK(same(keys, "binfsao"));
+  TEST_CHECK(root["a"].members().size() == 0);
+}
+
+static void building()
+{
+  json::Value doc(json::object);
+  doc.emplace("name", "ann");
+  doc.emplace("age", 41);
+  doc.emplace("ok", true);
+  doc.emplace("none", nullptr);
+  json::Ref tags = doc.emplace("tags", json::array);
+  tags.emplaceBack("a");
+  tags.emplaceBack(std::string("b"));
+  tags.emplaceBack(1.5);
+  tags.emplaceBack(json::object).emplace("deep", json::Value(json::array));
+  TEST_CHECK(same(doc.dump(), "{\"name\":\"ann\",\"age\":41,\"ok\":true,\"none\":null,\"tags\":[\"a\",\"b\",1.5,{\"deep\":[]}]}"));
+
+  // setting a field again replaces it where it is
+  doc.emplace("age", 42);
+  doc["tags"].erase(size_t(1));
+  doc.erase("none");
+  TEST_CHECK(same(doc.dump(), "{\"name\":\"ann\",\"age\":42,\"ok\":true,\"tags\":[\"a\",1.5,{\"deep\":[]}]}"));
+
+  // values move in and out of the C api without copies
+  Json_Value raw = doc.release();
+  TEST_CHECK(doc.type() == json::Type::null);
+  json::Value back = json::Value::adopt(raw);
+  TEST_CHECK(raw.type == JSON_TYPE_NULL && back["age"].asInt() == 42);
+
+  json::Value moved(std::move(back));
+  TEST_CHECK(back.type() == json::Type::null && moved.size() == 4);
+
+  json::Value list(json::array);
+  list.reserve(100);
+  for (int i = 0; i < 100; ++i) list.emplaceBack(i);
+  list.shrinkToFit();
+  TEST_CHECK(list.size() == 100 && list[99].asInt() == 99 && list.raw()->v.as_array.cap == 100);
+
+  // adding to something that isn't a container does nothing
+  TEST_CHECK(!list.emplace("k", 1) && !moved.emplaceBack(1) && moved.size() == 4);
+}
+
+static void copies()
+{
+  json::Value base;
+  TEST_CHECK(json::parse("{\"list\":[1,{\"k\":\"v\"}],\"n\":1}", base));
+
+  // a snapshot shares until one side changes, a clone never does
+  json::Value snap = base.snapshot();
+  json::Value deep = base.clone();
+  base["list"][1].emplace("k", "changed");
+  base.emplace("n", 2);
+  TEST_CHECK(same(base.dump(), "{\"list\":[1,{\"k\":\"changed\"}],\"n\":2}"));
+  TEST_CHECK(same(snap.dump(), "{\"list\":[1,{\"k\":\"v\"}],\"n\":1}"));
+  TEST_CHECK(same(deep.dump(), "{\"list\":[1,{\"k\":\"v\"}],\"n\":1}"));
+
+  snap["list"].erase(size_t(0));
+  TEST_CHECK(same(snap.dump(), "{\"list\":[{\"k\":\"v\"}],\"n\":1}"));
+  TEST_CHECK(same(base.dump(), "{\"list\":[1,{\"k\":\"changed\"}],\"n\":2}"));
+
+  TEST_CHECK(same(deep.dump(true), "{\n\t\"list\": [\n\t\t1,\n\t\t{\n\t\t\t\"k\": \"v\"\n\t\t}\n\t],\n\t\"n\": 1\n}"));
+}
+
+void value()
+{
+  const long live = liveAllocs();
+
+  parsing();
+  views();
+  building();
+  copies();
+
+  TEST_CHECK(liveAllocs() == live);
+}
+
+} // namespace test
@@ -0,0 +1,152 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+static
+Json_Boolean Test__sameString(Json_String got, Json_String want)
+{
+  const Json_Boolean same = got.data && !Json_stringCmp(got, want);
+
+  Json_Value tmp;
+  if (got.is_heap) Json_destroyValue(Json_asValue(&tmp, JSON_TYPE_STRING, got));
+  return same;
+}
+
+// the cursor has to read exactly what the tree parse built
+static
+Json_Boolean Test__matches(const Json_Cursor *cur, Json_Value *value)
+{
+  const Json_String none = {JSON_FALSE, 0, NULL};
+  if (Json_cursorType(cur) != value->type) return JSON_FALSE;
+
+  switch (value->type) {
+    case JSON_TYPE_BOOLEAN: return Json_cursorBool(cur, !value->v.as_boolean) == value->v.as_boolean;
+    case JSON_TYPE_INTEGER: return Json_cursorInt(cur, 0) == value->v.as_integer;
+    case JSON_TYPE_STRING: return Test__sameString(Json_cursorStr(cur, none), value->v.as_string);
+
+    case JSON_TYPE_NUMBER: {
+      const Json_Number num = Json_cursorNum(cur, NAN);
+      return !memcmp(&num, &value->v.as_number, sizeof(num));
+    }
+
+    case JSON_TYPE_ARRAY: {
+      Json_CursorIter iter;
+      Json_Cursor elem;
+      size_t i = 0;
+      if (!Json_cursorIter(cur, &iter)) return JSON_FALSE;
+
+      while (Json_cursorNext(&iter, NULL, &elem)) {
+        if (i >= value->v.as_array.len || !Test__matches(&elem, &value->v.as_array.elems[i])) return JSON_FALSE;
+
+        Json_Cursor at;
+        if (i < 64 && (!Json_cursorAt(cur, i, &at) || at.pos != elem.pos)) return JSON_FALSE;
+        i += 1;
+      }
+
+      Json_Cursor past;
+      return i == value->v.as_array.len && !Json_cursorAt(cur, i, &past);
+    }
+
+    case JSON_TYPE_OBJECT: {
+      Json_CursorIter iter;
+      Json_Cursor key, field, found;
+      size_t i = 0;
+      if (!Json_cursorIter(cur, &iter)) return JSON_FALSE;
+
+      while (Json_cursorNext(&iter, &key, &field)) {
+        const Json_Object *object = &value->v.as_object;
+        if (i >= object->len) return JSON_FALSE;
+        if (!Test__sameString(Json_cursorStr(&key, none), object->field_names[i])) return JSON_FALSE;
+        if (!Test__matches(&field, &object->field_values[i])) return JSON_FALSE;
+        if (!Json_cursorGet(cur, object->field_names[i], &found) || found.pos != field.pos) return JSON_FALSE;
+        i += 1;
+      }
+
+      return i == value->v.as_object.len && !Json_cursorGet(cur, JSON_STRLIT("no such field"), &found);
+    }
+
+    default: return JSON_TRUE;
+  }
+}
+
+static
+void Test__checkDocument(const char *text, size_t len)
+{
+  Json_Value value;
+  Json_Cursor cur;
+  TEST_CHECK(Json_parseStr(len, text, &value) == len);
+  TEST_CHECK(Json_cursorInit(&cur, len, text));
+  TEST_CHECK(Test__matches(&cur, &value));
+
+  // and a value under a cursor parses to the same thing
+  Json_Value parsed;
+  TEST_CHECK(Json_cursorValue(&cur, &parsed, NULL) > 0);
+  TEST_CHECK(Test_sameValue(&parsed, &value));
+  Json_destroyValue(&parsed);
+  Json_destroyValue(&value);
+}
+
+void Test_cursor(void)
+{
+  const long live = Test_liveAllocs();
+
+  static const char *const docs[] = {
+    " { \"a\" : [ 1 , -2.5e-3 , \"x\\u00e9\\n\" , true , false , null ] ,\n\t\"b\" : { } , \"c\" : [ ] } ",
+    "[[[]],[{}],{\"k\":{\"k\":[\"\\\"]\"]}}]",
+    "\"top\\\\level\"",
+    "-9223372036854775808",
+    "1e308",
+    "false",
+  };
+
+  for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) Test__checkDocument(docs[i], strlen(docs[i]));
+
+  char *big = (char *)malloc(512 * 1024);
+  TEST_CHECK(big != NULL);
+  if (big) {
+    size_t len = 0;
+    len += (size_t)sprintf(&big[len], "{\"items\":[");
+    for (int i = 0; i < 5000; ++i) {
+      len += (size_t)sprintf(&big[len], "%s{\"id\":%d,\"name\":\"n\\\"%d\",\"score\":%d.%d,\"tags\":[\"t%d\",[]],\"ok\":%s}",
+        (i)? "," : "", i, i, i, i % 7, i % 3, (i % 2)? "true" : "false");
+    }
+    len += (size_t)sprintf(&big[len], "],\"count\":5000}");
+    Test__checkDocument(big, len);
+
+    // the getters go straight to a field without decoding what's before it
+    Json_Cursor root, items, item;
+    TEST_CHECK(Json_cursorInit(&root, len, big));
+    TEST_CHECK(Json_cursorGetInt(&root, JSON_STRLIT("count"), -1) == 5000);
+    TEST_CHECK(Json_cursorGet(&root, JSON_STRLIT("items"), &items));
+    TEST_CHECK(Json_cursorAt(&items, 4321, &item));
+    TEST_CHECK(Json_cursorGetInt(&item, JSON_STRLIT("id"), -1) == 4321);
+    TEST_CHECK(Json_cursorGetNum(&item, JSON_STRLIT("score"), -1.0) == 4321.2);
+    TEST_CHECK(Json_cursorGetBool(&item, JSON_STRLIT("ok"), JSON_FALSE));
+
+    Json_String name = Json_cursorGetStr(&item, JSON_STRLIT("name"), JSON_STRLIT(""));
+    TEST_CHECK(name.is_heap && Test__sameString(name, JSON_STRLIT("n\"4321")));
+    free(big);
+  }
+
+  // a duplicated field finds its last value, like Json_objectGet
+  Json_Cursor cur;
+  Json_Value dup;
+  TEST_CHECK(Json_cursorInit(&cur, 15, "{\"a\":1,\"a\":2} "));
+  TEST_CHECK(Json_cursorGetInt(&cur, JSON_STRLIT("a"), -1) == 2);
+  TEST_CHECK(Test_parse("{\"a\":1,\"a\":2}", &dup));
+  TEST_CHECK(Json_objectGetInt(&dup, JSON_STRLIT("a"), -1) == 2);
+  Json_destroyValue(&dup);
+
+  // malformed values read as null and find nothing
+  Json_Cursor found;
+  TEST_CHECK(Json_cursorInit(&cur, 7, "{\"a\" 1}"));
+  TEST_CHECK(!Json_cursorGet(&cur, JSON_STRLIT("a"), &found));
+  TEST_CHECK(Json_cursorInit(&cur, 3, "nop") && Json_cursorType(&cur) == JSON_TYPE_NULL);
+  TEST_CHECK(!Json_cursorInit(&cur, 3, "   "));
+
+  Json_Value value;
+  TEST_CHECK(Json_cursorInit(&cur, 4, "[1,2"));
+  TEST_CHECK(Json_cursorValue(&cur, &value, NULL) == 0 && value.type == JSON_TYPE_NULL);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
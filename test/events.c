@@ -0,0 +1,156 @@
+#include "test.h"
+
+typedef struct {
+  char log[256];
+  size_t len;
+  const char *skip_key;      // JSON_EVENT_SKIP for this key
+  Json_Boolean skip_objects; // and for every object
+  int stop_at;               // JSON_EVENT_STOP from the nth callback
+  int calls;
+} Test__Recorder;
+
+static
+int Test__record(Test__Recorder *rec, const char *event, size_t len, const char *data)
+{
+  if (rec->len) rec->log[rec->len++] = ' ';
+  rec->len += (size_t)sprintf(&rec->log[rec->len], "%s%.*s", event, (int)len, data);
+  return (++rec->calls == rec->stop_at)? JSON_EVENT_STOP : JSON_EVENT_CONTINUE;
+}
+
+static
+int Test__startObject(void *user)
+{
+  Test__Recorder *rec = (Test__Recorder *)user;
+  const int ret = Test__record(rec, "{", 0, "");
+  return (rec->skip_objects)? JSON_EVENT_SKIP : ret;
+}
+
+static
+int Test__endObject(void *user)
+{
+  return Test__record((Test__Recorder *)user, "}", 0, "");
+}
+
+static
+int Test__startArray(void *user)
+{
+  return Test__record((Test__Recorder *)user, "[", 0, "");
+}
+
+static
+int Test__endArray(void *user)
+{
+  return Test__record((Test__Recorder *)user, "]", 0, "");
+}
+
+static
+int Test__null(void *user)
+{
+  return Test__record((Test__Recorder *)user, "n", 0, "");
+}
+
+static
+int Test__key(void *user, Json_String key)
+{
+  Test__Recorder *rec = (Test__Recorder *)user;
+  const int ret = Test__record(rec, "k:", key.len, key.data);
+  const Json_Boolean skip = rec->skip_key
+    && key.len == strlen(rec->skip_key) && !memcmp(key.data, rec->skip_key, key.len);
+  return (skip)? JSON_EVENT_SKIP : ret;
+}
+
+static
+int Test__string(void *user, Json_String val)
+{
+  return Test__record((Test__Recorder *)user, "s:", val.len, val.data);
+}
+
+static
+int Test__number(void *user, Json_Number val)
+{
+  char buf[JSON_NUMBER_BUFSZ];
+  return Test__record((Test__Recorder *)user, "d:", Json_formatNumber(buf, val), buf);
+}
+
+static
+int Test__integer(void *user, Json_Integer val)
+{
+  char buf[JSON_NUMBER_BUFSZ];
+  return Test__record((Test__Recorder *)user, "i:", Json_formatInteger(buf, val), buf);
+}
+
+static
+int Test__boolean(void *user, Json_Boolean val)
+{
+  return Test__record((Test__Recorder *)user, (val)? "t" : "f", 0, "");
+}
+
+static
+size_t Test__events(const char *text, Test__Recorder *rec, Json_Boolean integers)
+{
+  Json_EventHandler handler;
+  memset(&handler, 0, sizeof(handler));
+  handler.user = rec;
+  handler.start_object = Test__startObject;
+  handler.end_object = Test__endObject;
+  handler.start_array = Test__startArray;
+  handler.end_array = Test__endArray;
+  handler.key = Test__key;
+  handler.string = Test__string;
+  handler.number = Test__number;
+  handler.boolean = Test__boolean;
+  handler.null = Test__null;
+  if (integers) handler.integer = Test__integer;
+
+  rec->len = 0;
+  rec->log[0] = '\0';
+  rec->calls = 0;
+  return Json_parseEvents(strlen(text), text, &handler);
+}
+
+void Test_events(void)
+{
+  const long live = Test_liveAllocs();
+
+  static const char doc[] = "{\"a\":[1,2.5,\"x\\ty\",true,false,null],\"b\":{\"c\":{}},\"d\":-7} ";
+  const size_t len = sizeof(doc) - 1;
+
+  Test__Recorder rec;
+  memset(&rec, 0, sizeof(rec));
+  TEST_CHECK(Test__events(doc, &rec, JSON_TRUE) == len);
+  TEST_CHECK(!strcmp(rec.log, "{ k:a [ i:1 d:2.5 s:x\ty t f n ] k:b { k:c { } } k:d i:-7 }"));
+
+  // without an integer callback integers are numbers
+  TEST_CHECK(Test__events(doc, &rec, JSON_FALSE) == len);
+  TEST_CHECK(!strcmp(rec.log, "{ k:a [ d:1 d:2.5 s:x\ty t f n ] k:b { k:c { } } k:d d:-7 }"));
+
+  // a skipped field's value produces no events at all
+  rec.skip_key = "a";
+  TEST_CHECK(Test__events(doc, &rec, JSON_TRUE) == len);
+  TEST_CHECK(!strcmp(rec.log, "{ k:a k:b { k:c { } } k:d i:-7 }"));
+  rec.skip_key = NULL;
+
+  // and neither does the rest of a skipped container, its end included
+  rec.skip_objects = JSON_TRUE;
+  TEST_CHECK(Test__events("[1,{\"a\":[2]},3]", &rec, JSON_TRUE) == 15);
+  TEST_CHECK(!strcmp(rec.log, "[ i:1 { i:3 ]"));
+  rec.skip_objects = JSON_FALSE;
+
+  // stopping returns what was read up to the value that stopped it
+  rec.stop_at = 4;
+  const size_t stopped = Test__events(doc, &rec, JSON_TRUE);
+  TEST_CHECK(!strcmp(rec.log, "{ k:a [ i:1"));
+  TEST_CHECK(stopped > 0 && stopped < len && doc[stopped - 1] == '1');
+  rec.stop_at = 0;
+
+  TEST_CHECK(Test__events("[1,2", &rec, JSON_TRUE) == 0);
+  TEST_CHECK(Test__events("{\"a\" 1}", &rec, JSON_TRUE) == 0);
+  TEST_CHECK(Test__events("", &rec, JSON_TRUE) == 0);
+
+  // every callback may be left out
+  Json_EventHandler none;
+  memset(&none, 0, sizeof(none));
+  TEST_CHECK(Json_parseEvents(len, doc, &none) == len);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
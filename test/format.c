@@ -0,0 +1,104 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+static unsigned long long Test__seed = 0x2545f4914f6cdd1dull;
+
+static
+unsigned long long Test__random(void)
+{
+  Test__seed ^= Test__seed << 13;
+  Test__seed ^= Test__seed >> 7;
+  Test__seed ^= Test__seed << 17;
+  return Test__seed;
+}
+
+// digits that matter in text, not counting leading or trailing zeros
+static
+int Test__digits(const char *text)
+{
+  int n = 0, zeros = 0;
+  Json_Boolean leading = JSON_TRUE;
+  for (; *text && *text != 'e'; ++text) {
+    if (*text < '0' || *text > '9') continue;
+    if (*text == '0' && leading) continue;
+
+    leading = JSON_FALSE;
+    n += 1;
+    zeros = (*text == '0')? zeros + 1 : 0;
+  }
+
+  return n - zeros;
+}
+
+// the fewest digits printf needs for val to read back
+static
+int Test__shortest(double val)
+{
+  char text[64];
+  for (int p = 1; p < 17; ++p) {
+    sprintf(text, "%.*g", p, val);
+    if (strtod(text, NULL) == val) return p;
+  }
+  return 17;
+}
+
+static
+Json_Boolean Test__formats(double val, const char *expected)
+{
+  char buf[JSON_NUMBER_BUFSZ];
+  const size_t len = Json_formatNumber(buf, val);
+  return len == strlen(expected) && !strcmp(buf, expected);
+}
+
+void Test_format(void)
+{
+  TEST_CHECK(Test__formats(0.1, "0.1"));
+  TEST_CHECK(Test__formats(0.3, "0.3"));
+  TEST_CHECK(Test__formats(0.1 + 0.2, "0.30000000000000004"));
+  TEST_CHECK(Test__formats(-0.0, "-0"));
+  TEST_CHECK(Test__formats(1.0, "1"));
+  TEST_CHECK(Test__formats(-1234567.0, "-1234567"));
+  TEST_CHECK(Test__formats(123456.789, "123456.789"));
+  TEST_CHECK(Test__formats(0.000001, "0.000001"));
+  TEST_CHECK(Test__formats(1e-7, "1e-7"));
+  TEST_CHECK(Test__formats(1e21, "1e21"));
+  TEST_CHECK(Test__formats(5e-324, "5e-324"));
+  TEST_CHECK(Test__formats(1.7976931348623157e308, "1.7976931348623157e308"));
+  TEST_CHECK(Test__formats(2.2250738585072014e-308, "2.2250738585072014e-308"));
+  TEST_CHECK(Test__formats(INFINITY, "Infinity"));
+  TEST_CHECK(Test__formats(-INFINITY, "-Infinity"));
+  TEST_CHECK(Test__formats(NAN, "NaN"));
+
+  char buf[JSON_NUMBER_BUFSZ];
+  TEST_CHECK(Json_formatInteger(buf, -9223372036854775807ll - 1) == 20 && !strcmp(buf, "-9223372036854775808"));
+  TEST_CHECK(Json_formatInteger(buf, 0) == 1 && !strcmp(buf, "0"));
+
+  // everything reads back exactly, and nearly everything in the fewest digits
+  size_t wrong = 0, longer = 0, total = 0;
+  for (int i = 0; i < 200000; ++i) {
+    const unsigned long long bits = Test__random();
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    if (i % 2) val = (double)(bits % 10000000) / (double)(1 + Test__random() % 10000);
+    if (isnan(val) || isinf(val)) continue;
+
+    const size_t len = Json_formatNumber(buf, val);
+    const double back = strtod(buf, NULL);
+    wrong += len != strlen(buf) || len >= JSON_NUMBER_BUFSZ || memcmp(&back, &val, sizeof(val));
+
+    const int digits = Test__digits(buf), shortest = Test__shortest(val);
+    wrong += digits > 17 || digits < shortest;
+    longer += digits > shortest;
+    total += 1;
+  }
+
+  TEST_CHECK(wrong == 0);
+  TEST_CHECK(longer * 1000 < total);
+
+  // which is how the serializer writes them
+  Json_Value value;
+  TEST_CHECK(Test_parse("[0.1,1e21,-0,5e-324,1.5e300,100,-7]", &value));
+  TEST_CHECK(Test_sameText(&value, "[0.1,1e21,-0,5e-324,1.5e300,100,-7]"));
+  Json_destroyValue(&value);
+}
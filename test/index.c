@@ -0,0 +1,159 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+#define TEST__FIELDS 300
+
+static
+Json_String Test__name(char *buf, int i)
+{
+  Json_String name;
+  name.is_heap = JSON_FALSE;
+  name.len = (size_t)sprintf(buf, "k%d", i);
+  name.data = buf;
+  return name;
+}
+
+// every field is found where it is, and nothing else is found
+static
+void Test__checkFields(Json_Value *value, const char *present)
+{
+  Json_Object *object = &value->v.as_object;
+  for (size_t i = 0; i < object->len; ++i) {
+    TEST_CHECK(Json_objectGet(value, object->field_names[i]) == &object->field_values[i]);
+  }
+
+  size_t len = 0;
+  char buf[16];
+  for (int i = 0; i < TEST__FIELDS; ++i) {
+    const Json_Value *field = Json_objectGet(value, Test__name(buf, i));
+    if (present[i]) {
+      TEST_CHECK(field && field->type == JSON_TYPE_INTEGER && field->v.as_integer % 1000 == i);
+      len += 1;
+    } else {
+      TEST_CHECK(field == NULL);
+    }
+  }
+
+  TEST_CHECK(object->len == len);
+}
+
+// an allocator that gives out *user more blocks and then fails
+static
+void *Test__alloc(void *user, size_t sz)
+{
+  long *left = (long *)user;
+  return ((*left)-- > 0)? malloc(sz) : NULL;
+}
+
+static
+void *Test__resize(void *user, void *ptr, size_t sz)
+{
+  long *left = (long *)user;
+  return ((*left)-- > 0)? realloc(ptr, sz) : NULL;
+}
+
+static
+void Test__release(void *user, void *ptr)
+{
+  (void)user;
+  free(ptr);
+}
+
+void Test_index(void)
+{
+  const long live = Test_liveAllocs();
+
+  char present[TEST__FIELDS];
+  char buf[16];
+
+  Json_Value value;
+  memset(&value, 0, sizeof(value));
+  value.type = JSON_TYPE_OBJECT;
+  for (int i = 0; i < TEST__FIELDS; ++i) {
+    Json_objectSetInt(&value, Json_stringDup(Test__name(buf, i)), i);
+    present[i] = 1;
+  }
+  Test__checkFields(&value, present);
+
+  for (int i = TEST__FIELDS - 1; i >= 0; i -= 3) {
+    Json_objectDelete(&value, Test__name(buf, i));
+    present[i] = 0;
+  }
+  Test__checkFields(&value, present);
+
+  // reinserted fields go to the end and are found there
+  for (int i = 0; i < TEST__FIELDS; ++i) {
+    if (present[i]) continue;
+    Json_objectSetInt(&value, Json_stringDup(Test__name(buf, i)), 1000 + i);
+    present[i] = 1;
+  }
+  Test__checkFields(&value, present);
+  TEST_CHECK(Json_objectGetInt(&value, JSON_STRLIT("k299"), -1) == 1299);
+  TEST_CHECK(Json_stringCmp(value.v.as_object.field_names[200], JSON_STRLIT("k2")) == 0);
+
+  // setting a field that's there replaces its value in place
+  Json_objectSetInt(&value, Json_stringDup(JSON_STRLIT("k7")), 2007);
+  TEST_CHECK(value.v.as_object.len == TEST__FIELDS);
+  TEST_CHECK(Json_objectGetInt(&value, JSON_STRLIT("k7"), -1) == 2007);
+  Test__checkFields(&value, present);
+
+  // down below the size that gets an index and back up again
+  for (int i = 20; i < TEST__FIELDS; ++i) {
+    Json_objectDelete(&value, Test__name(buf, i));
+    present[i] = 0;
+  }
+  Test__checkFields(&value, present);
+
+  for (int i = 0; i < 10; ++i) {
+    Json_objectDelete(&value, Test__name(buf, i));
+    present[i] = 0;
+  }
+  Test__checkFields(&value, present);
+
+  for (int i = 0; i < 40; ++i) {
+    if (present[i]) continue;
+    Json_objectSetInt(&value, Json_stringDup(Test__name(buf, i)), i);
+    present[i] = 1;
+  }
+  Test__checkFields(&value, present);
+  Json_destroyValue(&value);
+
+  // parsed objects are indexed the same way
+  Json_Value parsed;
+  TEST_CHECK(Test_parse(
+    "{\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9,"
+    "\"k10\":10,\"k11\":11,\"k12\":12,\"k13\":13,\"k14\":14,\"k15\":15,\"k16\":16,\"k17\":17}",
+    &parsed
+  ));
+  TEST_CHECK(Json_objectGetInt(&parsed, JSON_STRLIT("k16"), -1) == 16);
+  Json_objectDelete(&parsed, JSON_STRLIT("k3"));
+  Json_objectDelete(&parsed, JSON_STRLIT("k0"));
+  TEST_CHECK(Json_objectGet(&parsed, JSON_STRLIT("k3")) == NULL);
+  TEST_CHECK(Json_objectGetInt(&parsed, JSON_STRLIT("k17"), -1) == 17);
+  Json_objectSetInt(&parsed, JSON_STRLIT("k3"), 1003);
+  TEST_CHECK(Json_objectGetInt(&parsed, JSON_STRLIT("k3"), -1) == 1003);
+  TEST_CHECK(parsed.v.as_object.len == 17);
+  Json_destroyValue(&parsed);
+
+  // a table that can't grow leaves every field still found
+  char text[1024];
+  size_t len = 0;
+  for (int i = 0; i < 40; ++i) len += (size_t)sprintf(&text[len], "%s\"k%d\":%d", (i)? "," : "{", i, i);
+  len += (size_t)sprintf(&text[len], "}");
+
+  long left;
+  const Json_Allocator allocator = {Test__alloc, Test__resize, Test__release, &left};
+  Json_ParseOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.allocator = &allocator;
+  for (long n = 0; n < 64; ++n) {
+    left = n;
+    if (Json_parseStrEx(len, text, &parsed, &opts) != len) continue;
+
+    for (int i = 0; i < 40; ++i) TEST_CHECK(Json_objectGetInt(&parsed, Test__name(buf, i), -1) == i);
+    Json_destroyValueWith(&parsed, &allocator);
+  }
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
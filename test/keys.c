@@ -0,0 +1,81 @@
+#include "test.h"
+
+static
+Json_String Test__name(char *buf, int i)
+{
+  Json_String name;
+  name.is_heap = JSON_FALSE;
+  name.len = (size_t)sprintf(buf, "key%d", i);
+  name.data = buf;
+  return name;
+}
+
+void Test_keys(void)
+{
+  const long live = Test_liveAllocs();
+
+  Json_KeyPool pool;
+  Json_keyPoolInit(&pool);
+
+  char buf[80];
+  const Json_String id = Json_keyPoolIntern(&pool, JSON_STRLIT("id"));
+  TEST_CHECK(!id.is_heap && !Json_stringCmp(id, JSON_STRLIT("id")));
+
+  // the same name from anywhere is the same pool copy
+  strcpy(buf, "id");
+  Json_String copy = JSON_STRLIT("id");
+  copy.data = buf;
+  TEST_CHECK(Json_keyPoolIntern(&pool, copy).data == id.data);
+  TEST_CHECK(Json_keyPoolIntern(&pool, Test__name(buf, 0)).data != id.data);
+
+  // keys too long to intern come back as they were given
+  memset(buf, 'k', 70);
+  Json_String long_name;
+  long_name.is_heap = JSON_FALSE;
+  long_name.len = 70;
+  long_name.data = buf;
+  TEST_CHECK(Json_keyPoolIntern(&pool, long_name).data == buf);
+
+  // every document parsed with the pool shares its names
+  Json_ParseOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.keys = &pool;
+
+  static const char first[] = "{\"id\":1,\"name\":\"a\",\"nested\":[{\"id\":2}]}";
+  static const char second[] = "{\"name\":\"b\",\"id\":3}";
+  Json_Value a, b;
+  TEST_CHECK(Json_parseStrEx(sizeof(first) - 1, first, &a, &opts) == sizeof(first) - 1);
+  TEST_CHECK(Json_parseStrEx(sizeof(second) - 1, second, &b, &opts) == sizeof(second) - 1);
+  TEST_CHECK(a.v.as_object.field_names[0].data == id.data);
+  TEST_CHECK(!a.v.as_object.field_names[0].is_heap);
+  TEST_CHECK(a.v.as_object.field_names[1].data == b.v.as_object.field_names[0].data);
+  TEST_CHECK(Json_objectGetInt(&b, id, -1) == 3);
+  TEST_CHECK(Test_sameText(&a, first) && Test_sameText(&b, second));
+
+  // and destroying them leaves the pool alone
+  Json_destroyValue(&a);
+  TEST_CHECK(Json_keyPoolIntern(&pool, JSON_STRLIT("name")).data == b.v.as_object.field_names[0].data);
+  Json_destroyValue(&b);
+
+  // arena documents share the pool's names too
+  Json_Arena arena;
+  Json_arenaInit(&arena, 0);
+  opts.arena = &arena;
+  TEST_CHECK(Json_parseStrEx(sizeof(second) - 1, second, &b, &opts) == sizeof(second) - 1);
+  TEST_CHECK(b.v.as_object.field_names[1].data == id.data);
+  Json_arenaDestroy(&arena);
+
+  // once full the pool only hands out what it already has
+  const size_t before = pool.len;
+  for (int i = 0; i < JSON_KEY_POOL_MAX_KEYS + 100; ++i) {
+    Json_String name = Json_keyPoolIntern(&pool, Test__name(buf, i));
+    TEST_CHECK(!Json_stringCmp(name, Test__name(buf, i)));
+  }
+  TEST_CHECK(pool.len == JSON_KEY_POOL_MAX_KEYS);
+  TEST_CHECK(pool.len > before);
+  TEST_CHECK(Json_keyPoolIntern(&pool, Test__name(buf, JSON_KEY_POOL_MAX_KEYS + 50)).data == buf);
+  TEST_CHECK(Json_keyPoolIntern(&pool, JSON_STRLIT("id")).data == id.data);
+
+  Json_keyPoolDestroy(&pool);
+  TEST_CHECK(Test_liveAllocs() == live);
+}
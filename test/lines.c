@@ -0,0 +1,118 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+#define TEST__RECORDS 5000
+
+// every 97th record is malformed and every 10th is followed by a blank line
+static
+size_t Test__makeLines(char *buf)
+{
+  size_t len = 0;
+  for (int i = 0; i < TEST__RECORDS; ++i) {
+    if (i % 97 == 96) len += (size_t)sprintf(&buf[len], "{\"i\":%d,\n", i);
+    else len += (size_t)sprintf(&buf[len], "{\"i\":%d,\"s\":\"line %d\",\"a\":[%d]}\n", i, i, -i);
+    if (i % 10 == 0) len += (size_t)sprintf(&buf[len], "  \n");
+  }
+
+  // the last line needs no newline
+  len -= 1;
+  return len;
+}
+
+typedef struct {
+  char seen[TEST__RECORDS];
+  char ok[TEST__RECORDS];
+  long live;
+} Test__Records;
+
+static
+void Test__onRecord(void *user, size_t idx, Json_Value *record, Json_Boolean ok)
+{
+  Test__Records *records = (Test__Records *)user;
+  if (idx >= TEST__RECORDS) return;
+
+  records->seen[idx] += 1;
+  records->ok[idx] = ok && Json_objectGetInt(record, JSON_STRLIT("i"), -1) == (Json_Integer)idx;
+  Json_destroyValue(record);
+}
+
+static
+void Test__checkOrder(const Json_Value *value)
+{
+  TEST_CHECK(value->type == JSON_TYPE_ARRAY && value->v.as_array.len == TEST__RECORDS);
+  if (value->type != JSON_TYPE_ARRAY || value->v.as_array.len != TEST__RECORDS) return;
+
+  size_t wrong = 0;
+  for (int i = 0; i < TEST__RECORDS; ++i) {
+    Json_Value *record = &value->v.as_array.elems[i];
+    if (i % 97 == 96) wrong += record->type != JSON_TYPE_NULL;
+    else wrong += Json_objectGetInt(record, JSON_STRLIT("i"), -1) != i;
+  }
+
+  TEST_CHECK(wrong == 0);
+}
+
+void Test_lines(void)
+{
+  const long live = Test_liveAllocs();
+
+  char *buf = (char *)malloc(TEST__RECORDS * 64);
+  TEST_CHECK(buf != NULL);
+  if (!buf) return;
+  const size_t len = Test__makeLines(buf);
+
+  Json_LinesOptions opts;
+  memset(&opts, 0, sizeof(opts));
+
+  // the same records in the same order on one thread and on several
+  Json_Value one, many;
+  opts.nthreads = 1;
+  TEST_CHECK(Json_parseLines(len, buf, &one, &opts) == TEST__RECORDS);
+  Test__checkOrder(&one);
+
+  opts.nthreads = 4;
+  TEST_CHECK(Json_parseLines(len, buf, &many, &opts) == TEST__RECORDS);
+  Test__checkOrder(&many);
+  TEST_CHECK(Test_sameValue(&one, &many));
+  Json_destroyValue(&one);
+  Json_destroyValue(&many);
+
+  // each record is handed over exactly once
+  Test__Records *records = (Test__Records *)calloc(1, sizeof(Test__Records));
+  TEST_CHECK(records != NULL);
+  if (records) {
+    opts.on_record = Test__onRecord;
+    opts.user = records;
+    TEST_CHECK(Json_parseLines(len, buf, NULL, &opts) == TEST__RECORDS);
+
+    size_t wrong = 0;
+    for (int i = 0; i < TEST__RECORDS; ++i) {
+      wrong += records->seen[i] != 1 || records->ok[i] != (i % 97 != 96);
+    }
+    TEST_CHECK(wrong == 0);
+    free(records);
+    opts.on_record = NULL;
+  }
+
+  // keys are interned from the first record on and shared by the rest
+  Json_KeyPool keys;
+  Json_keyPoolInit(&keys);
+  opts.parse.keys = &keys;
+  TEST_CHECK(Json_parseLines(len, buf, &many, &opts) == TEST__RECORDS);
+  Test__checkOrder(&many);
+  if (many.type == JSON_TYPE_ARRAY && many.v.as_array.len == TEST__RECORDS) {
+    const Json_Object *first = &many.v.as_array.elems[0].v.as_object;
+    const Json_Object *last = &many.v.as_array.elems[TEST__RECORDS - 1].v.as_object;
+    TEST_CHECK(first->field_names[1].data == last->field_names[1].data);
+  }
+  Json_destroyValue(&many);
+  Json_keyPoolDestroy(&keys);
+
+  TEST_CHECK(Json_parseLines(0, buf, &one, &opts) == 0);
+  TEST_CHECK(one.type == JSON_TYPE_ARRAY && one.v.as_array.len == 0);
+  Json_destroyValue(&one);
+
+  free(buf);
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -1,10 +1,120 @@
+#define JSON_IMPLEMENTATION 1
+#include "test.h"
+
 #include <stdio.h>
+#include <stdlib.h>
 
-#define JSON_IMPLEMENTATION 1
-#include "../json.h"
+static long Test__checks;
+static long Test__failures;
+static long Test__live;
+
+void Test_check(int ok, const char *file, int line, const char *expr)
+{
+  Test__checks += 1;
+  if (ok) return;
+
+  Test__failures += 1;
+  fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+}
+
+// the allocator is used from worker threads too
+static
+void *Test__alloc(void *user, size_t sz)
+{
+  (void)user;
+  void *ptr = malloc(sz);
+  if (ptr) __atomic_add_fetch(&Test__live, 1, __ATOMIC_RELAXED);
+  return ptr;
+}
+
+static
+void *Test__resize(void *user, void *ptr, size_t sz)
+{
+  (void)user;
+  return realloc(ptr, sz);
+}
+
+static
+void Test__release(void *user, void *ptr)
+{
+  (void)user;
+  __atomic_sub_fetch(&Test__live, 1, __ATOMIC_RELAXED);
+  free(ptr);
+}
+
+static const Json_Allocator Test__allocator = {Test__alloc, Test__resize, Test__release, NULL};
+
+long Test_liveAllocs(void)
+{
+  return __atomic_load_n(&Test__live, __ATOMIC_RELAXED);
+}
+
+Json_Boolean Test_parse(const char *text, Json_Value *out)
+{
+  const size_t len = strlen(text);
+  if (Json_parseStr(len, text, out) == len) return JSON_TRUE;
+
+  Json_destroyValue(out);
+  return JSON_FALSE;
+}
+
+Json_Boolean Test_sameText(const Json_Value *value, const char *text)
+{
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+
+  const Json_Boolean same = Json_serialize(value, NULL, &sink)
+    && sink.len == strlen(text) && memcmp(sink.data, text, sink.len) == 0;
+
+  if (!same) fprintf(stderr, "  got:  %.*s\n  want: %s\n", (int)sink.len, sink.data? sink.data : "", text);
+  Json_sinkDestroy(&sink);
+  return same;
+}
+
+Json_Boolean Test_sameValue(const Json_Value *a, const Json_Value *b)
+{
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+
+  Json_Boolean same = Json_serialize(b, NULL, &sink);
+  if (same) same = Test_sameText(a, sink.data);
+
+  Json_sinkDestroy(&sink);
+  return same;
+}
 
 int main(void)
 {
+  Json_setAllocator(&Test__allocator);
+
+  Test_arena();
+  Test_borrow();
+  Test_index();
+  Test_mapped();
+  Test_parser();
+  Test_events();
+  Test_lines();
+  Test_scan();
+  Test_number();
+  Test_format();
+  Test_serialize();
+  Test_utf8();
+  Test_parallel();
+  Test_cursor();
+  Test_tape();
+  Test_query();
+  Test_keys();
+  Test_capacity();
+  Test_alloc();
+  Test_binary();
+  Test_publish();
+  Test_snapshot();
+
+  if (Test__failures) {
+    fprintf(stderr, "%ld of %ld checks failed\n", Test__failures, Test__checks);
+    return 1;
+  }
+
   Json_Value object;
 
   FILE *file = fopen("test.json", "r");
@@ -19,4 +129,4 @@ int main(void)
   Json_printValue(stdout, &object);
   Json_destroyValue(&object);
   return 0;
-}
\ No newline at end of file
+}
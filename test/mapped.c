@@ -0,0 +1,96 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+#define TEST__PATH "test_mapped.tmp"
+
+static
+Json_Boolean Test__writeFile(const char *text, size_t len)
+{
+  FILE *file = fopen(TEST__PATH, "wb");
+  if (!file) return JSON_FALSE;
+
+  const Json_Boolean ok = fwrite(text, 1, len, file) == len;
+  return !fclose(file) && ok;
+}
+
+// a page sized document, so that the mapping ends right where its last token does
+static
+void Test__checkPage(const char *head, const char *tail)
+{
+  char text[4096];
+  const size_t head_len = strlen(head), tail_len = strlen(tail);
+  memset(text, ' ', sizeof(text));
+  memcpy(text, head, head_len);
+  memcpy(&text[sizeof(text) - tail_len], tail, tail_len);
+
+  TEST_CHECK(Test__writeFile(text, sizeof(text)));
+
+  Json_Value mapped, parsed;
+  TEST_CHECK(Json_parseFileMapped(TEST__PATH, &mapped, NULL) == sizeof(text));
+  TEST_CHECK(Json_parseStr(sizeof(text), text, &parsed) == sizeof(text));
+  TEST_CHECK(Test_sameValue(&mapped, &parsed));
+  Json_destroyValue(&mapped);
+  Json_destroyValue(&parsed);
+}
+
+void Test_mapped(void)
+{
+  const long live = Test_liveAllocs();
+
+  Json_MappedFile file;
+  Json_Value value;
+  TEST_CHECK(!Json_mapFile("no such file.json", &file));
+  TEST_CHECK(Json_parseFileMapped("no such file.json", &value, NULL) == 0);
+  TEST_CHECK(value.type == JSON_TYPE_NULL);
+
+  static const char doc[] = "{\"a\":[1,2,{\"b\":\"c\\u0041\"}],\"d\":\"plain\"}\n";
+  TEST_CHECK(Test__writeFile(doc, sizeof(doc) - 1));
+  TEST_CHECK(Json_mapFile(TEST__PATH, &file));
+  TEST_CHECK(file.len == sizeof(doc) - 1 && memcmp(file.data, doc, file.len) == 0);
+  Json_unmapFile(&file);
+  TEST_CHECK(file.data == NULL);
+
+  // the mapping is gone once the call returns, so nothing may borrow from it
+  Json_ParseOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.flags = JSON_PARSE_BORROW;
+  TEST_CHECK(Json_parseFileMapped(TEST__PATH, &value, &opts) == sizeof(doc) - 1);
+  TEST_CHECK(Json_objectGet(&value, JSON_STRLIT("d"))->v.as_string.is_heap);
+  TEST_CHECK(Test_sameText(&value, "{\"a\":[1,2,{\"b\":\"cA\"}],\"d\":\"plain\"}"));
+  Json_destroyValue(&value);
+
+  TEST_CHECK(Test__writeFile("[1, 2", 5));
+  TEST_CHECK(Json_parseFileMapped(TEST__PATH, &value, NULL) == 0);
+  TEST_CHECK(value.type == JSON_TYPE_NULL);
+
+  TEST_CHECK(Test__writeFile("", 0));
+  TEST_CHECK(Json_parseFileMapped(TEST__PATH, &value, NULL) == 0);
+  TEST_CHECK(value.type == JSON_TYPE_NULL);
+
+  Test__checkPage("[", "1]");
+  Test__checkPage("", "12345");
+  Test__checkPage("{\"k\":", "\"end\"}");
+  Test__checkPage("", "\"string that ends the page\"");
+
+  // bigger than any buffer the parser keeps
+  const size_t big_len = 3 * 1024 * 1024;
+  char *big = (char *)malloc(big_len);
+  TEST_CHECK(big != NULL);
+  if (big) {
+    size_t len = 0;
+    big[len++] = '[';
+    while (len < big_len - 32) len += (size_t)sprintf(&big[len], "{\"i\":%u},", (unsigned)len);
+    big[len++] = '0';
+    big[len++] = ']';
+
+    TEST_CHECK(Test__writeFile(big, len));
+    TEST_CHECK(Json_parseFileMapped(TEST__PATH, &value, NULL) == len);
+    TEST_CHECK(value.type == JSON_TYPE_ARRAY && value.v.as_array.len > 200000);
+    Json_destroyValue(&value);
+    free(big);
+  }
+
+  remove(TEST__PATH);
+  TEST_CHECK(Test_liveAllocs() == live);
+}
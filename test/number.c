@@ -0,0 +1,141 @@
+#include "test.h"
+
+#include <locale.h>
+#include <stdlib.h>
+
+static unsigned long long Test__seed = 0x9e3779b97f4a7c15ull;
+
+static
+unsigned long long Test__random(void)
+{
+  Test__seed ^= Test__seed << 13;
+  Test__seed ^= Test__seed >> 7;
+  Test__seed ^= Test__seed << 17;
+  return Test__seed;
+}
+
+static
+Json_Boolean Test__parseNumber(const char *text, Json_Number *out)
+{
+  Json_Value value;
+  if (!Test_parse(text, &value)) return JSON_FALSE;
+
+  if (value.type == JSON_TYPE_NUMBER) *out = value.v.as_number;
+  else if (value.type == JSON_TYPE_INTEGER) *out = (Json_Number)value.v.as_integer;
+  else return JSON_FALSE;
+  return JSON_TRUE;
+}
+
+// same bits as strtod, which glibc rounds correctly
+static
+Json_Boolean Test__sameAsStrtod(const char *text)
+{
+  Json_Number val;
+  if (!Test__parseNumber(text, &val)) return JSON_FALSE;
+
+  const double expected = strtod(text, NULL);
+  return !memcmp(&val, &expected, sizeof(val));
+}
+
+static
+void Test__exact(void)
+{
+  static const char *const hard[] = {
+    "0.1", "0.3", "1e23", "8.98846567431158e307", "1.7976931348623157e308",
+    "2.2250738585072011e-308", "2.2250738585072014e-308", "4.9e-324", "5e-324",
+    "9007199254740993.0", "9007199254740993e0", "0.30000000000000004441",
+    "7.038531e-26", "123456789012345678901234567890", "1e-400", "-1e400",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124",
+    "1.00000000000000011102230246251565404236316680908203126",
+    "-0.0", "1E+2", "1e-2", "0e0",
+  };
+
+  for (size_t i = 0; i < sizeof(hard) / sizeof(hard[0]); ++i) {
+    TEST_CHECK(Test__sameAsStrtod(hard[i]));
+  }
+
+  char text[64];
+  size_t failed = 0;
+  for (int i = 0; i < 100000; ++i) {
+    unsigned long long bits = Test__random();
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    if (isnan(val) || isinf(val)) continue;
+
+    sprintf(text, "%.17g", val);
+    failed += !Test__sameAsStrtod(text);
+
+    // and with fewer digits than it takes, which needs rounding
+    sprintf(text, "%.*e", (int)(bits % 20), val);
+    failed += !Test__sameAsStrtod(text);
+
+    // long mantissas with small exponents
+    sprintf(text, "%llu.%llue%d", Test__random() % 100000000000000000ull, bits % 1000000ull, (int)(bits % 61) - 30);
+    failed += !Test__sameAsStrtod(text);
+  }
+
+  TEST_CHECK(failed == 0);
+}
+
+static
+void Test__integers(void)
+{
+  Json_Value value;
+  TEST_CHECK(Test_parse("9223372036854775807", &value));
+  TEST_CHECK(value.type == JSON_TYPE_INTEGER && value.v.as_integer == 9223372036854775807ll);
+
+  TEST_CHECK(Test_parse("-9223372036854775808", &value));
+  TEST_CHECK(value.type == JSON_TYPE_INTEGER && value.v.as_integer == -9223372036854775807ll - 1);
+
+  TEST_CHECK(Test_parse("9007199254740993", &value));
+  TEST_CHECK(value.type == JSON_TYPE_INTEGER && value.v.as_integer == 9007199254740993ll);
+
+  // too big for 64 bits, or not written as an integer
+  TEST_CHECK(Test_parse("9223372036854775808", &value));
+  TEST_CHECK(value.type == JSON_TYPE_NUMBER && value.v.as_number == 9223372036854775808.0);
+  TEST_CHECK(Test_parse("1e2", &value) && value.type == JSON_TYPE_NUMBER);
+  TEST_CHECK(Test_parse("1.0", &value) && value.type == JSON_TYPE_NUMBER);
+  TEST_CHECK(Test_parse("-0", &value) && value.type == JSON_TYPE_NUMBER && signbit(value.v.as_number));
+
+  // and integers written back stay exact
+  TEST_CHECK(Test_parse("[-9223372036854775808,9007199254740993,0]", &value));
+  TEST_CHECK(Test_sameText(&value, "[-9223372036854775808,9007199254740993,0]"));
+  Json_destroyValue(&value);
+}
+
+static
+void Test__malformed(void)
+{
+  static const char *const bad[] = {"1.", ".5", "1e", "1e+", "-", "+1", "--1", "1.e5", "[1,2.,3]", "{\"a\":-}"};
+
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+    Json_Value value;
+    value.type = JSON_TYPE_BOOLEAN;
+    TEST_CHECK(Json_parseStr(strlen(bad[i]), bad[i], &value) == 0);
+    TEST_CHECK(value.type == JSON_TYPE_NULL);
+  }
+
+  // a number ends where its digits do, whatever comes after them
+  Json_Value value;
+  TEST_CHECK(Json_parseStr(4, "0x10", &value) == 1 && value.v.as_integer == 0);
+  TEST_CHECK(Json_parseStr(2, "01", &value) == 1 && value.v.as_integer == 0);
+}
+
+void Test_number(void)
+{
+  const long live = Test_liveAllocs();
+
+  Test__exact();
+  Test__integers();
+  Test__malformed();
+
+  // a decimal comma in the locale doesn't change how json is read
+  if (setlocale(LC_NUMERIC, "de_DE.UTF-8") || setlocale(LC_NUMERIC, "fr_FR.UTF-8")) {
+    Json_Number val = 0.0;
+    TEST_CHECK(Test__parseNumber("2.5", &val) && val == 2.5);
+    setlocale(LC_NUMERIC, "C");
+  }
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,101 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+static
+size_t Test__makeArray(char *buf, int n, Json_Boolean nested)
+{
+  size_t len = 0;
+  if (nested) len += (size_t)sprintf(&buf[len], "{\"head\":1,\"items\":");
+  buf[len++] = '[';
+  for (int i = 0; i < n; ++i) {
+    if (i) buf[len++] = ',';
+    switch (i % 4) {
+      case 0: len += (size_t)sprintf(&buf[len], "{\"id\":%d,\"tags\":[\"a\",\"b\\\"]\"]}", i); break;
+      case 1: len += (size_t)sprintf(&buf[len], "[%d,[%d.25,{}],\"]\"]", i, -i); break;
+      case 2: len += (size_t)sprintf(&buf[len], "\"str,%d\"", i); break;
+      default: len += (size_t)sprintf(&buf[len], " %d ", i); break;
+    }
+  }
+  buf[len++] = ']';
+  if (nested) len += (size_t)sprintf(&buf[len], ",\"tail\":[1,2]}");
+  buf[len] = '\0';
+  return len;
+}
+
+void Test_parallel(void)
+{
+  const long live = Test_liveAllocs();
+
+  char *buf = (char *)malloc(4 * 1024 * 1024);
+  TEST_CHECK(buf != NULL);
+  if (!buf) return;
+
+  Json_ParallelOptions opts;
+  memset(&opts, 0, sizeof(opts));
+
+  for (int nested = 0; nested < 2; ++nested) {
+    const size_t len = Test__makeArray(buf, 50000, nested);
+    opts.depth = (size_t)nested;
+
+    Json_Value expected;
+    TEST_CHECK(Json_parseStr(len, buf, &expected) == len);
+
+    for (size_t nthreads = 1; nthreads <= 4; ++nthreads) {
+      Json_Value value;
+      opts.nthreads = nthreads;
+      TEST_CHECK(Json_parseStrParallel(len, buf, &value, &opts) == len);
+      TEST_CHECK(Test_sameValue(&value, &expected));
+      Json_destroyValue(&value);
+    }
+
+    // an array that isn't at the split depth is just parsed
+    Json_Value value;
+    opts.depth = 3;
+    TEST_CHECK(Json_parseStrParallel(len, buf, &value, &opts) == len);
+    TEST_CHECK(Test_sameValue(&value, &expected));
+    Json_destroyValue(&value);
+    Json_destroyValue(&expected);
+  }
+
+  // one bad element anywhere fails the whole parse
+  opts.depth = 0;
+  opts.nthreads = 4;
+  const size_t len = Test__makeArray(buf, 50000, JSON_FALSE);
+  const size_t from[] = {0, len / 3, len / 2, len - 100};
+  for (size_t i = 0; i < sizeof(from) / sizeof(from[0]); ++i) {
+    char *bad = strstr(&buf[from[i]], "{\"id\"");
+    TEST_CHECK(bad != NULL);
+    if (!bad) continue;
+    *bad = ':';
+
+    Json_Value value;
+    value.type = JSON_TYPE_BOOLEAN;
+    TEST_CHECK(Json_parseStrParallel(len, buf, &value, &opts) == 0);
+    TEST_CHECK(value.type == JSON_TYPE_NULL);
+    *bad = '{';
+  }
+
+  Json_Value value;
+  TEST_CHECK(Json_parseStrParallel(len - 1, buf, &value, &opts) == 0);
+  TEST_CHECK(value.type == JSON_TYPE_NULL);
+  TEST_CHECK(Json_parseStrParallel(2, "[]", &value, &opts) == 2);
+  TEST_CHECK(value.type == JSON_TYPE_ARRAY && value.v.as_array.len == 0);
+  Json_destroyValue(&value);
+
+  // keys found by the workers are the ones interned up front
+  Json_KeyPool keys;
+  Json_keyPoolInit(&keys);
+  opts.parse.keys = &keys;
+  TEST_CHECK(Json_parseStrParallel(len, buf, &value, &opts) == len);
+  if (value.type == JSON_TYPE_ARRAY && value.v.as_array.len == 50000) {
+    const Json_Value *first = &value.v.as_array.elems[0];
+    const Json_Value *last = &value.v.as_array.elems[49996];
+    TEST_CHECK(first->v.as_object.field_names[0].data == last->v.as_object.field_names[0].data);
+  }
+  Json_destroyValue(&value);
+  Json_keyPoolDestroy(&keys);
+
+  free(buf);
+  TEST_CHECK(Test_liveAllocs() == live);
+}
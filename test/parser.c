@@ -0,0 +1,116 @@
+#include "test.h"
+
+static const char *const Test__valid[] = {
+  "{\"a\":[1,-2.5e3,true,false,null],\"b\\n\\u00e9\\ud83c\\udf3f\":{\"c\":\"d\\\"e\"},\"f\":[]}",
+  "  [ 1 , 2 , [ [ ] , { } ] , \"x\\\\y\" ]  ",
+  "\"just a string \\t with escapes \\u0041\"",
+  "-0.000123e-10",
+  "18446744073709551616",
+  "9223372036854775807",
+  "true",
+  "null",
+  "[{\"deep\":[[[[{\"er\":[1]}]]]]}]",
+};
+
+static const char *const Test__invalid[] = {
+  "",
+  "   ",
+  "[1,2",
+  "[1,]",
+  "{\"a\" 1}",
+  "{\"a\":1,}",
+  "\"unterminated",
+  "tru",
+  "nul",
+  "1 2",
+  "[1]]",
+  "-",
+  "01",
+  "[\"\\ud83c\"",
+};
+
+// feeds text in pieces of step bytes, after a first piece of split bytes
+static
+Json_Boolean Test__feed(const char *text, size_t split, size_t step, Json_Value *out)
+{
+  const size_t len = strlen(text);
+
+  Json_Parser parser;
+  Json_parserInit(&parser, NULL);
+
+  Json_Boolean ok = Json_parserFeed(&parser, text, split);
+  for (size_t i = split; ok && i < len; i += step) {
+    ok = Json_parserFeed(&parser, &text[i], (len - i < step)? len - i : step);
+  }
+
+  if (ok) ok = Json_parserFinish(&parser, out);
+  Json_parserDestroy(&parser);
+  return ok;
+}
+
+void Test_parser(void)
+{
+  const long live = Test_liveAllocs();
+
+  for (size_t t = 0; t < sizeof(Test__valid) / sizeof(Test__valid[0]); ++t) {
+    const char *text = Test__valid[t];
+    const size_t len = strlen(text);
+
+    Json_Value expected;
+    TEST_CHECK(Test_parse(text, &expected));
+
+    for (size_t split = 0; split <= len; ++split) {
+      Json_Value value;
+      const Json_Boolean ok = Test__feed(text, split, len, &value);
+      TEST_CHECK(ok);
+      if (!ok) continue;
+
+      TEST_CHECK(Test_sameValue(&value, &expected));
+      Json_destroyValue(&value);
+    }
+
+    Json_Value value;
+    TEST_CHECK(Test__feed(text, 0, 1, &value));
+    TEST_CHECK(Test_sameValue(&value, &expected));
+    Json_destroyValue(&value);
+    Json_destroyValue(&expected);
+  }
+
+  for (size_t t = 0; t < sizeof(Test__invalid) / sizeof(Test__invalid[0]); ++t) {
+    const char *text = Test__invalid[t];
+    const size_t len = strlen(text);
+
+    for (size_t split = 0; split <= len; ++split) {
+      Json_Value value;
+      TEST_CHECK(!Test__feed(text, split, len, &value));
+    }
+
+    Json_Value value;
+    TEST_CHECK(!Test__feed(text, 0, 1, &value));
+  }
+
+  // a parser destroyed halfway through a document frees what it built
+  Json_Parser parser;
+  Json_parserInit(&parser, NULL);
+  TEST_CHECK(Json_parserFeed(&parser, "{\"key\":[\"str", 12));
+  Json_parserDestroy(&parser);
+
+  // arena documents outlive the parser
+  Json_Arena arena;
+  Json_arenaInit(&arena, 0);
+
+  Json_ParseOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.arena = &arena;
+
+  Json_Value value;
+  Json_parserInit(&parser, &opts);
+  TEST_CHECK(Json_parserFeed(&parser, "{\"k\":[\"v\"", 9));
+  TEST_CHECK(Json_parserFeed(&parser, ",2]}", 4));
+  TEST_CHECK(Json_parserFinish(&parser, &value));
+  Json_parserDestroy(&parser);
+  TEST_CHECK(Test_sameText(&value, "{\"k\":[\"v\",2]}"));
+  Json_arenaDestroy(&arena);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
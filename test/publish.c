@@ -0,0 +1,173 @@
+#include "test.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <pthread.h>
+# define TEST__HAVE_THREADS 1
+#endif
+
+// an object with enough fields to be indexed, and a check field that must
+// agree with its version
+static
+void Test__version(Json_Value *out, int version)
+{
+  char buf[16];
+  memset(out, 0, sizeof(*out));
+  out->type = JSON_TYPE_OBJECT;
+  for (int i = 0; i < 40; ++i) {
+    Json_String field;
+    field.is_heap = JSON_FALSE;
+    field.len = (size_t)sprintf(buf, "f%d", i);
+    field.data = buf;
+    Json_objectSetInt(out, Json_stringDup(field), i);
+  }
+  Json_objectSetInt(out, JSON_STRLIT("version"), version);
+  Json_objectSetInt(out, JSON_STRLIT("check"), 7 * (Json_Integer)version);
+}
+
+static
+Json_Boolean Test__exact(const Json_Value *value)
+{
+  if (value->type == JSON_TYPE_ARRAY) {
+    if (value->v.as_array.cap != value->v.as_array.len) return JSON_FALSE;
+    for (size_t i = 0; i < value->v.as_array.len; ++i) {
+      if (!Test__exact(&value->v.as_array.elems[i])) return JSON_FALSE;
+    }
+  } else if (value->type == JSON_TYPE_OBJECT) {
+    if (value->v.as_object.cap != value->v.as_object.len) return JSON_FALSE;
+    for (size_t i = 0; i < value->v.as_object.len; ++i) {
+      if (!Test__exact(&value->v.as_object.field_values[i])) return JSON_FALSE;
+    }
+  }
+  return JSON_TRUE;
+}
+
+#ifdef TEST__HAVE_THREADS
+
+#define TEST__VERSIONS 300
+
+typedef struct {
+  Json_Published *slot;
+  int done;
+  int bad;
+} Test__Reader;
+
+// versions only ever go forward, and every one read is whole
+static
+void *Test__read(void *user)
+{
+  Test__Reader *reader = (Test__Reader *)user;
+  Json_Integer last = 0;
+
+  while (!__atomic_load_n(&reader->done, __ATOMIC_ACQUIRE)) {
+    Json_Frozen *doc = Json_publishAcquire(reader->slot);
+    const Json_Integer version = Json_objectGetInt(&doc->root, JSON_STRLIT("version"), -1);
+    if (version < last || Json_objectGetInt(&doc->root, JSON_STRLIT("check"), -1) != 7 * version) reader->bad += 1;
+    if (Json_objectGetInt(&doc->root, JSON_STRLIT("f39"), -1) != 39) reader->bad += 1;
+    last = version;
+    Json_frozenRelease(doc);
+  }
+
+  return NULL;
+}
+
+static
+void Test__swapUnderReaders(void)
+{
+  Json_Value value;
+  Json_Published slot;
+  Test__version(&value, 0);
+  Json_publishInit(&slot, Json_frozenCreate(&value));
+
+  Test__Reader readers[4];
+  pthread_t threads[4];
+  for (int i = 0; i < 4; ++i) {
+    readers[i].slot = &slot;
+    readers[i].done = 0;
+    readers[i].bad = 0;
+    TEST_CHECK(!pthread_create(&threads[i], NULL, Test__read, &readers[i]));
+  }
+
+  for (int v = 1; v <= TEST__VERSIONS; ++v) {
+    Test__version(&value, v);
+    Json_publishSwap(&slot, Json_frozenCreate(&value));
+  }
+
+  for (int i = 0; i < 4; ++i) __atomic_store_n(&readers[i].done, 1, __ATOMIC_RELEASE);
+  for (int i = 0; i < 4; ++i) {
+    pthread_join(threads[i], NULL);
+    TEST_CHECK(readers[i].bad == 0);
+  }
+
+  Json_Frozen *doc = Json_publishAcquire(&slot);
+  TEST_CHECK(Json_objectGetInt(&doc->root, JSON_STRLIT("version"), -1) == TEST__VERSIONS);
+  Json_frozenRelease(doc);
+  Json_publishDestroy(&slot);
+}
+
+#endif // TEST__HAVE_THREADS
+
+void Test_publish(void)
+{
+  const long live = Test_liveAllocs();
+
+  // frozen values are exact-size and read the same as before
+  static const char doc[] =
+    "{\"a\":[1,2,3],\"b\":{\"c\":[true,null]},\"d\":\"x\"}";
+  Json_Value value;
+  TEST_CHECK(Test_parse(doc, &value));
+  Json_Value *a = Json_objectGet(&value, JSON_STRLIT("a"));
+  Json_Value num;
+  Json_arrayAppend(a, Json_asValue(&num, JSON_TYPE_INTEGER, (Json_Integer)4));
+  TEST_CHECK(a->v.as_array.cap > a->v.as_array.len);
+  TEST_CHECK(Json_freeze(&value));
+  TEST_CHECK(Test__exact(&value));
+  TEST_CHECK(Test_sameText(&value, "{\"a\":[1,2,3,4],\"b\":{\"c\":[true,null]},\"d\":\"x\"}"));
+  Json_destroyValue(&value);
+
+  Test__version(&value, 1);
+  TEST_CHECK(!Test__exact(&value));
+  TEST_CHECK(Json_freeze(&value) && Test__exact(&value));
+  TEST_CHECK(Json_objectGetInt(&value, JSON_STRLIT("f17"), -1) == 17);
+  TEST_CHECK(Json_objectGetInt(&value, JSON_STRLIT("check"), -1) == 7);
+  TEST_CHECK(Json_objectGet(&value, JSON_STRLIT("f40")) == NULL);
+  TEST_CHECK(Json_freeze(&value));
+  Json_destroyValue(&value);
+
+  // a frozen document takes the value over and goes with its last reference
+  Test__version(&value, 1);
+  Json_Frozen *first = Json_frozenCreate(&value);
+  const long per_version = Test_liveAllocs() - live;
+  TEST_CHECK(first != NULL && value.type == JSON_TYPE_NULL);
+  TEST_CHECK(first->refs == 1 && Json_frozenRetain(first) == first && first->refs == 2);
+  Json_frozenRelease(first);
+  TEST_CHECK(first->refs == 1 && Test_liveAllocs() - live == per_version);
+
+  // a swapped out version lives on until its readers let go of it
+  Json_Published slot;
+  Json_publishInit(&slot, first);
+  Json_Frozen *held = Json_publishAcquire(&slot);
+  TEST_CHECK(held == first && first->refs == 2);
+
+  Test__version(&value, 2);
+  Json_publishSwap(&slot, Json_frozenCreate(&value));
+  TEST_CHECK(held->refs == 1 && Test_liveAllocs() - live == 2 * per_version);
+  TEST_CHECK(Json_objectGetInt(&held->root, JSON_STRLIT("version"), -1) == 1);
+
+  Json_frozenRelease(held);
+  TEST_CHECK(Test_liveAllocs() - live == per_version);
+
+  Json_Frozen *second = Json_publishAcquire(&slot);
+  TEST_CHECK(second && Json_objectGetInt(&second->root, JSON_STRLIT("version"), -1) == 2);
+  Json_frozenRelease(second);
+
+  Json_publishSwap(&slot, NULL);
+  TEST_CHECK(Json_publishAcquire(&slot) == NULL);
+  TEST_CHECK(Test_liveAllocs() == live);
+  Json_publishDestroy(&slot);
+
+#ifdef TEST__HAVE_THREADS
+  Test__swapUnderReaders();
+#endif
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,131 @@
+#include "test.h"
+
+// matches are collected as compact text, separated by spaces
+typedef struct {
+  Json_Sink sink;
+  size_t stop_after;
+  size_t count;
+} Test__Matches;
+
+static
+int Test__onCursor(void *user, const Json_Cursor *cur)
+{
+  Test__Matches *matches = (Test__Matches *)user;
+  Json_Value value;
+  if (matches->count++) Json_sinkWrite(&matches->sink, " ", 1);
+  if (Json_cursorValue(cur, &value, NULL)) Json_serialize(&value, NULL, &matches->sink);
+  else Json_sinkWrite(&matches->sink, "?", 1);
+
+  Json_destroyValue(&value);
+  return (matches->count == matches->stop_after)? JSON_EVENT_STOP : JSON_EVENT_CONTINUE;
+}
+
+static
+int Test__onValue(void *user, Json_Value *value)
+{
+  Test__Matches *matches = (Test__Matches *)user;
+  if (matches->count++) Json_sinkWrite(&matches->sink, " ", 1);
+  Json_serialize(value, NULL, &matches->sink);
+  return (matches->count == matches->stop_after)? JSON_EVENT_STOP : JSON_EVENT_CONTINUE;
+}
+
+static const char Test__doc[] =
+  "{\"user\":{\"id\":7,\"name\":\"ann\"},\"a/b\":1,\"m~n\":2,\"\":3,"
+  "\"list\":[{\"x\":1},{\"y\":2},{\"x\":[3]}],\"map\":{\"p\":{\"x\":4},\"q\":{\"x\":5}}}";
+
+// the buffer and the parsed value give the same matches in the same order
+static
+Json_Boolean Test__finds(const char *pointer, size_t stop_after, const char *expected)
+{
+  Json_Query query;
+  Json_String text;
+  text.is_heap = JSON_FALSE;
+  text.len = strlen(pointer);
+  text.data = (char *)(void *)pointer;
+  if (!Json_queryCompile(&query, text)) return JSON_FALSE;
+
+  Json_Value value;
+  Json_parseStr(sizeof(Test__doc) - 1, Test__doc, &value);
+
+  Test__Matches in_buffer, in_value;
+  memset(&in_buffer, 0, sizeof(in_buffer));
+  memset(&in_value, 0, sizeof(in_value));
+  Json_sinkInitBuffer(&in_buffer.sink);
+  Json_sinkInitBuffer(&in_value.sink);
+  in_buffer.stop_after = in_value.stop_after = stop_after;
+
+  const size_t n = Json_queryRun(&query, sizeof(Test__doc) - 1, Test__doc, Test__onCursor, &in_buffer);
+  const size_t m = Json_queryValue(&query, &value, Test__onValue, &in_value);
+  Json_sinkWrite(&in_buffer.sink, "", 1);
+  Json_sinkWrite(&in_value.sink, "", 1);
+
+  const Json_Boolean same = n == in_buffer.count && m == in_value.count
+    && !strcmp(in_buffer.sink.data, expected) && !strcmp(in_value.sink.data, expected);
+  if (!same) fprintf(stderr, "  %s: buffer %s, value %s\n", pointer, in_buffer.sink.data, in_value.sink.data);
+
+  Json_sinkDestroy(&in_buffer.sink);
+  Json_sinkDestroy(&in_value.sink);
+  Json_destroyValue(&value);
+  Json_queryDestroy(&query);
+  return same;
+}
+
+void Test_query(void)
+{
+  const long live = Test_liveAllocs();
+
+  TEST_CHECK(Test__finds("/user/id", 0, "7"));
+  TEST_CHECK(Test__finds("/user/name", 0, "\"ann\""));
+  TEST_CHECK(Test__finds("/a~1b", 0, "1"));
+  TEST_CHECK(Test__finds("/m~0n", 0, "2"));
+  TEST_CHECK(Test__finds("/", 0, "3"));
+  TEST_CHECK(Test__finds("/list/1", 0, "{\"y\":2}"));
+  TEST_CHECK(Test__finds("/list/2/x/0", 0, "3"));
+  TEST_CHECK(Test__finds("/list/3", 0, ""));
+  TEST_CHECK(Test__finds("/list/01", 0, ""));
+  TEST_CHECK(Test__finds("/user/missing", 0, ""));
+  TEST_CHECK(Test__finds("/user/id/deeper", 0, ""));
+
+  // wildcards go over elements and fields alike, in document order
+  TEST_CHECK(Test__finds("/list/*/x", 0, "1 [3]"));
+  TEST_CHECK(Test__finds("/map/*/x", 0, "4 5"));
+  TEST_CHECK(Test__finds("/*/x", 0, ""));
+  TEST_CHECK(Test__finds("/*/*/x", 0, "1 [3] 4 5"));
+  TEST_CHECK(Test__finds("/*/*/x", 2, "1 [3]"));
+
+  // the empty pointer is the whole document
+  Json_Value whole;
+  TEST_CHECK(Test_parse(Test__doc, &whole));
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_serialize(&whole, NULL, &sink));
+  TEST_CHECK(Test__finds("", 0, sink.data));
+  Json_sinkDestroy(&sink);
+  Json_destroyValue(&whole);
+
+  Json_Query query;
+  TEST_CHECK(!Json_queryCompile(&query, JSON_STRLIT("user")));
+  TEST_CHECK(!Json_queryCompile(&query, JSON_STRLIT("/a~2")));
+  TEST_CHECK(!Json_queryCompile(&query, JSON_STRLIT("/a~")));
+
+  // a duplicated field matches its last value, over a buffer or a tree
+  TEST_CHECK(Json_queryCompile(&query, JSON_STRLIT("/k")));
+  Test__Matches matches;
+  memset(&matches, 0, sizeof(matches));
+  Json_sinkInitBuffer(&matches.sink);
+  TEST_CHECK(Json_queryRun(&query, 15, "{\"k\":1,\"k\":2} ", Test__onCursor, &matches) == 1);
+  TEST_CHECK(matches.sink.len == 1 && matches.sink.data[0] == '2');
+  Json_sinkDestroy(&matches.sink);
+
+  Json_Value dup;
+  TEST_CHECK(Test_parse("{\"k\":1,\"k\":2}", &dup));
+  memset(&matches, 0, sizeof(matches));
+  Json_sinkInitBuffer(&matches.sink);
+  TEST_CHECK(Json_queryValue(&query, &dup, Test__onValue, &matches) == 1);
+  TEST_CHECK(matches.sink.len == 1 && matches.sink.data[0] == '2');
+  Json_sinkDestroy(&matches.sink);
+  Json_destroyValue(&dup);
+  Json_queryDestroy(&query);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,185 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+// the scanners classify 64 byte blocks, so everything is tried at every
+// offset around a block boundary and across the parser's token window
+
+static
+Json_String Test__str(char *data, size_t len)
+{
+  Json_String str;
+  str.is_heap = JSON_FALSE;
+  str.len = len;
+  str.data = data;
+  return str;
+}
+
+// str written and read back has to come out as the same bytes
+static
+Json_Boolean Test__roundTrip(Json_String str, unsigned flags)
+{
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+  Json_Boolean same = Json_serializeString(str, flags, &sink);
+
+  Json_Value value;
+  if (same) same = Json_parseStr(sink.len, sink.data, &value) == sink.len;
+  if (same) {
+    same = value.type == JSON_TYPE_STRING && value.v.as_string.len == str.len
+      && !memcmp(value.v.as_string.data, str.data, str.len);
+    Json_destroyValue(&value);
+  }
+
+  Json_sinkDestroy(&sink);
+  return same;
+}
+
+static
+void Test__strings(void)
+{
+  static const char specials[] = {'"', '\\', '\n', '/', '\x01', '\x1f', '\x7f'};
+
+  char data[160];
+  size_t failed = 0;
+  for (size_t len = 0; len < sizeof(data); ++len) {
+    memset(data, 'a', len);
+    failed += !Test__roundTrip(Test__str(data, len), 0);
+
+    for (size_t at = 0; at < len; ++at) {
+      for (size_t s = 0; s < sizeof(specials); ++s) {
+        memset(data, 'a', len);
+        data[at] = specials[s];
+        failed += !Test__roundTrip(Test__str(data, len), 0);
+        failed += !Test__roundTrip(Test__str(data, len), JSON_WRITE_RAW_UTF8);
+      }
+
+      // runs of backslashes that end on either side of a block boundary
+      memset(data, '\\', at + 1);
+      failed += !Test__roundTrip(Test__str(data, len), 0);
+    }
+  }
+
+  TEST_CHECK(failed == 0);
+}
+
+// a string whose closing quote sits right after a run of n escaped backslashes
+static
+void Test__escapedQuotes(void)
+{
+  char text[300];
+  size_t failed = 0;
+  for (size_t pad = 0; pad < 70; ++pad) {
+    for (size_t n = 0; n < 70; ++n) {
+      size_t len = 0;
+      text[len++] = '[';
+      memset(&text[len], ' ', pad);
+      len += pad;
+      text[len++] = '"';
+      for (size_t i = 0; i < n; ++i) {
+        text[len++] = '\\';
+        text[len++] = (i % 2)? '"' : '\\';
+      }
+      memcpy(&text[len], "\",1]", 4);
+      len += 4;
+
+      Json_Value value;
+      Json_Boolean ok = Json_parseStr(len, text, &value) == len && value.v.as_array.len == 2;
+      ok = ok && value.v.as_array.elems[0].v.as_string.len == n;
+      ok = ok && value.v.as_array.elems[1].v.as_integer == 1;
+      failed += !ok;
+      Json_destroyValue(&value);
+    }
+  }
+
+  TEST_CHECK(failed == 0);
+}
+
+static
+void Test__whitespace(void)
+{
+  char text[2400];
+  size_t failed = 0;
+  for (size_t n = 0; n < 200; ++n) {
+    size_t len = 0;
+    const char *parts[] = {"{", "\"k\"", ":", "[", "1", ",", "\"s\"", "]", "}"};
+    for (size_t p = 0; p < sizeof(parts) / sizeof(parts[0]); ++p) {
+      memset(&text[len], (p % 2)? '\n' : ' ', n);
+      len += n;
+      memcpy(&text[len], parts[p], strlen(parts[p]));
+      len += strlen(parts[p]);
+    }
+
+    Json_Value value;
+    failed += Json_parseStr(len, text, &value) != len;
+    failed += !Test_sameText(&value, "{\"k\":[1,\"s\"]}");
+    Json_destroyValue(&value);
+
+    // whitespace after the value is read too
+    memset(&text[len], '\t', n);
+    failed += Json_parseStr(len + n, text, &value) != len + n;
+    Json_destroyValue(&value);
+  }
+
+  TEST_CHECK(failed == 0);
+}
+
+// a document many token windows long, compact so that it writes back the same
+static
+void Test__bigDocument(void)
+{
+  const size_t cap = 1024 * 1024;
+  char *text = (char *)malloc(cap);
+  TEST_CHECK(text != NULL);
+  if (!text) return;
+
+  size_t len = 0;
+  text[len++] = '[';
+  for (int i = 0; len < cap - 256; ++i) {
+    if (i) text[len++] = ',';
+    switch (i % 5) {
+      case 0: len += (size_t)sprintf(&text[len], "{\"id\":%d,\"name\":\"item %d\"}", i, i); break;
+      case 1: len += (size_t)sprintf(&text[len], "\"esc\\\"aped\\\\ %d\\n\"", i); break;
+      case 2: len += (size_t)sprintf(&text[len], "[%d,-%d.5,true,null,[]]", i, i); break;
+      case 3: len += (size_t)sprintf(&text[len], "\"%*d\"", 1 + i % 150, i); break;
+      default: len += (size_t)sprintf(&text[len], "{}"); break;
+    }
+  }
+  text[len++] = ']';
+  text[len] = '\0';
+
+  Json_Value value;
+  TEST_CHECK(Json_parseStr(len, text, &value) == len);
+  TEST_CHECK(Test_sameText(&value, text));
+  Json_destroyValue(&value);
+
+  // the same document pretty printed has long runs of whitespace in it
+  Json_WriteOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.flags = JSON_WRITE_PRETTY;
+  opts.indent = "                                                                  ";
+
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_parseStr(len, text, &value) == len);
+  TEST_CHECK(Json_serialize(&value, &opts, &sink));
+  Json_destroyValue(&value);
+
+  TEST_CHECK(Json_parseStr(sink.len, sink.data, &value) == sink.len);
+  TEST_CHECK(Test_sameText(&value, text));
+  Json_destroyValue(&value);
+  Json_sinkDestroy(&sink);
+  free(text);
+}
+
+void Test_scan(void)
+{
+  const long live = Test_liveAllocs();
+
+  Test__strings();
+  Test__escapedQuotes();
+  Test__whitespace();
+  Test__bigDocument();
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,126 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t writes;
+  size_t biggest;
+  size_t fail_at; // the write that fails, 0 for none
+} Test__Collect;
+
+static
+Json_Boolean Test__collect(void *user, const char *data, size_t len)
+{
+  Test__Collect *out = (Test__Collect *)user;
+  out->writes += 1;
+  if (out->writes == out->fail_at) return JSON_FALSE;
+
+  memcpy(&out->data[out->len], data, len);
+  out->len += len;
+  if (len > out->biggest) out->biggest = len;
+  return JSON_TRUE;
+}
+
+void Test_serialize(void)
+{
+  const long live = Test_liveAllocs();
+
+  static const char doc[] = "{\"a\":[1,2.5,\"s\",true,false,null,{}],\"b\":{\"c\":[]}}";
+  Json_Value value;
+  TEST_CHECK(Test_parse(doc, &value));
+
+  // compact by default, NUL terminated in a buffer sink
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_serialize(&value, NULL, &sink));
+  TEST_CHECK(sink.len == sizeof(doc) - 1 && !strcmp(sink.data, doc));
+  Json_sinkDestroy(&sink);
+
+  Json_WriteOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.flags = JSON_WRITE_PRETTY;
+  opts.indent = "  ";
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_serialize(&value, &opts, &sink));
+  TEST_CHECK(!strcmp(sink.data,
+    "{\n  \"a\": [\n    1,\n    2.5,\n    \"s\",\n    true,\n    false,\n    null,\n    {\n    }\n  ],\n"
+    "  \"b\": {\n    \"c\": [\n    ]\n  }\n}"));
+  Json_sinkDestroy(&sink);
+
+  // pretty with the default indent is what Json_printValue writes, less its newline
+  FILE *file = tmpfile();
+  TEST_CHECK(file != NULL);
+  if (file) {
+    char printed[512];
+    Json_printValue(file, &value);
+    rewind(file);
+    const size_t len = fread(printed, 1, sizeof(printed) - 1, file);
+    printed[len] = '\0';
+    fclose(file);
+
+    opts.indent = NULL;
+    Json_sinkInitBuffer(&sink);
+    TEST_CHECK(Json_serialize(&value, &opts, &sink));
+    TEST_CHECK(len == sink.len + 1 && !memcmp(sink.data, printed, sink.len));
+    Json_sinkDestroy(&sink);
+  }
+  Json_destroyValue(&value);
+
+  // a big document reaches a callback sink in chunks, the last one on flush
+  Json_Value array;
+  memset(&array, 0, sizeof(array));
+  array.type = JSON_TYPE_ARRAY;
+  for (int i = 0; i < 20000; ++i) {
+    Json_asValue(&value, JSON_TYPE_INTEGER, (Json_Integer)i * 1000003);
+    Json_arrayAppend(&array, &value);
+  }
+
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_serialize(&array, NULL, &sink));
+
+  Test__Collect collect;
+  memset(&collect, 0, sizeof(collect));
+  collect.data = (char *)malloc(sink.len);
+  TEST_CHECK(collect.data != NULL);
+  if (collect.data) {
+    Json_Sink chunked;
+    Json_sinkInit(&chunked, Test__collect, &collect);
+    TEST_CHECK(Json_serialize(&array, NULL, &chunked));
+    Json_sinkDestroy(&chunked);
+
+    TEST_CHECK(collect.len == sink.len && !memcmp(collect.data, sink.data, sink.len));
+    TEST_CHECK(collect.writes > 1 && collect.biggest <= JSON_SINK_CHUNK);
+
+    // a failed write stops the serializer
+    free(collect.data);
+    memset(&collect, 0, sizeof(collect));
+    collect.data = (char *)malloc(sink.len);
+    collect.fail_at = 2;
+    Json_sinkInit(&chunked, Test__collect, &collect);
+    TEST_CHECK(!Json_serialize(&array, NULL, &chunked));
+    TEST_CHECK(collect.writes == 2 && chunked.failed);
+    Json_sinkDestroy(&chunked);
+    free(collect.data);
+  }
+
+  Json_Stats stats;
+  memset(&stats, 0, sizeof(stats));
+  Json_WriteOptions counted;
+  memset(&counted, 0, sizeof(counted));
+  counted.stats = &stats;
+  Json_sinkDestroy(&sink);
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_serialize(&array, &counted, &sink));
+  TEST_CHECK(stats.nodes == 20001);
+
+  // writes go straight to the sink too
+  TEST_CHECK(Json_sinkWrite(&sink, " ", 1));
+  TEST_CHECK(Json_serializeString(JSON_STRLIT("tail\n"), 0, &sink));
+  TEST_CHECK(sink.len > 10 && !strcmp(&sink.data[sink.len - 10], "] \"tail\\n\""));
+  Json_sinkDestroy(&sink);
+  Json_destroyValue(&array);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,138 @@
+#include "test.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <pthread.h>
+# define TEST__HAVE_THREADS 1
+#endif
+
+static const char Test__doc[] =
+  "{\"list\":[1,{\"k\":\"v\"},[true]],\"other\":{\"x\":[1,2],\"y\":\"why\"},\"n\":1}";
+
+#ifdef TEST__HAVE_THREADS
+
+// each thread changes its own snapshot of the same tree and destroys it
+static
+void *Test__edit(void *user)
+{
+  Json_Value *snap = (Json_Value *)user;
+  Json_Value *list = Json_objectEdit(snap, JSON_STRLIT("list"));
+  for (int i = 0; i < 100; ++i) {
+    Json_objectSetInt(Json_arrayEdit(list, 1), JSON_STRLIT("k"), i);
+    Json_objectSetInt(Json_objectEdit(snap, JSON_STRLIT("other")), JSON_STRLIT("z"), i);
+  }
+
+  Json_destroyValue(snap);
+  return NULL;
+}
+
+static
+void Test__editOnThreads(Json_Value *base)
+{
+  Json_Value snaps[4];
+  pthread_t threads[4];
+  for (int i = 0; i < 4; ++i) {
+    TEST_CHECK(Json_snapshot(base, &snaps[i]));
+    TEST_CHECK(!pthread_create(&threads[i], NULL, Test__edit, &snaps[i]));
+  }
+
+  for (int i = 0; i < 4; ++i) pthread_join(threads[i], NULL);
+}
+
+#endif // TEST__HAVE_THREADS
+
+void Test_snapshot(void)
+{
+  const long live = Test_liveAllocs();
+
+  // taking a snapshot copies nothing
+  Json_Value base, snap;
+  TEST_CHECK(Test_parse(Test__doc, &base));
+  const long parsed = Test_liveAllocs();
+  TEST_CHECK(Json_snapshot(&base, &snap));
+  TEST_CHECK(Test_liveAllocs() == parsed);
+  TEST_CHECK(snap.v.as_object.field_values == base.v.as_object.field_values);
+
+  // changes below the root copy only the containers on the way down
+  Json_Value *list = Json_objectEdit(&base, JSON_STRLIT("list"));
+  Json_objectSetStr(Json_arrayEdit(list, 1), JSON_STRLIT("k"), JSON_STRLIT("changed"));
+  Json_objectSetInt(&base, JSON_STRLIT("n"), 2);
+  TEST_CHECK(Test_sameText(&base, "{\"list\":[1,{\"k\":\"changed\"},[true]],\"other\":{\"x\":[1,2],\"y\":\"why\"},\"n\":2}"));
+  TEST_CHECK(Test_sameText(&snap, Test__doc));
+  TEST_CHECK(snap.v.as_object.field_values != base.v.as_object.field_values);
+  TEST_CHECK(Json_objectGet(&base, JSON_STRLIT("other"))->v.as_object.field_values
+             == Json_objectGet(&snap, JSON_STRLIT("other"))->v.as_object.field_values);
+  TEST_CHECK(Json_objectGet(&base, JSON_STRLIT("list"))->v.as_array.elems[2].v.as_array.elems
+             == Json_objectGet(&snap, JSON_STRLIT("list"))->v.as_array.elems[2].v.as_array.elems);
+
+  // the snapshot changes just as freely
+  Json_Value num;
+  Json_Value *snap_list = Json_objectEdit(&snap, JSON_STRLIT("list"));
+  Json_arrayAppend(snap_list, Json_asValue(&num, JSON_TYPE_INTEGER, (Json_Integer)4));
+  Json_destroyValue(Json_arrayEdit(snap_list, 0));
+  Json_arrayDelete(snap_list, 0);
+  Json_objectDelete(&snap, JSON_STRLIT("other"));
+  TEST_CHECK(Test_sameText(&snap, "{\"list\":[{\"k\":\"v\"},[true],4],\"n\":1}"));
+  TEST_CHECK(Test_sameText(&base, "{\"list\":[1,{\"k\":\"changed\"},[true]],\"other\":{\"x\":[1,2],\"y\":\"why\"},\"n\":2}"));
+
+  // and outlives the tree it was taken from
+  Json_Value older;
+  TEST_CHECK(Json_snapshot(&base, &older));
+  Json_destroyValue(&base);
+  TEST_CHECK(Test_sameText(&older, "{\"list\":[1,{\"k\":\"changed\"},[true]],\"other\":{\"x\":[1,2],\"y\":\"why\"},\"n\":2}"));
+  Json_destroyValue(&older);
+  Json_destroyValue(&snap);
+  TEST_CHECK(Test_liveAllocs() == live);
+
+  // many snapshots of one tree each go their own way
+  Json_Value snaps[8];
+  TEST_CHECK(Test_parse(Test__doc, &base));
+  for (int i = 0; i < 8; ++i) {
+    TEST_CHECK(Json_snapshot((i)? &snaps[i - 1] : &base, &snaps[i]));
+    Json_objectSetInt(Json_objectEdit(&snaps[i], JSON_STRLIT("other")), JSON_STRLIT("i"), i);
+  }
+  for (int i = 0; i < 8; ++i) {
+    Json_Value *other = Json_objectGet(&snaps[i], JSON_STRLIT("other"));
+    TEST_CHECK(Json_objectGetInt(other, JSON_STRLIT("i"), -1) == i);
+    Json_destroyValue(&snaps[i]);
+  }
+  TEST_CHECK(Test_sameText(&base, Test__doc));
+
+  // unsharing copies one level and keeps the contents
+  TEST_CHECK(Json_snapshot(&base, &snap));
+  TEST_CHECK(Json_unshare(&snap));
+  TEST_CHECK(snap.v.as_object.field_values != base.v.as_object.field_values);
+  TEST_CHECK(Json_unshare(&snap) && Test_sameText(&snap, Test__doc));
+  Json_destroyValue(&snap);
+
+  // strings are copied right away
+  Json_Value *y = Json_objectGet(Json_objectGet(&base, JSON_STRLIT("other")), JSON_STRLIT("y"));
+  TEST_CHECK(Json_snapshot(y, &snap));
+  TEST_CHECK(snap.v.as_string.data != y->v.as_string.data && !Json_stringCmp(snap.v.as_string, y->v.as_string));
+  Json_destroyValue(&snap);
+
+#ifdef TEST__HAVE_THREADS
+  Test__editOnThreads(&base);
+  TEST_CHECK(Test_sameText(&base, Test__doc));
+#endif
+
+  Json_destroyValue(&base);
+  TEST_CHECK(Test_liveAllocs() == live);
+
+  // clones share nothing, not even with an arena
+  Json_Arena arena;
+  Json_Value clone;
+  Json_arenaInit(&arena, 0);
+  TEST_CHECK(Json_parseStrArena(&arena, sizeof(Test__doc) - 1, Test__doc, &base) == sizeof(Test__doc) - 1);
+  TEST_CHECK(Json_clone(&base, &clone));
+  Json_arenaDestroy(&arena);
+  TEST_CHECK(Test_sameText(&clone, Test__doc));
+
+  Json_Value copy;
+  TEST_CHECK(Json_clone(&clone, &copy));
+  Json_objectSetInt(Json_objectGet(&copy, JSON_STRLIT("other")), JSON_STRLIT("z"), 1);
+  TEST_CHECK(Test_sameText(&clone, Test__doc));
+  Json_destroyValue(&clone);
+  Json_destroyValue(&copy);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
@@ -0,0 +1,129 @@
+#include "test.h"
+
+#include <stdlib.h>
+
+// the tape has to hold exactly what the tree parse built
+static
+Json_Boolean Test__matches(Json_TapeRef ref, Json_Value *value)
+{
+  const Json_String none = {JSON_FALSE, 0, NULL};
+  if (Json_tapeType(ref) != value->type) return JSON_FALSE;
+
+  switch (value->type) {
+    case JSON_TYPE_BOOLEAN: return Json_tapeBool(ref, !value->v.as_boolean) == value->v.as_boolean;
+    case JSON_TYPE_INTEGER: return Json_tapeInt(ref, 0) == value->v.as_integer;
+    case JSON_TYPE_STRING: return !Json_stringCmp(Json_tapeStr(ref, none), value->v.as_string);
+
+    case JSON_TYPE_NUMBER: {
+      const Json_Number num = Json_tapeNum(ref, NAN);
+      return !memcmp(&num, &value->v.as_number, sizeof(num));
+    }
+
+    case JSON_TYPE_ARRAY: {
+      Json_TapeIter iter;
+      Json_TapeRef elem, at;
+      size_t i = 0;
+      if (Json_tapeLen(ref) != value->v.as_array.len || !Json_tapeIter(ref, &iter)) return JSON_FALSE;
+
+      while (Json_tapeNext(&iter, NULL, &elem)) {
+        if (i >= value->v.as_array.len || !Test__matches(elem, &value->v.as_array.elems[i])) return JSON_FALSE;
+        if (i < 64 && (!Json_tapeAt(ref, i, &at) || at.idx != elem.idx)) return JSON_FALSE;
+        i += 1;
+      }
+
+      return i == value->v.as_array.len && !Json_tapeAt(ref, i, &at);
+    }
+
+    case JSON_TYPE_OBJECT: {
+      Json_TapeIter iter;
+      Json_TapeRef field, found;
+      Json_String key;
+      size_t i = 0;
+      if (Json_tapeLen(ref) != value->v.as_object.len || !Json_tapeIter(ref, &iter)) return JSON_FALSE;
+
+      while (Json_tapeNext(&iter, &key, &field)) {
+        const Json_Object *object = &value->v.as_object;
+        if (i >= object->len || Json_stringCmp(key, object->field_names[i])) return JSON_FALSE;
+        if (!Test__matches(field, &object->field_values[i])) return JSON_FALSE;
+        if (!Json_tapeGet(ref, key, &found) || found.idx != field.idx) return JSON_FALSE;
+        i += 1;
+      }
+
+      return i == value->v.as_object.len && !Json_tapeGet(ref, JSON_STRLIT("no such field"), &found);
+    }
+
+    default: return JSON_TRUE;
+  }
+}
+
+static
+Json_Boolean Test__sameTape(const Json_Tape *a, const Json_Tape *b)
+{
+  return a->len == b->len && !memcmp(a->words, b->words, a->len * sizeof(a->words[0]))
+    && a->strings_len == b->strings_len && (!a->strings_len || !memcmp(a->strings, b->strings, a->strings_len));
+}
+
+static
+void Test__checkDocument(const char *text, size_t len)
+{
+  Json_Value value;
+  Json_Tape tape, built;
+  TEST_CHECK(Json_parseStr(len, text, &value) == len);
+  TEST_CHECK(Json_parseTape(len, text, &tape) == len);
+  TEST_CHECK(Test__matches(Json_tapeRoot(&tape), &value));
+
+  // a tape built from the tree is the same tape, word for word
+  TEST_CHECK(Json_tapeFromValue(&value, &built));
+  TEST_CHECK(Test__sameTape(&tape, &built));
+
+  Json_destroyTape(&built);
+  Json_destroyTape(&tape);
+  Json_destroyValue(&value);
+}
+
+void Test_tape(void)
+{
+  const long live = Test_liveAllocs();
+
+  static const char *const docs[] = {
+    " { \"a\" : [ 1 , -2.5e-3 , \"x\\u00e9\\n\" , true , false , null ] ,\n\t\"b\" : { } , \"c\" : [ ] } ",
+    "[[[]],[{}],{\"k\":{\"k\":[\"\\\"]\",\"\"]}}]",
+    "\"top\\\\level\"",
+    "-9223372036854775808",
+    "1e308",
+    "null",
+  };
+
+  for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) Test__checkDocument(docs[i], strlen(docs[i]));
+
+  char *big = (char *)malloc(512 * 1024);
+  TEST_CHECK(big != NULL);
+  if (big) {
+    size_t len = 0;
+    len += (size_t)sprintf(&big[len], "{\"items\":[");
+    for (int i = 0; i < 5000; ++i) {
+      len += (size_t)sprintf(&big[len], "%s{\"id\":%d,\"name\":\"n\\\"%d\",\"score\":%d.%d,\"tags\":[\"t%d\",[]],\"ok\":%s}",
+        (i)? "," : "", i, i, i, i % 7, i % 3, (i % 2)? "true" : "false");
+    }
+    len += (size_t)sprintf(&big[len], "],\"count\":5000}");
+    Test__checkDocument(big, len);
+
+    Json_Tape tape;
+    Json_TapeRef items, item;
+    TEST_CHECK(Json_parseTape(len, big, &tape) == len);
+    TEST_CHECK(Json_tapeGetInt(Json_tapeRoot(&tape), JSON_STRLIT("count"), -1) == 5000);
+    TEST_CHECK(Json_tapeGet(Json_tapeRoot(&tape), JSON_STRLIT("items"), &items));
+    TEST_CHECK(Json_tapeAt(items, 4321, &item));
+    TEST_CHECK(Json_tapeGetInt(item, JSON_STRLIT("id"), -1) == 4321);
+    TEST_CHECK(!Json_stringCmp(Json_tapeGetStr(item, JSON_STRLIT("name"), JSON_STRLIT("")), JSON_STRLIT("n\"4321")));
+    Json_destroyTape(&tape);
+    free(big);
+  }
+
+  // malformed input leaves the tape empty
+  Json_Tape tape;
+  TEST_CHECK(Json_parseTape(7, "[1,{}}]", &tape) == 0);
+  TEST_CHECK(tape.len == 0 && tape.words == NULL);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}
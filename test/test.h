@@ -0,0 +1,47 @@
+#ifndef TEST_H_
+#define TEST_H_ 1
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// a failed check is reported and counted, the suite keeps going
+#define TEST_CHECK(cond) Test_check((cond) != 0, __FILE__, __LINE__, #cond)
+
+void Test_check(int ok, const char *file, int line, const char *expr);
+
+// blocks currently held through the global allocator, for leak checks
+long Test_liveAllocs(void);
+
+// parses text, which has to be exactly one valid document
+Json_Boolean Test_parse(const char *text, Json_Value *out);
+
+// compares the compact serialization of value with text
+Json_Boolean Test_sameText(const Json_Value *value, const char *text);
+Json_Boolean Test_sameValue(const Json_Value *a, const Json_Value *b);
+
+void Test_arena(void);
+void Test_borrow(void);
+void Test_index(void);
+void Test_mapped(void);
+void Test_parser(void);
+void Test_events(void);
+void Test_lines(void);
+void Test_scan(void);
+void Test_number(void);
+void Test_format(void);
+void Test_serialize(void);
+void Test_utf8(void);
+void Test_parallel(void);
+void Test_cursor(void);
+void Test_tape(void);
+void Test_query(void);
+void Test_keys(void);
+void Test_capacity(void);
+void Test_alloc(void);
+void Test_binary(void);
+void Test_publish(void);
+void Test_snapshot(void);
+
+#endif // !TEST_H_
@@ -0,0 +1,106 @@
+#include "test.h"
+
+static
+Json_Boolean Test__writes(const char *str, unsigned flags, const char *expected)
+{
+  Json_String text;
+  text.is_heap = JSON_FALSE;
+  text.len = strlen(str);
+  text.data = (char *)(void *)str;
+
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+  const Json_Boolean same = Json_serializeString(text, flags, &sink)
+    && sink.len == strlen(expected) && !memcmp(sink.data, expected, sink.len);
+
+  if (!same) fprintf(stderr, "  got:  %.*s\n  want: %s\n", (int)sink.len, sink.data? sink.data : "", expected);
+  Json_sinkDestroy(&sink);
+  return same;
+}
+
+static
+Json_Boolean Test__readsBack(const char *str, unsigned flags)
+{
+  Json_String text;
+  text.is_heap = JSON_FALSE;
+  text.len = strlen(str);
+  text.data = (char *)(void *)str;
+
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+
+  Json_Value back;
+  Json_Boolean same = Json_serializeString(text, flags, &sink)
+    && Json_parseStr(sink.len, sink.data, &back) == sink.len;
+
+  if (same) {
+    same = back.v.as_string.len == text.len && !memcmp(back.v.as_string.data, str, text.len);
+    Json_destroyValue(&back);
+  }
+
+  Json_sinkDestroy(&sink);
+  return same;
+}
+
+void Test_utf8(void)
+{
+  const long live = Test_liveAllocs();
+
+  static const char mixed[] = "a/\xc3\xa9\xf0\x9f\x8c\xbf\x01\x7f\"\\";
+  TEST_CHECK(Test__writes(mixed, 0, "\"a\\/\\u00e9\\ud83c\\udf3f\\u0001\\u007f\\\"\\\\\""));
+  TEST_CHECK(Test__writes(mixed, JSON_WRITE_RAW_UTF8, "\"a/\xc3\xa9\xf0\x9f\x8c\xbf\\u0001\x7f\\\"\\\\\""));
+
+  // invalid UTF-8 is replaced in either mode: a stray continuation byte,
+  // a sequence cut short, an encoded surrogate and an overlong slash
+  static const char *const invalid[] = {"\x80", "\xc3", "\xe2\x82", "\xed\xa0\x80", "\xc0\xaf"};
+  static const char *const replaced[] = {
+    "\"\\ufffd\"", "\"\\ufffd\"", "\"\\ufffd\\ufffd\"", "\"\\ufffd\\ufffd\\ufffd\"", "\"\\ufffd\\ufffd\""
+  };
+
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+    TEST_CHECK(Test__writes(invalid[i], 0, replaced[i]));
+    TEST_CHECK(Test__writes(invalid[i], JSON_WRITE_RAW_UTF8, replaced[i]));
+  }
+
+  // multibyte characters at every offset around a block boundary come out
+  // untouched in raw mode and read back the same from either mode, while
+  // each byte of one that's cut short is replaced
+  static const char *const chars[] = {"\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x8c\xbf"};
+  char str[128], expected[256];
+  size_t failed = 0;
+  for (size_t at = 40; at < 80; ++at) {
+    for (size_t c = 0; c < sizeof(chars) / sizeof(chars[0]); ++c) {
+      const size_t n = strlen(chars[c]);
+      memset(str, 'x', at);
+      sprintf(&str[at], "%stail", chars[c]);
+      sprintf(expected, "\"%s\"", str);
+      failed += !Test__writes(str, JSON_WRITE_RAW_UTF8, expected);
+      failed += !Test__readsBack(str, 0) || !Test__readsBack(str, JSON_WRITE_RAW_UTF8);
+
+      sprintf(&str[at], "%.*stail", (int)n - 1, chars[c]);
+      memset(expected, 0, sizeof(expected));
+      expected[0] = '"';
+      memset(&expected[1], 'x', at);
+      for (size_t i = 1; i < n; ++i) strcat(expected, "\\ufffd");
+      strcat(expected, "tail\"");
+      failed += !Test__writes(str, 0, expected) || !Test__writes(str, JSON_WRITE_RAW_UTF8, expected);
+    }
+  }
+  TEST_CHECK(failed == 0);
+
+  // field names are written the same way
+  Json_Value value;
+  TEST_CHECK(Test_parse("{\"k\\u00e9\":[\"\\ud83c\\udf3f\"]}", &value));
+  Json_WriteOptions opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.flags = JSON_WRITE_RAW_UTF8;
+  Json_Sink sink;
+  Json_sinkInitBuffer(&sink);
+  TEST_CHECK(Json_serialize(&value, &opts, &sink));
+  TEST_CHECK(!strcmp(sink.data, "{\"k\xc3\xa9\":[\"\xf0\x9f\x8c\xbf\"]}"));
+  Json_sinkDestroy(&sink);
+  TEST_CHECK(Test_sameText(&value, "{\"k\\u00e9\":[\"\\ud83c\\udf3f\"]}"));
+  Json_destroyValue(&value);
+
+  TEST_CHECK(Test_liveAllocs() == live);
+}